@@ -0,0 +1,106 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include "binomo-cpp-api-http.hpp"
+#include "tools/binomo-cpp-api-stand-in-server.hpp"
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/* пиковое потребление памяти процессом, байты */
+uint64_t get_peak_rss() {
+#   ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if(!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#   else
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#   ifdef __APPLE__
+    return usage.ru_maxrss;
+#   else
+    return (uint64_t)usage.ru_maxrss * 1024;
+#   endif
+#   endif
+}
+
+/* вариант загрузчика истории */
+class DownloadEngine {
+public:
+    std::string name;
+    uint32_t max_requests = 1;  /**< Количество одновременных запросов */
+};
+
+int main(int argc, char *argv[]) {
+    std::cout << "binomo cpp api history download benchmark" << std::endl;
+    /* аргументы: дней истории, задержка сервера (мс), каждый N-й ответ 429, размер частей ответа */
+    const uint32_t days = argc > 1 ? std::atoi(argv[1]) : 30;
+    binomo_api::HistoryStandInServer::Config config;
+    config.latency_ms = argc > 2 ? std::atoi(argv[2]) : 20;
+    config.limit_every = argc > 3 ? std::atoi(argv[3]) : 0;
+    config.chunk_size = argc > 4 ? std::atoi(argv[4]) : 0;
+    config.threads = 2;
+
+    binomo_api::HistoryStandInServer server(config);
+    if(!server.start()) {
+        std::cout << "stand-in server start error, port " << config.port << std::endl;
+        return 1;
+    }
+    std::cout << "stand-in server: " << server.get_url()
+        << " latency " << config.latency_ms << " ms"
+        << " 429 every " << config.limit_every
+        << " chunk size " << config.chunk_size << std::endl;
+
+    /* несколько символов с минутными барами */
+    const std::vector<std::string> symbols = {"EURUSD", "GBPUSD", "USDJPY", "BTCUSD"};
+    const xtime::timestamp_t stop_date = xtime::get_first_timestamp_day(xtime::get_timestamp());
+    const xtime::timestamp_t start_date = stop_date - days * xtime::SECONDS_IN_DAY;
+
+    std::vector<DownloadEngine> engines = {
+        {"sequential", 1},
+        {"parallel-4", 4},
+        {"parallel-8", 8},
+        {"parallel-16", 16},
+    };
+
+    for(size_t e = 0; e < engines.size(); ++e) {
+        binomo_api::BinomoApiHttp<> api;
+        api.set_api_url(server.get_url());
+        /* бенчмарк измеряет загрузчик, а не лимит брокера */
+        api.set_rate_limiter(std::make_shared<binomo_api::RateLimiter>(1000000, 1000000));
+        api.set_max_async_requests(engines[e].max_requests);
+
+        std::vector<binomo_api::BinomoApiHttp<>::HistoryRequest> requests;
+        for(size_t i = 0; i < symbols.size(); ++i) {
+            requests.push_back(binomo_api::BinomoApiHttp<>::HistoryRequest(symbols[i], xtime::SECONDS_IN_MINUTE, start_date, stop_date));
+        }
+
+        const binomo_api::HistoryStandInServer::Stats stats_start = server.get_stats();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        int err = api.get_historical_data(requests, engines[e].max_requests);
+        std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+        const binomo_api::HistoryStandInServer::Stats stats_stop = server.get_stats();
+
+        size_t total_candles = 0;
+        for(size_t i = 0; i < requests.size(); ++i) total_candles += requests[i].candles.size();
+        const double seconds = std::chrono::duration<double>(stop - start).count();
+        const uint64_t num_requests = stats_stop.requests - stats_start.requests;
+        std::cout << engines[e].name
+            << ": err " << err
+            << ", requests " << num_requests
+            << " (429: " << (stats_stop.limited - stats_start.limited) << ")"
+            << ", candles " << total_candles
+            << ", time " << seconds << " s"
+            << ", " << (seconds > 0 ? (double)num_requests / seconds : 0) << " req/s"
+            << ", " << (seconds > 0 ? (double)total_candles / seconds : 0) << " candles/s"
+            << ", peak rss " << (get_peak_rss() / (1024 * 1024)) << " MB"
+            << std::endl;
+    }
+    server.stop();
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "binomo-cpp-api-common.hpp"
+#include "tools/binomo-cpp-api-history-parser.hpp"
+
+using json = nlohmann::json;
+
+/* парсер на основе DOM, которым ранее разбирались исторические данные */
+template<class CANDLE>
+void parse_history_dom(
+        std::vector<CANDLE> &candles,
+        std::string &response) {
+    try {
+        json j = json::parse(response);
+        if(j["success"] != true) return;
+        json j_data = j["data"];
+        const size_t size_data = j_data.size();
+        for(size_t i = 0; i < size_data; ++i) {
+            json j_canlde = j_data[i];
+            CANDLE candle;
+            std::string str_iso = j_canlde["created_at"];
+            xtime::DateTime date_time;
+            if(!xtime::convert_iso(str_iso, date_time)) continue;
+            candle.timestamp = date_time.get_timestamp();
+            candle.open = j_canlde["open"];
+            candle.high = j_canlde["high"];
+            candle.low = j_canlde["low"];
+            candle.close = j_canlde["close"];
+            candle.volume = 0;
+            candles.push_back(candle);
+        }
+    } catch(...) {}
+}
+
+/* ответ сервера с заданным количеством минутных баров */
+std::string get_test_response(const size_t size) {
+    std::string response("{\"success\":true,\"errors\":[],\"data\":[");
+    xtime::timestamp_t timestamp = xtime::get_timestamp(1,9,2020,0,0,0);
+    double price = 1.17543;
+    for(size_t i = 0; i < size; ++i) {
+        if(i > 0) response += ",";
+        response += "{\"open\":";
+        response += std::to_string(price);
+        response += ",\"close\":";
+        response += std::to_string(price + 0.00012);
+        response += ",\"high\":";
+        response += std::to_string(price + 0.00031);
+        response += ",\"low\":";
+        response += std::to_string(price - 0.00027);
+        response += ",\"created_at\":\"";
+        response += xtime::to_string("%YYYY-%MM-%DDT%hh:%mm:%ss", timestamp);
+        response += ".000000Z\"}";
+        timestamp += xtime::SECONDS_IN_MINUTE;
+        price += (i % 7) < 3 ? 0.00005 : -0.00004;
+    }
+    response += "]}";
+    return response;
+}
+
+template<class PARSER>
+double run_benchmark(const std::string &name, std::string &response, const size_t repeats, PARSER parser) {
+    size_t total = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < repeats; ++i) {
+        std::vector<binomo_api::common::Candle> candles;
+        parser(candles, response);
+        total += candles.size();
+    }
+    std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(stop - start).count();
+    const double speed = seconds > 0 ? (double)total / seconds : 0;
+    std::cout << name << ": " << total << " candles, " << seconds << " s, " << speed << " candles/s" << std::endl;
+    return speed;
+}
+
+int main() {
+    std::cout << "binomo cpp api history parser benchmark" << std::endl;
+    const size_t candles_in_response = xtime::MINUTES_IN_DAY;
+    const size_t repeats = 200;
+    std::string response = get_test_response(candles_in_response);
+    std::cout << "response size: " << response.size() << " bytes" << std::endl;
+
+    /* проверяем, что оба парсера дают одинаковый результат */
+    std::vector<binomo_api::common::Candle> candles_dom;
+    std::vector<binomo_api::common::Candle> candles_sax;
+    parse_history_dom(candles_dom, response);
+    binomo_api::parse_history(response, candles_sax);
+    bool is_equal = candles_dom.size() == candles_sax.size();
+    for(size_t i = 0; is_equal && i < candles_dom.size(); ++i) {
+        if(candles_dom[i].timestamp != candles_sax[i].timestamp ||
+            candles_dom[i].open != candles_sax[i].open ||
+            candles_dom[i].high != candles_sax[i].high ||
+            candles_dom[i].low != candles_sax[i].low ||
+            candles_dom[i].close != candles_sax[i].close) is_equal = false;
+    }
+    std::cout << "results are equal: " << (is_equal ? "yes" : "no") << std::endl;
+
+    const double speed_dom = run_benchmark("dom", response, repeats,
+            [](std::vector<binomo_api::common::Candle> &candles, std::string &response) {
+        parse_history_dom(candles, response);
+    });
+    const double speed_sax = run_benchmark("sax", response, repeats,
+            [](std::vector<binomo_api::common::Candle> &candles, std::string &response) {
+        binomo_api::parse_history(response, candles);
+    });
+    if(speed_dom > 0) std::cout << "speedup: " << (speed_sax / speed_dom) << "x" << std::endl;
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <new>
+#include <atomic>
+#include <nlohmann/json.hpp>
+#include "binomo-cpp-api-common.hpp"
+#include "tools/binomo-cpp-api-quote-parser.hpp"
+#include "tools/binomo-cpp-api-candle-series.hpp"
+
+using json = nlohmann::json;
+
+/* счетчик выделений памяти, нужен для проверки, что разбор тика не выделяет память.
+ * noinline не дает GCC встроить операторы и ошибочно предупредить о несовпадении new и free
+ */
+static std::atomic<uint64_t> allocations(0);
+
+__attribute__((noinline)) void *operator new(std::size_t size) {
+    ++allocations;
+    void *ptr = std::malloc(size == 0 ? 1 : size);
+    if(ptr == nullptr) throw std::bad_alloc();
+    return ptr;
+}
+
+__attribute__((noinline)) void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+/* парсер на основе DOM, которым ранее разбирались сообщения потока котировок */
+template<class CALLBACK>
+void parse_quotes_dom(const std::string &response, CALLBACK on_tick) {
+    try {
+        json j = json::parse(response);
+        if(j["success"] != true) return;
+        json j_data = j["data"];
+        for(size_t j = 0; j < j_data.size(); ++j) {
+            if(j_data[j]["action"] != "assets") continue;
+            json j_assets = j_data[j]["assets"];
+            for(size_t i = 0; i < j_assets.size(); ++i) {
+                json j_element = j_assets[i];
+                binomo_api::common::StreamTick tick;
+                tick.price = j_element["rate"];
+                tick.precision = j_element["precision"];
+                tick.symbol_id = binomo_api::common::SymbolRegistry::get().get_id_by_ric(j_element["ric"].get_ref<const std::string&>());
+                if(tick.symbol_id == binomo_api::common::INVALID_SYMBOL_ID) continue;
+                std::string str_iso = j_element["created_at"];
+                xtime::DateTime date_time;
+                if(!xtime::convert_iso(str_iso, date_time)) continue;
+                tick.timestamp = date_time.get_ftimestamp();
+                on_tick(tick);
+            }
+        }
+    } catch(...) {}
+}
+
+/// Вид тика в тестовом сообщении
+class TestAsset {
+public:
+    const char *symbol;
+    uint32_t precision;     /**< Точность в сообщении */
+    int digits;             /**< Знаков после запятой в записи цены, -1 - 17 значащих цифр */
+    double price;
+    double step;
+};
+
+/* сообщения сервера, по два тика в сообщении.
+ * Дробная часть секунд и количество знаков цены меняются от сообщения к сообщению,
+ * а ожидаемые тики записываются в expected
+ */
+std::vector<std::string> get_test_frames(const size_t size, std::vector<binomo_api::common::StreamTick> &expected) {
+    const binomo_api::common::SymbolRegistry &registry = binomo_api::common::SymbolRegistry::get();
+    const TestAsset assets[] = {
+        {"EURUSD", 5, 5, 1.17543, 0.00001},
+        {"EURUSD", 5, 4, 1.1754, 0.0001},           /* нули в конце цены сервер не пишет */
+        {"EURUSD", 5, -1, 1.1754312345678901, 0.00001},
+        {"USDJPY", 3, 3, 105.512, 0.001},
+        {"XAUUSD", 2, 2, 1876.45, 0.01},
+        {"BTCUSD", 2, 0, 10800, 1},
+    };
+    const size_t assets_size = sizeof(assets) / sizeof(assets[0]);
+    const char *fractions[] = {"000000", "123456", "5", "042", "999999", "000001", "25"};
+    const size_t fractions_size = sizeof(fractions) / sizeof(fractions[0]);
+
+    std::vector<std::string> frames;
+    xtime::timestamp_t timestamp = xtime::get_timestamp(1,9,2020,0,0,0);
+    for(size_t i = 0; i < size; ++i) {
+        const std::string date = xtime::to_string("%YYYY-%MM-%DDT%hh:%mm:%ss", timestamp);
+        std::string frame("{\"data\":[{\"assets\":[");
+        for(size_t n = 0; n < 2; ++n) {
+            const TestAsset &asset = n == 0 ? assets[i % 3] : assets[3 + (i % (assets_size - 3))];
+            const binomo_api::common::SymbolId symbol_id = binomo_api::common::get_symbol_id(asset.symbol);
+            const char *fraction = fractions[(i + n) % fractions_size];
+            char rate[64];
+            if(asset.digits < 0) std::snprintf(rate, sizeof(rate), "%.17g", asset.price + asset.step * (i % 50));
+            else std::snprintf(rate, sizeof(rate), "%.*f", asset.digits, asset.price + asset.step * (i % 50));
+            char buffer[512];
+            std::snprintf(buffer, sizeof(buffer),
+                "%s{\"rate\":%s,\"precision\":%u,\"repeat\":0,\"ask\":%s,\"created_at\":\"%s.%sZ\",\"bid\":%s,\"ric\":\"%s\"}",
+                n == 0 ? "" : ",", rate, asset.precision, rate, date.c_str(), fraction, rate, registry.get_info(symbol_id).ric.c_str());
+            frame += buffer;
+
+            binomo_api::common::StreamTick tick;
+            tick.symbol_id = symbol_id;
+            tick.price = std::strtod(rate, nullptr);
+            tick.precision = asset.precision;
+            tick.timestamp = (xtime::ftimestamp_t)timestamp + std::strtod((std::string("0.") + fraction).c_str(), nullptr);
+            expected.push_back(tick);
+        }
+        frame += "],\"action\":\"assets\"}],\"success\":true,\"errors\":[]}";
+        frames.push_back(frame);
+        timestamp += 1;
+    }
+    return frames;
+}
+
+/* сравнить тики, метки времени сравниваются с допуском */
+bool is_equal_ticks(
+        const std::vector<binomo_api::common::StreamTick> &a,
+        const std::vector<binomo_api::common::StreamTick> &b,
+        const double time_tolerance,
+        double &max_time_diff) {
+    max_time_diff = 0;
+    if(a.size() != b.size()) return false;
+    bool is_equal = true;
+    for(size_t i = 0; i < a.size(); ++i) {
+        if(a[i].symbol_id != b[i].symbol_id ||
+            a[i].price != b[i].price ||
+            a[i].precision != b[i].precision) is_equal = false;
+        const double diff = std::abs(a[i].timestamp - b[i].timestamp);
+        if(diff > max_time_diff) max_time_diff = diff;
+        if(diff > time_tolerance) is_equal = false;
+    }
+    return is_equal;
+}
+
+template<class PARSER>
+double run_benchmark(const std::string &name, const std::vector<std::string> &frames, const size_t repeats, PARSER parser) {
+    size_t total = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(size_t r = 0; r < repeats; ++r) {
+        for(size_t i = 0; i < frames.size(); ++i) {
+            parser(frames[i], total);
+        }
+    }
+    std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+    const double seconds = std::chrono::duration<double>(stop - start).count();
+    const double speed = seconds > 0 ? (double)total / seconds : 0;
+    std::cout << name << ": " << total << " ticks, " << seconds << " s, " << speed << " ticks/s" << std::endl;
+    return speed;
+}
+
+int main() {
+    std::cout << "binomo cpp api quote parser benchmark" << std::endl;
+    const size_t repeats = 20;
+    std::vector<binomo_api::common::StreamTick> ticks_expected;
+    const std::vector<std::string> frames = get_test_frames(10000, ticks_expected);
+
+    /* проверяем результат обоих парсеров */
+    std::vector<binomo_api::common::StreamTick> ticks_dom;
+    std::vector<binomo_api::common::StreamTick> ticks_frame;
+    for(size_t i = 0; i < frames.size(); ++i) {
+        parse_quotes_dom(frames[i], [&](const binomo_api::common::StreamTick &tick) {
+            ticks_dom.push_back(tick);
+        });
+        binomo_api::QuoteFrameParser::parse(frames[i].data(), frames[i].size(), [&](const binomo_api::common::StreamTick &tick) {
+            ticks_frame.push_back(tick);
+        });
+    }
+    double max_time_diff = 0;
+    /* метка времени - сумма секунд и дробной части, поэтому допускается ошибка округления */
+    const bool is_frame_equal = is_equal_ticks(ticks_expected, ticks_frame, 1e-7, max_time_diff);
+    std::cout << "in-place results are equal to expected: " << (is_frame_equal ? "yes" : "no") <<
+        ", max time difference " << max_time_diff << " s" << std::endl;
+    const bool is_dom_equal = is_equal_ticks(ticks_expected, ticks_dom, 1e-3, max_time_diff);
+    std::cout << "dom results are equal to expected: " << (is_dom_equal ? "yes" : "no") <<
+        ", max time difference " << max_time_diff << " s" << std::endl;
+
+    /* проверяем, что разбор тика и обновление бара не выделяют память */
+    std::vector<binomo_api::CandleSeries<binomo_api::common::Candle>> series(binomo_api::common::SymbolRegistry::get().size());
+    size_t allocation_ticks = 0;
+    auto update_candle = [&](const binomo_api::common::StreamTick &tick) {
+        binomo_api::CandleSeries<binomo_api::common::Candle> &value = series[tick.symbol_id];
+        const xtime::timestamp_t bar_timestamp = (xtime::timestamp_t)tick.timestamp - ((xtime::timestamp_t)tick.timestamp % 60);
+        value.begin_write();
+        binomo_api::common::Candle *candle = value.find(bar_timestamp);
+        if(candle == nullptr) {
+            value.set(binomo_api::common::Candle(tick.price, tick.price, tick.price, tick.price, bar_timestamp));
+        } else {
+            candle->close = tick.price;
+            if(tick.price > candle->high) candle->high = tick.price;
+            if(tick.price < candle->low) candle->low = tick.price;
+        }
+        value.end_write();
+        ++allocation_ticks;
+    };
+    const uint64_t start_allocations = allocations;
+    for(size_t r = 0; r < repeats; ++r) {
+        for(size_t i = 0; i < frames.size(); ++i) {
+            binomo_api::QuoteFrameParser::parse(frames[i].data(), frames[i].size(), update_candle);
+        }
+    }
+    const uint64_t tick_allocations = allocations - start_allocations;
+    std::cout << "allocations: " << tick_allocations << " for " << allocation_ticks << " ticks (" <<
+        (allocation_ticks > 0 ? (double)tick_allocations / (double)allocation_ticks : 0.0) << " per tick)" << std::endl;
+
+    const double speed_dom = run_benchmark("dom", frames, repeats,
+            [](const std::string &frame, size_t &total) {
+        parse_quotes_dom(frame, [&](const binomo_api::common::StreamTick &) {
+            ++total;
+        });
+    });
+    const double speed_frame = run_benchmark("in-place", frames, repeats,
+            [](const std::string &frame, size_t &total) {
+        binomo_api::QuoteFrameParser::parse(frame.data(), frame.size(), [&](const binomo_api::common::StreamTick &) {
+            ++total;
+        });
+    });
+    if(speed_dom > 0) std::cout << "speedup: " << (speed_frame / speed_dom) << "x" << std::endl;
+    return 0;
+}
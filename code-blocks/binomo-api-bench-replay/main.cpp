@@ -0,0 +1,82 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include "binomo-cpp-api-replay.hpp"
+
+/* вариант подписки потока котировок */
+class ReplayCase {
+public:
+    std::string name;
+    std::vector<uint32_t> periods;
+};
+
+/* источник синтетических тиков: несколько символов, тик каждые 250 мс */
+binomo_api::BinomoApiReplay<>::tick_source_t make_test_source(
+        const std::vector<std::string> &symbols,
+        const size_t ticks) {
+    std::vector<binomo_api::common::SymbolId> symbol_ids;
+    for(size_t i = 0; i < symbols.size(); ++i) {
+        symbol_ids.push_back(binomo_api::common::get_symbol_id(symbols[i]));
+    }
+    std::shared_ptr<size_t> index = std::make_shared<size_t>(0);
+    return [symbol_ids, ticks, index](binomo_api::common::StreamTick &tick) -> bool {
+        if(*index >= ticks) return false;
+        const size_t i = (*index)++;
+        tick.symbol_id = symbol_ids[i % symbol_ids.size()];
+        tick.precision = 5;
+        tick.price = 1.17543 + 0.00001 * (double)((i * 7919) % 200);
+        tick.timestamp = 1598918400.0 + 0.25 * (double)i;
+        return true;
+    };
+}
+
+int main(int argc, char *argv[]) {
+    std::cout << "binomo cpp api replay benchmark" << std::endl;
+    /* аргументы: файлы ленты тиков. Без аргументов используются синтетические тики */
+    std::vector<std::string> tape_files;
+    for(int i = 1; i < argc; ++i) tape_files.push_back(argv[i]);
+    const std::vector<std::string> symbols = {"EURUSD", "GBPUSD", "USDJPY", "BTCUSD"};
+    const size_t ticks = 4000000;
+
+    std::vector<ReplayCase> cases = {
+        {"M1", {60}},
+        {"M1-M5-M15-H1", {60, 300, 900, 3600}},
+    };
+
+    for(size_t c = 0; c < cases.size(); ++c) {
+        binomo_api::BinomoApiPriceStream<> stream;
+        std::vector<std::pair<std::string, uint32_t>> symbol_list;
+        for(size_t s = 0; s < symbols.size(); ++s) {
+            for(size_t p = 0; p < cases[c].periods.size(); ++p) {
+                symbol_list.push_back(std::make_pair(symbols[s], cases[c].periods[p]));
+            }
+        }
+        stream.add_candles_stream(symbol_list);
+
+        uint64_t closed_candles = 0;
+        stream.on_candle = [&](
+                const binomo_api::common::SymbolId symbol_id,
+                const binomo_api::common::Candle &candle,
+                const uint32_t period,
+                const bool close_candle) {
+            if(close_candle) ++closed_candles;
+        };
+
+        binomo_api::BinomoApiReplay<> replay(stream, binomo_api::BinomoApiReplay<>::MAX_SPEED);
+        if(tape_files.empty()) replay.add_source(make_test_source(symbols, ticks));
+        else replay.add_source(binomo_api::BinomoApiReplay<>::make_tape_source(tape_files));
+        replay.run();
+
+        const binomo_api::BinomoApiReplay<>::Stats stats = replay.get_stats();
+        std::cout << cases[c].name
+            << ": ticks " << stats.ticks
+            << ", closed candles " << closed_candles
+            << ", time " << stats.elapsed << " s"
+            << ", " << (stats.elapsed > 0 ? (double)stats.ticks / stats.elapsed : 0) << " ticks/s"
+            << ", memory " << (stream.get_memory_usage() / 1024) << " KB"
+            << std::endl;
+    }
+    return 0;
+}
@@ -8,13 +8,13 @@ int main() {
     binomo_api::BinomoApiPriceStream<> price_streams;
 
     price_streams.on_candle = [&](
-            const std::string &symbol,
+            const binomo_api::common::SymbolId symbol_id,
             const binomo_api::common::Candle &candle,
             const uint32_t period,
             const bool close_candle) {
         if(close_candle) std::cout << "close ";
         std::cout
-            << symbol
+            << binomo_api::common::get_symbol_name(symbol_id)
             //<< " o: " << candle.open
             << " c: " << candle.close
             << " h: " << candle.high
@@ -27,7 +27,7 @@ int main() {
 
     price_streams.on_tick = [&](const binomo_api::common::StreamTick &tick) {
         std::cout
-            << tick.symbol
+            << binomo_api::common::get_symbol_name(tick.symbol_id)
             << " p: " << tick.price
             << " t: " << xtime::get_str_time(tick.timestamp)
             << std::endl;
@@ -0,0 +1,113 @@
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <string>
+#include "binomo-cpp-api.hpp"
+#include "client_ws.hpp"
+
+/* Проверка контроля связи с брокером
+ *
+ * Программа подключается к API как расширение браузера и отвечает на пинги,
+ * затем перестает отвечать дольше нескольких dead_timeout, продолжая слать другие сообщения брокера.
+ * Состояние связи должно оставаться DEAD, а соединение - закрытым, пока не придет ответ на пинг
+ */
+
+using json = nlohmann::json;
+using WsClient = SimpleWeb::SocketClient<SimpleWeb::WS>;
+
+int main() {
+    std::cout << "binomo cpp api link monitor test" << std::endl;
+    const uint32_t port = 8090;
+    const uint32_t period_ms = 200;
+    const double degraded_timeout = 0.5;
+    const double dead_timeout = 1.0;
+
+    binomo_api::BinomoApi api(port);
+    api.set_link_monitor(period_ms, degraded_timeout, dead_timeout, 0.0);
+    api.start();
+
+    std::atomic<bool> is_reply = ATOMIC_VAR_INIT(true);
+    std::shared_ptr<WsClient::Connection> client_connection;
+    std::mutex client_connection_mutex;
+
+    WsClient client("localhost:" + std::to_string(port) + "/binomo-api");
+    client.on_open = [&](std::shared_ptr<WsClient::Connection> connection) {
+        {
+            std::lock_guard<std::mutex> lock(client_connection_mutex);
+            client_connection = connection;
+        }
+        connection->send("{\"event\":\"socket\",\"body\":{\"status\":\"open\",\"authtoken\":\"test\",\"device_id\":\"test\"}}");
+    };
+    client.on_message = [&](std::shared_ptr<WsClient::Connection> connection, std::shared_ptr<WsClient::InMessage> message) {
+        // {"topic":"phoenix","event":"heartbeat","payload":{},"ref":"275"}
+        // {"event":"phx_reply","payload":{"response":{},"status":"ok"},"ref":"275","topic":"phoenix"}
+        if(!is_reply) return;
+        json j = json::parse(message->string(), nullptr, false);
+        if(!j.is_object()) return;
+        if(j["event"] != "heartbeat" && j["event"] != "ping") return;
+        json j_reply;
+        j_reply["event"] = "phx_reply";
+        j_reply["payload"]["response"] = json::object();
+        j_reply["payload"]["status"] = "ok";
+        j_reply["ref"] = j["ref"];
+        j_reply["topic"] = j["topic"];
+        connection->send(j_reply.dump());
+    };
+    std::atomic<bool> is_stop = ATOMIC_VAR_INIT(false);
+    std::thread client_thread([&]() {
+        /* сервер API мог еще не запуститься, поэтому переподключаемся */
+        while(!is_stop) {
+            client.start();
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    });
+
+    int err = 0;
+    auto check = [&](const bool value, const std::string &message) {
+        std::cout << (value ? "ok: " : "FAIL: ") << message << std::endl;
+        if(!value) err = 1;
+    };
+
+    /* связь с ответами на пинги */
+    for(int i = 0; i < 50 && !api.connected(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    check(api.connected(), "connected");
+    check(api.get_link_state() == binomo_api::common::LinkState::OK, "state OK while pings are answered");
+
+    /* расширение перестает отвечать на пинги */
+    is_reply = false;
+    std::this_thread::sleep_for(std::chrono::milliseconds((uint64_t)(dead_timeout * 1000.0) + 2 * period_ms));
+    check(api.get_link_state() == binomo_api::common::LinkState::DEAD, "state DEAD after dead_timeout without replies");
+
+    /* без ответов состояние не должно возвращаться в DEGRADED или OK,
+     * даже если приходят другие сообщения брокера
+     */
+    bool is_sticky = true;
+    const xtime::ftimestamp_t stop_timestamp = xtime::get_ftimestamp() + 3.0 * dead_timeout;
+    while(xtime::get_ftimestamp() < stop_timestamp) {
+        {
+            std::lock_guard<std::mutex> lock(client_connection_mutex);
+            if(client_connection) client_connection->send("{\"event\":\"majority_opinion\",\"payload\":{\"asset\":\"EUR/GBP\",\"call\":66,\"put\":34},\"ref\":null,\"topic\":\"base\"}");
+        }
+        if(api.get_link_state() != binomo_api::common::LinkState::DEAD) is_sticky = false;
+        if(api.get_link_stats().state != binomo_api::common::LinkState::DEAD) is_sticky = false;
+        if(api.connected()) is_sticky = false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    check(is_sticky, "state stays DEAD and disconnected for 3 x dead_timeout without replies");
+    check(api.get_link_stats().missed > 0, "missed pings are counted");
+
+    /* ответ на пинг восстанавливает связь */
+    is_reply = true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(3 * period_ms));
+    check(api.get_link_state() == binomo_api::common::LinkState::OK, "state OK after a ping reply");
+    check(api.connected(), "connected after a ping reply");
+
+    is_stop = true;
+    client.stop();
+    client_thread.join();
+    std::cout << (err == 0 ? "test passed" : "test failed") << std::endl;
+    return err;
+}
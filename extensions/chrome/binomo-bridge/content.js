@@ -40,6 +40,86 @@ var is_last_error = false;
 
 var is_unsubscribe = false;
 
+/* фильтр сообщений брокера
+ * список событий, которые нужно пересылать, присылает сервер API после открытия соединения
+ * null - пересылать все сообщения
+ */
+var api_events = null;
+var user_events = "";			// дополнительные события из настроек расширения, "*" - отключить фильтр
+var forward_events = null;
+var is_batch = false;			// объединять сообщения в один кадр на каждый кадр анимации
+var batch_frames = [];
+var is_batch_scheduled = false;
+var is_debug_log = false;		// выводить каждое сообщение в консоль
+
+/* обновить список пересылаемых событий */
+function update_forward_events() {
+	if(api_events === null || user_events.trim() == "*") {
+		forward_events = null;
+		return;
+	}
+	forward_events = {};
+	for(var i = 0; i < api_events.length; ++i) {
+		forward_events[api_events[i]] = true;
+	}
+	var events = user_events.split(",");
+	for(var i = 0; i < events.length; ++i) {
+		var event = events[i].trim();
+		if(event.length > 0) forward_events[event] = true;
+	}
+}
+
+/* получить тип события без полного разбора JSON */
+function get_event_type(data) {
+	var pos = data.indexOf('"event":"');
+	if(pos < 0) return null;
+	pos += 9;
+	var end = data.indexOf('"', pos);
+	if(end < 0) return null;
+	return data.substring(pos, end);
+}
+
+/* отправить накопленные сообщения одним кадром */
+function flush_batch() {
+	is_batch_scheduled = false;
+	if(batch_frames.length == 0) return;
+	if(is_api_socket) {
+		if(batch_frames.length == 1) api_socket.send(batch_frames[0]);
+		else api_socket.send('{"event":"batch","body":[' + batch_frames.join(',') + ']}');
+	}
+	batch_frames = [];
+}
+
+/* переслать сообщение брокера серверу API */
+function forward_to_api(data) {
+	if(!is_api_socket) return;
+	if(forward_events !== null && forward_events[get_event_type(data)] !== true) return;
+	/* в фоновой вкладке requestAnimationFrame не вызывается, поэтому отправляем сразу */
+	if(!is_batch || document.hidden) {
+		flush_batch();
+		api_socket.send(data);
+		return;
+	}
+	batch_frames.push(data);
+	if(!is_batch_scheduled) {
+		is_batch_scheduled = true;
+		requestAnimationFrame(flush_batch);
+	}
+}
+
+/* применить настройки моста от сервера API
+ * {"topic":"bridge","event":"filter","payload":{"events":["phx_reply","deal_created"],"batch":false}}
+ */
+function apply_bridge_config(data) {
+	var message = JSON.parse(data);
+	if(message.event != "filter") return;
+	if(message.payload.events instanceof Array) api_events = message.payload.events;
+	else api_events = null;
+	is_batch = (message.payload.batch === true);
+	update_forward_events();
+	console.log("bridge filter: " + (api_events === null ? "all" : api_events.join(",")) + ", batch: " + is_batch);
+}
+
 function getUuid() {
     return(Date.now().toString(36)+Math.random().toString(36).substr(2,12)).toUpperCase()
 }
@@ -172,6 +252,7 @@ function injected_main() {
         }, 
 		socket.onclose = function(t) {
 			is_socket = false;
+			flush_batch();
             if(is_api_socket) {
 				api_socket.send('{"event":"init","body":{"connection_status":"reconnecting"}}');
 				connect_broker(); 
@@ -180,10 +261,8 @@ function injected_main() {
 			console.log("Код: " + t.code + " причина: " + t.reason);
         }, 
 		socket.onmessage = function(t) {
-			console.log("Получены данные" + t.data);
-			if(is_api_socket) {
-				api_socket.send(t.data);
-			}		
+			if(is_debug_log) console.log("Получены данные" + t.data);
+			forward_to_api(t.data);
         }, 
 		socket.onerror = function(t) {
 			is_socket = false;
@@ -199,6 +278,10 @@ function injected_main() {
 		api_socket = new WebSocket("ws://localhost:" + port + "/binomo-api"), 
 		api_socket.onopen = function() {
 			is_api_socket = true;
+			/* до согласования с сервером API пересылаем все сообщения */
+			api_events = null;
+			is_batch = false;
+			update_forward_events();
 			connect_broker();
 			console.log("Соединение с сервером API установлено.");
 		}, api_socket.onclose = function(t) {
@@ -214,9 +297,13 @@ function injected_main() {
 			t.wasClean ? console.log("Соединение с сервером API закрыто чисто") : console.log("Обрыв соединения с сервером API"), 
 			console.log("Код: " + t.code + " причина: " + t.reason);
 		}, api_socket.onmessage = function(t) {
-			console.log("Получены данные от сервера API: " + t.data); 
+			if(is_debug_log) console.log("Получены данные от сервера API: " + t.data);
 			
-			// var api_message = JSON.parse(t.data);
+			/* настройки моста не пересылаем брокеру */
+			if(t.data.indexOf('"topic":"bridge"') >= 0) {
+				apply_bridge_config(t.data);
+				return;
+			}
 			
 			if(is_socket) {
 				socket.send(t.data);
@@ -231,12 +318,16 @@ function injected_main() {
 		}
     }
 	
-	chrome.storage.local.get("binomo_bridge_1v0_ws_port", function(result) {
-		if(result.primexbt_bridge_1v0_ws_port) {
-			port = result.primexbt_bridge_1v0_ws_port; 
+	chrome.storage.local.get(["binomo_bridge_1v0_ws_port", "binomo_bridge_1v0_events"], function(result) {
+		if(result.binomo_bridge_1v0_ws_port) {
+			port = result.binomo_bridge_1v0_ws_port; 
 		} else {
 			port = 8082;
 		}
+		if(result.binomo_bridge_1v0_events) {
+			user_events = result.binomo_bridge_1v0_events;
+			update_forward_events();
+		}
 		console.log('port: ' + port);
 		connect_api();
     });
@@ -257,6 +348,11 @@ function injected_main() {
 					connect_api();
 				}
 				console.log('port: ' + port);
+			} else
+			if(key == "binomo_bridge_1v0_events") {
+				user_events = storageChange.newValue;
+				update_forward_events();
+				console.log('events: ' + user_events);
 			}
 		}
 	});
@@ -2,7 +2,9 @@
 function apply_settings() {
     var port = document.getElementById('port').value;
 	console.log("port " + port);
-	chrome.storage.local.set({"binomo_bridge_1v0_ws_port": port}, function() {
+	var events = document.getElementById('events').value;
+	console.log("events " + events);
+	chrome.storage.local.set({"binomo_bridge_1v0_ws_port": port, "binomo_bridge_1v0_events": events}, function() {
 		console.log("Settings saved");
 	});
  
@@ -29,9 +29,20 @@
 #include <sstream>
 #include <mutex>
 #include <algorithm>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstring>
 #include <nlohmann/json.hpp>
 #include "tools/base36.h"
 #include "xtime.hpp"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace binomo_api {
     namespace common {
@@ -55,6 +66,9 @@ namespace binomo_api {
             NO_PRICE_STREAM_SUBSCRIPTION = -13,
             AUTHORIZATION_ERROR = -14,
             INVALID_CONTRACT_TYPE = -15,
+            CONNECTION_LOST = -16,              ///< Брокер не отвечает на пинги, соединение считается потерянным
+            DECOMPRESSION_ERROR = -17,          ///< Ошибка распаковки сжатого ответа сервера
+            WRONG_THREAD = -18,                 ///< Синхронный метод вызван из потока асинхронных запросов и никогда не дождался бы ответа
         };
 
         /// Состояния сделки
@@ -68,6 +82,41 @@ namespace binomo_api {
             STANDOFF,
         };
 
+        /// Причина отклонения сделки брокером
+        enum class BetRejectType {
+            NONE,               /**< Сделка не отклонялась */
+            EXPIRATION_TIME,    /**< Время экспирации недоступно, нужно пересчитать экспирацию */
+            UNMATCHED_TOPIC,    /**< Канал base не подключен, нужно повторить phx_join */
+            TEMPORARY,          /**< Временная ошибка, сделку можно повторить без изменений */
+            FATAL,              /**< Повтор сделки не имеет смысла */
+        };
+
+        /// Состояние связи с брокером
+        enum class LinkState {
+            DISCONNECTED,       /**< Соединения нет */
+            OK,                 /**< Брокер отвечает на пинги */
+            DEGRADED,           /**< Ответ на пинг задерживается */
+            DEAD,               /**< Ответа на пинг нет, соединение считается потерянным */
+        };
+
+        /// Статистика связи с брокером
+        class LinkStats {
+        public:
+            LinkState state = LinkState::DISCONNECTED;
+            double last_rtt = 0;                /**< Время последнего ответа на пинг, в секундах */
+            double rtt_p50 = 0;                 /**< Медиана времени ответа, в секундах */
+            double rtt_p90 = 0;                 /**< 90-й перцентиль времени ответа, в секундах */
+            double rtt_p99 = 0;                 /**< 99-й перцентиль времени ответа, в секундах */
+            double rtt_max = 0;                 /**< Максимальное время ответа в выборке, в секундах */
+            uint32_t samples = 0;               /**< Размер выборки */
+            uint64_t pings = 0;                 /**< Количество отправленных пингов */
+            uint64_t replies = 0;               /**< Количество полученных ответов */
+            uint64_t missed = 0;                /**< Количество пингов без ответа */
+            double last_reply_timestamp = 0;    /**< Метка времени последнего ответа */
+
+            LinkStats() {};
+        };
+
         /// Направление ставки
         enum ContractType {
             BUY = 1,
@@ -125,11 +174,20 @@ namespace binomo_api {
             }
         };
 
+        /** \brief Номер символа
+         *
+         * Номер присваивается символу один раз реестром SymbolRegistry и
+         * используется во внутренних таблицах вместо имени символа
+         */
+        using SymbolId = uint32_t;
+
+        const SymbolId INVALID_SYMBOL_ID = 0xFFFFFFFF;
+
         /** \brief Класс для хранения данных тика
          */
         class StreamTick {
         public:
-            std::string symbol;
+            SymbolId symbol_id = INVALID_SYMBOL_ID;     /**< Номер символа, имя можно получить через get_symbol_name() */
             double price = 0;
             xtime::ftimestamp_t timestamp = 0;
             uint32_t precision = 0;
@@ -178,6 +236,7 @@ namespace binomo_api {
         public:
             uint64_t api_bet_id = 0;
             uint64_t broker_bet_id = 0;
+            SymbolId symbol_id = INVALID_SYMBOL_ID;     /**< Номер символа */
             std::string symbol_name;
             std::string note;
 
@@ -196,6 +255,8 @@ namespace binomo_api {
             double close_price = 0;
             bool is_demo = false;                       /**< Флаг демо аккаунта */
             BetStatus bet_status = BetStatus::UNKNOWN_STATE;
+            BetRejectType reject_type = BetRejectType::NONE;    /**< Причина последнего отклонения сделки */
+            uint32_t attempts = 0;                      /**< Количество попыток открыть сделку */
 
             Bet() {};
         };
@@ -489,6 +550,100 @@ namespace binomo_api {
             }
         };
 
+        /// Настройки потоков соединения
+        class ThreadConfig {
+        public:
+            uint32_t io_threads = 1;            /**< Количество потоков io_service */
+            std::vector<int> io_cores;          /**< Ядра для потоков io_service. Поток i закрепляется за ядром io_cores[i % io_cores.size()]. Пустой список - без закрепления */
+            std::vector<int> callback_cores;    /**< Ядра для потоков, которые вызывают пользовательские функции обратного вызова */
+            std::string name;                   /**< Префикс имени потоков. Пустая строка - имена не задаются */
+
+            ThreadConfig() {};
+        };
+
+        /** \brief Закрепить текущий поток за ядром процессора
+         * \param core Номер ядра
+         * \return Вернет true в случае успеха
+         */
+        bool set_thread_affinity(const int core) {
+            if(core < 0) return false;
+#           ifdef _WIN32
+            if(core >= (int)(sizeof(DWORD_PTR) * 8)) return false;
+            const DWORD_PTR mask = ((DWORD_PTR)1) << core;
+            return SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#           else
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            CPU_SET(core, &cpuset);
+            return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset) == 0;
+#           endif
+        }
+
+        /** \brief Задать имя текущего потока
+         *
+         * Имя видно в отладчике и профилировщике.
+         * В Windows используется SetThreadDescription, если она есть в системе
+         * \param name Имя потока
+         */
+        void set_thread_name(const std::string &name) {
+            if(name.empty()) return;
+#           ifdef _WIN32
+            typedef HRESULT (WINAPI *set_thread_description_t)(HANDLE, PCWSTR);
+            HMODULE kernel = GetModuleHandleW(L"kernel32.dll");
+            if(kernel == NULL) return;
+            set_thread_description_t set_thread_description =
+                (set_thread_description_t)(void*)GetProcAddress(kernel, "SetThreadDescription");
+            if(set_thread_description == NULL) return;
+            std::wstring wname(name.begin(), name.end());
+            set_thread_description(GetCurrentThread(), wname.c_str());
+#           else
+            /* в linux длина имени ограничена 15 символами */
+            pthread_setname_np(pthread_self(), name.substr(0, 15).c_str());
+#           endif
+        }
+
+        /** \brief Применить настройки к текущему потоку
+         * \param cores Список ядер
+         * \param index Номер потока в группе
+         * \param name Имя потока
+         */
+        void apply_thread_config(
+                const std::vector<int> &cores,
+                const size_t index,
+                const std::string &name) {
+            if(!cores.empty()) set_thread_affinity(cores[index % cores.size()]);
+            set_thread_name(name);
+        }
+
+        /** \brief Запустить io_service в нескольких потоках
+         *
+         * Метод блокирует вызывающий поток, пока io_service не остановится
+         * \param io_service Сервис ввода-вывода
+         * \param config Настройки потоков
+         * \param role Роль потоков, добавляется к имени потока
+         */
+        template<class IO_SERVICE>
+        void run_io_service(
+                std::shared_ptr<IO_SERVICE> io_service,
+                const ThreadConfig &config,
+                const std::string &role) {
+            const size_t threads = std::max((uint32_t)1, config.io_threads);
+            auto run = [&](const size_t index) {
+                std::string name;
+                if(!config.name.empty()) name = config.name + "-" + role + std::to_string(index);
+                apply_thread_config(config.io_cores, index, name);
+                io_service->run();
+            };
+            std::vector<std::thread> pool;
+            for(size_t i = 1; i < threads; ++i) {
+                pool.emplace_back(run, i);
+            }
+            run(0);
+            for(auto &t : pool) {
+                t.join();
+            }
+        }
+
         std::string to_upper_case(const std::string &s){
             std::string temp = s;
             std::transform(temp.begin(), temp.end(), temp.begin(), [](char ch) {
@@ -524,6 +679,158 @@ namespace binomo_api {
             return to_upper_case(symbol_name);
         }
 
+        /** \brief Реестр символов
+         *
+         * Реестр присваивает номера всем символам брокера при первом обращении
+         * и после этого не изменяется, поэтому его можно читать из любого потока без блокировок
+         */
+        class SymbolRegistry {
+        public:
+
+            /// Параметры символа
+            class SymbolInfo {
+            public:
+                std::string name;           /**< Нормализованное имя символа, например EURUSD */
+                std::string ric;            /**< Имя символа в потоке котировок */
+                std::string display_name;   /**< Имя символа в терминале брокера */
+                uint32_t asset_id = 0;      /**< Номер актива у брокера */
+                uint32_t precision = 0;     /**< Количество знаков после запятой */
+
+                SymbolInfo() {};
+            };
+
+        private:
+            std::vector<SymbolInfo> symbols;
+            std::unordered_map<std::string, SymbolId> name_to_id;
+            std::vector<SymbolId> ric_table;   /**< Открытая адресация по хешу ric, поиск без выделения памяти */
+            SymbolInfo empty_info;
+
+            static inline uint32_t get_hash(const char *str, const size_t size) {
+                uint32_t hash = 2166136261u;
+                for(size_t i = 0; i < size; ++i) {
+                    hash = (hash ^ (uint8_t)str[i]) * 16777619u;
+                }
+                return hash;
+            }
+
+            SymbolRegistry() {
+                for(auto &item : normalize_name_to_ric) {
+                    SymbolInfo info;
+                    info.name = item.first;
+                    info.ric = item.second;
+                    auto it_name = normalize_name_to_name.find(item.first);
+                    if(it_name != normalize_name_to_name.end()) info.display_name = it_name->second;
+                    auto it_id = normalize_name_to_id.find(item.first);
+                    if(it_id != normalize_name_to_id.end()) info.asset_id = it_id->second;
+                    auto it_precision = normalize_name_to_precision.find(item.first);
+                    if(it_precision != normalize_name_to_precision.end()) info.precision = it_precision->second;
+                    const SymbolId id = (SymbolId)symbols.size();
+                    name_to_id[info.name] = id;
+                    symbols.push_back(info);
+                }
+                size_t table_size = 16;
+                while(table_size < symbols.size() * 2) table_size *= 2;
+                ric_table.assign(table_size, INVALID_SYMBOL_ID);
+                for(SymbolId id = 0; id < symbols.size(); ++id) {
+                    const std::string &ric = symbols[id].ric;
+                    size_t slot = get_hash(ric.data(), ric.size()) & (table_size - 1);
+                    while(ric_table[slot] != INVALID_SYMBOL_ID) slot = (slot + 1) & (table_size - 1);
+                    ric_table[slot] = id;
+                }
+            }
+
+        public:
+
+            SymbolRegistry(const SymbolRegistry&) = delete;
+            SymbolRegistry &operator=(const SymbolRegistry&) = delete;
+
+            /** \brief Получить реестр символов
+             * \return Реестр символов
+             */
+            static const SymbolRegistry &get() {
+                static SymbolRegistry registry;
+                return registry;
+            }
+
+            /** \brief Получить количество символов
+             *
+             * Номера символов лежат в диапазоне от 0 до size() - 1
+             * \return Количество символов
+             */
+            inline size_t size() const {
+                return symbols.size();
+            }
+
+            /** \brief Получить номер символа по имени
+             * \param symbol Имя символа в любом виде, например EURUSD или EUR/USD
+             * \return Номер символа или INVALID_SYMBOL_ID
+             */
+            SymbolId get_id(const std::string &symbol) const {
+                auto it = name_to_id.find(symbol);
+                if(it != name_to_id.end()) return it->second;
+                it = name_to_id.find(normalize_symbol_name(symbol));
+                if(it != name_to_id.end()) return it->second;
+                return INVALID_SYMBOL_ID;
+            }
+
+            /** \brief Получить номер символа по имени в потоке котировок
+             * \param ric Имя символа в потоке котировок, например EURO
+             * \return Номер символа или INVALID_SYMBOL_ID
+             */
+            inline SymbolId get_id_by_ric(const std::string &ric) const {
+                return get_id_by_ric(ric.data(), ric.size());
+            }
+
+            /** \brief Получить номер символа по имени в потоке котировок без выделения памяти
+             * \param ric Имя символа в потоке котировок
+             * \param size Длина имени
+             * \return Номер символа или INVALID_SYMBOL_ID
+             */
+            SymbolId get_id_by_ric(const char *ric, const size_t size) const {
+                const size_t mask = ric_table.size() - 1;
+                size_t slot = get_hash(ric, size) & mask;
+                while(ric_table[slot] != INVALID_SYMBOL_ID) {
+                    const std::string &value = symbols[ric_table[slot]].ric;
+                    if(value.size() == size && std::memcmp(value.data(), ric, size) == 0) return ric_table[slot];
+                    slot = (slot + 1) & mask;
+                }
+                return INVALID_SYMBOL_ID;
+            }
+
+            /** \brief Получить параметры символа
+             * \param id Номер символа
+             * \return Параметры символа, пустые для неизвестного номера
+             */
+            inline const SymbolInfo &get_info(const SymbolId id) const {
+                if(id >= symbols.size()) return empty_info;
+                return symbols[id];
+            }
+
+            /** \brief Получить нормализованное имя символа
+             * \param id Номер символа
+             * \return Имя символа, пустое для неизвестного номера
+             */
+            inline const std::string &get_name(const SymbolId id) const {
+                return get_info(id).name;
+            }
+        };
+
+        /** \brief Получить номер символа по имени
+         * \param symbol Имя символа
+         * \return Номер символа или INVALID_SYMBOL_ID
+         */
+        inline SymbolId get_symbol_id(const std::string &symbol) {
+            return SymbolRegistry::get().get_id(symbol);
+        }
+
+        /** \brief Получить нормализованное имя символа по номеру
+         * \param id Номер символа
+         * \return Имя символа, пустое для неизвестного номера
+         */
+        inline const std::string &get_symbol_name(const SymbolId id) {
+            return SymbolRegistry::get().get_name(id);
+        }
+
         inline std::string get_uuid() {
             uint64_t timestamp1000 = xtime::get_ftimestamp() * 1000.0 + 0.5;
             std::string temp(CBase36::encodeInt(timestamp1000));
@@ -25,8 +25,11 @@
 #define BINOMO_CPP_API_HTTP_HPP_INCLUDED
 
 #include "binomo-cpp-api-common.hpp"
+#include "tools/binomo-cpp-api-candle-store.hpp"
+#include "tools/binomo-cpp-api-history-parser.hpp"
+#include "tools/binomo-cpp-api-rate-limiter.hpp"
 #include <curl/curl.h>
-#include <gzip/decompress.hpp>
+#include <zlib.h>
 #include <nlohmann/json.hpp>
 #include "xtime.hpp"
 #include <thread>
@@ -35,6 +38,12 @@
 #include <atomic>
 #include <array>
 #include <map>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <cstring>
+#include <deque>
+#include <condition_variable>
 //#include "utf8.h" // http://utfcpp.sourceforge.net/
 
 namespace binomo_api {
@@ -52,14 +61,128 @@ namespace binomo_api {
         std::string device_id;
         std::mutex auth_mutex;
 
-        char error_buffer[CURL_ERROR_SIZE];
+        std::string api_url = "https://api.binomo.com";  /**< Адрес API, может быть заменен на локальный сервер */
+        std::mutex api_url_mutex;
+
         static const int TIME_OUT = 60; 				/**< Время ожидания ответа сервера для разных запросов */
+        static const size_t CURL_POOL_SIZE = 16;        /**< Максимальное количество простаивающих соединений в пуле */
+
+        /** \brief Соединение CURL из пула
+         *
+         * Постоянные настройки (сертификат, буфер ошибок, общий кэш) задаются один раз,
+         * перед каждым запросом меняются только параметры запроса
+         */
+        class CurlHandle {
+        public:
+            CURL *curl = nullptr;
+            char error_buffer[CURL_ERROR_SIZE];
+
+            CurlHandle() {
+                error_buffer[0] = '\0';
+            };
+
+            ~CurlHandle() {
+                if(curl != nullptr) curl_easy_cleanup(curl);
+            };
+        };
+
+        /* пулы соединений. Соединения с cookie и без cookie не смешиваются,
+         * чтобы запросы без cookie не отправляли их случайно
+         */
+        std::vector<std::unique_ptr<CurlHandle>> curl_pool;
+        std::vector<std::unique_ptr<CurlHandle>> curl_cookie_pool;
+        std::mutex curl_pool_mutex;
+
+        /* общие DNS-кэш и TLS-сессии соединений пула. Кэш соединений не разделяется:
+         * у каждого CURL из пула свое открытое соединение, поэтому потоки не спорят за один кэш
+         */
+        CURLSH *curl_share = nullptr;
+        CURLSH *curl_cookie_share = nullptr;
+        std::array<std::mutex, CURL_LOCK_DATA_LAST> curl_share_mutex;
+
+        static void curl_share_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr) {
+            (void)handle;
+            (void)access;
+            std::array<std::mutex, CURL_LOCK_DATA_LAST> *mutexes = (std::array<std::mutex, CURL_LOCK_DATA_LAST>*)userptr;
+            (*mutexes)[data].lock();
+        }
+
+        static void curl_share_unlock(CURL *handle, curl_lock_data data, void *userptr) {
+            (void)handle;
+            std::array<std::mutex, CURL_LOCK_DATA_LAST> *mutexes = (std::array<std::mutex, CURL_LOCK_DATA_LAST>*)userptr;
+            (*mutexes)[data].unlock();
+        }
+
+        /** \brief Создать общий кэш CURL
+         * \param is_use_cookie Разделять cookie между соединениями
+         * \return Указатель на общий кэш или nullptr
+         */
+        CURLSH *init_curl_share(const bool is_use_cookie) {
+            CURLSH *share = curl_share_init();
+            if(share == nullptr) return nullptr;
+            curl_share_setopt(share, CURLSHOPT_LOCKFUNC, curl_share_lock);
+            curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, curl_share_unlock);
+            curl_share_setopt(share, CURLSHOPT_USERDATA, &curl_share_mutex);
+            curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+            curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+            if(is_use_cookie) curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_COOKIE);
+            return share;
+        }
+
+        /** \brief Взять соединение из пула
+         *
+         * Если в пуле нет свободных соединений, будет создано новое
+         * \param is_use_cookie Использовать cookie файлы
+         * \return Соединение или nullptr, если CURL не удалось инициализировать
+         */
+        std::unique_ptr<CurlHandle> acquire_curl(const bool is_use_cookie) {
+            {
+                std::lock_guard<std::mutex> lock(curl_pool_mutex);
+                std::vector<std::unique_ptr<CurlHandle>> &pool = is_use_cookie ? curl_cookie_pool : curl_pool;
+                if(!pool.empty()) {
+                    std::unique_ptr<CurlHandle> handle = std::move(pool.back());
+                    pool.pop_back();
+                    return handle;
+                }
+            }
+            std::unique_ptr<CurlHandle> handle(new CurlHandle());
+            handle->curl = curl_easy_init();
+            if(handle->curl == nullptr) return nullptr;
+            curl_easy_setopt(handle->curl, CURLOPT_CAINFO, sert_file.c_str());
+            curl_easy_setopt(handle->curl, CURLOPT_ERRORBUFFER, handle->error_buffer);
+            curl_easy_setopt(handle->curl, CURLOPT_TCP_KEEPALIVE, 1L);
+            curl_easy_setopt(handle->curl, CURLOPT_NOSIGNAL, 1L);
+            CURLSH *share = is_use_cookie ? curl_cookie_share : curl_share;
+            if(share != nullptr) curl_easy_setopt(handle->curl, CURLOPT_SHARE, share);
+            if(is_use_cookie) {
+                curl_easy_setopt(handle->curl, CURLOPT_COOKIEFILE, cookie_file.c_str()); // запускаем cookie engine
+                curl_easy_setopt(handle->curl, CURLOPT_COOKIEJAR, cookie_file.c_str());
+            }
+            return handle;
+        }
+
+        /** \brief Вернуть соединение в пул
+         * \param handle Соединение
+         * \param is_use_cookie Использовать cookie файлы
+         */
+        void release_curl(std::unique_ptr<CurlHandle> handle, const bool is_use_cookie) {
+            if(!handle) return;
+            /* cookie записываем сразу, раньше это делал curl_easy_cleanup */
+            if(is_use_cookie) curl_easy_setopt(handle->curl, CURLOPT_COOKIELIST, "FLUSH");
+            std::lock_guard<std::mutex> lock(curl_pool_mutex);
+            std::vector<std::unique_ptr<CurlHandle>> &pool = is_use_cookie ? curl_cookie_pool : curl_pool;
+            if(pool.size() < CURL_POOL_SIZE) pool.push_back(std::move(handle));
+        }
 
         /** \brief Класс для хранения Http заголовков
+         *
+         * Готовый набор заголовков не изменяется и может одновременно
+         * использоваться несколькими запросами
          */
         class HttpHeaders {
         private:
             struct curl_slist *http_headers = nullptr;
+            std::vector<std::string> lines;     /**< Заголовки, из которых собран список */
         public:
 
             HttpHeaders() {};
@@ -70,13 +193,25 @@ namespace binomo_api {
                 }
             };
 
+            HttpHeaders(const HttpHeaders&) = delete;
+            HttpHeaders &operator=(const HttpHeaders&) = delete;
+
             void add_header(const std::string &header) {
                 http_headers = curl_slist_append(http_headers, header.c_str());
+                lines.push_back(header);
             }
 
             void add_header(const std::string &key, const std::string &val) {
-                std::string header(key + ": " + val);
-                http_headers = curl_slist_append(http_headers, header.c_str());
+                add_header(key + ": " + val);
+            }
+
+            /** \brief Получить заголовки, из которых собран список
+             *
+             * Нужны, чтобы собрать новый набор на основе готового
+             * \return Список заголовков
+             */
+            inline const std::vector<std::string> &get_lines() const {
+                return lines;
             }
 
             ~HttpHeaders() {
@@ -86,13 +221,21 @@ namespace binomo_api {
                 }
             };
 
-            inline struct curl_slist *get() {
+            inline struct curl_slist *get() const {
                 return http_headers;
             }
         };
 
+        using http_headers_t = std::shared_ptr<const HttpHeaders>;
+
+        http_headers_t none_security_headers;   /**< Заголовки запросов без авторизации */
+        http_headers_t options_headers;         /**< Заголовки OPTIONS запросов */
+        http_headers_t assets_headers;          /**< Заголовки запросов с авторизацией, защищены auth_mutex */
+
         std::atomic<xtime::ftimestamp_t> offset_timestamp = ATOMIC_VAR_INIT(0);
 
+        std::shared_ptr<CandleStore<CANDLE>> candle_store;  /**< Хранилище баров для загрузки только недостающей истории */
+
     public:
 
         /** \brief Получить метку времени сервера
@@ -111,64 +254,320 @@ namespace binomo_api {
 
     private:
 
-        /* ограничение количества запросов в минуту */
-        std::atomic<uint32_t> request_counter = ATOMIC_VAR_INIT(0);
-        std::atomic<uint32_t> request_limit = ATOMIC_VAR_INIT(30);
-        std::atomic<xtime::timestamp_t> request_timestamp = ATOMIC_VAR_INIT(0);
+        /* ограничение скорости запросов, по умолчанию общее для всех экземпляров */
+        std::shared_ptr<RateLimiter> rate_limiter = get_shared_rate_limiter();
 
-        void check_request_limit(const uint32_t weight = 1) {
-            request_counter += weight;
-            if(request_timestamp == 0) {
-                request_timestamp = xtime::get_first_timestamp_minute();
-                return;
-            } else
-            if(request_timestamp == xtime::get_first_timestamp_minute()) {
-                if(request_counter >= request_limit) {
-                    while(request_timestamp == xtime::get_first_timestamp_minute()) {
-                        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-                    }
-                    request_counter = 0;
-                    request_timestamp = xtime::get_first_timestamp_minute();
-                    return;
+        /** \brief Занять место в лимите запросов без ожидания
+         * \param weight Вес запроса
+         * \return Вернет true, если запрос можно отправить сейчас
+         */
+        inline bool try_request_limit(const uint32_t weight = 1) {
+            return std::atomic_load(&rate_limiter)->try_acquire(weight);
+        }
+
+        /** \brief Занять место в лимите запросов, ожидая его освобождения
+         * \param weight Вес запроса
+         */
+        inline void check_request_limit(const uint32_t weight = 1) {
+            std::atomic_load(&rate_limiter)->acquire(weight);
+        }
+
+        /** \brief Получить вес запросов к конечной точке API
+         * \param endpoint Имя конечной точки
+         * \return Вес запроса
+         */
+        inline uint32_t get_request_weight(const std::string &endpoint) {
+            return std::atomic_load(&rate_limiter)->get_weight(endpoint);
+        }
+
+        /** \brief Значение заголовка ответа
+         *
+         * Значение хранится в буфере фиксированного размера внутри приемника ответа,
+         * поэтому разбор заголовков не выделяет память. Слишком длинное значение не сохраняется
+         */
+        template<size_t SIZE>
+        class HeaderValue {
+        private:
+            std::array<char, SIZE> buffer;
+            size_t length = 0;
+        public:
+
+            HeaderValue() {};
+
+            /** \brief Сохранить значение
+             * \param data Значение
+             * \param size Длина значения
+             * \return Вернет false, если значение не поместилось в буфер
+             */
+            bool set(const char *data, const size_t size) {
+                if(size > SIZE) {
+                    length = 0;
+                    return false;
                 }
-            } else {
-                request_timestamp = xtime::get_first_timestamp_minute();
+                std::memcpy(buffer.data(), data, size);
+                length = size;
+                return true;
             }
-        }
 
-        /** \brief Callback-функция для обработки ответа
-         * Данная функция нужна для внутреннего использования
+            inline void clear() {
+                length = 0;
+            }
+
+            inline const char *data() const {
+                return buffer.data();
+            }
+
+            inline size_t size() const {
+                return length;
+            }
+
+            inline bool empty() const {
+                return length == 0;
+            }
+
+            inline std::string str() const {
+                return std::string(buffer.data(), length);
+            }
+
+            /** \brief Проверить, содержит ли значение строку, без учета регистра
+             * \param value Строка в нижнем регистре
+             * \return Вернет true, если строка найдена
+             */
+            bool contains(const char *value) const {
+                const size_t value_size = std::strlen(value);
+                if(value_size > length) return false;
+                for(size_t i = 0; i <= (length - value_size); ++i) {
+                    if(is_equal_lowercase(buffer.data() + i, value_size, value, value_size)) return true;
+                }
+                return false;
+            }
+        };
+
+        /** \brief Сравнить строки без учета регистра
+         * \param str Строка
+         * \param size Длина строки
+         * \param value Строка в нижнем регистре
+         * \param value_size Длина строки в нижнем регистре
+         * \return Вернет true, если строки совпадают
          */
-        static int binomo_writer(char *data, size_t size, size_t nmemb, void *userdata) {
-            int result = 0;
-            std::string *buffer = (std::string*)userdata;
-            if(buffer != NULL) {
-                buffer->append(data, size * nmemb);
-                result = size * nmemb;
+        static bool is_equal_lowercase(const char *str, const size_t size, const char *value, const size_t value_size) {
+            if(size != value_size) return false;
+            for(size_t i = 0; i < size; ++i) {
+                char c = str[i];
+                if(c >= 'A' && c <= 'Z') c = c - 'A' + 'a';
+                if(c != value[i]) return false;
             }
-            return result;
+            return true;
         }
 
-        /** \brief Парсер строки, состоящей из пары параметров
+        /** \brief Приемник ответа сервера
          *
-         * \param value Строка
-         * \param one Первое значение
-         * \param two Второе значение
+         * Сжатый ответ распаковывается потоково прямо в callback-функции записи,
+         * поэтому сжатое тело ответа целиком в памяти не хранится, накапливается только распакованный ответ.
+         * Данный класс нужен для внутреннего использования
          */
-        static void parse_pair(std::string value, std::string &one, std::string &two) {
-            if(value.back() != ' ' || value.back() != '\n' || value.back() != ' ') value += " ";
-            std::size_t start_pos = 0;
-            while(true) {
-                std::size_t found_beg = value.find_first_of(" \t\n", start_pos);
-                if(found_beg != std::string::npos) {
-                    std::size_t len = found_beg - start_pos;
-                    if(len > 0) {
-                        if(start_pos == 0) one = value.substr(start_pos, len);
-                        else two = value.substr(start_pos, len);
+        class ResponseWriter {
+        public:
+
+            /// Тип кодирования тела ответа
+            enum class Encoding {
+                UNKNOWN,        /**< Заголовки еще не разобраны */
+                IDENTITY,       /**< Ответ без сжатия */
+                GZIP,
+                DEFLATE,
+                NOT_SUPPORT,    /**< Кодирование не поддерживается */
+            };
+
+            HeaderValue<64> content_encoding;           /**< Заголовок Content-Encoding */
+            HeaderValue<32> retry_after;                /**< Заголовок Retry-After, число секунд или дата */
+            HeaderValue<128> etag;                      /**< Заголовок ETag */
+            HeaderValue<64> last_modified;              /**< Заголовок Last-Modified */
+            std::string response;                       /**< Распакованный ответ */
+            size_t received = 0;            /**< Количество принятых байт тела ответа */
+            long response_code = 0;         /**< Код статуса ответа */
+            bool is_stream_end = false;     /**< Сжатый поток распакован до конца */
+            bool is_error = false;          /**< Ошибка распаковки */
+
+            ResponseWriter() {};
+
+            ResponseWriter(const ResponseWriter&) = delete;
+            ResponseWriter &operator=(const ResponseWriter&) = delete;
+
+            ~ResponseWriter() {
+                if(is_stream_init) inflateEnd(&stream);
+            }
+
+            /** \brief Разобрать строку заголовка ответа
+             *
+             * Сохраняются только нужные заголовки, имена сравниваются без учета регистра.
+             * Строка статуса начинает новый ответ, например после 100 Continue,
+             * код статуса берется из CURLINFO_RESPONSE_CODE
+             * \param line Строка заголовка
+             * \param size Длина строки
+             */
+            void parse_header(const char *line, size_t size) {
+                while(size > 0 && (line[size - 1] == '\r' || line[size - 1] == '\n' ||
+                    line[size - 1] == ' ' || line[size - 1] == '\t')) --size;
+                if(size >= 5 && std::memcmp(line, "HTTP/", 5) == 0) {
+                    content_encoding.clear();
+                    retry_after.clear();
+                    etag.clear();
+                    last_modified.clear();
+                    encoding = Encoding::UNKNOWN;
+                    return;
+                }
+                const char *colon = (const char*)std::memchr(line, ':', size);
+                if(colon == nullptr) return;
+                const size_t name_size = colon - line;
+                size_t pos = name_size + 1;
+                while(pos < size && (line[pos] == ' ' || line[pos] == '\t')) ++pos;
+                const char *value = line + pos;
+                const size_t value_size = size - pos;
+                if(is_equal_lowercase(line, name_size, "content-encoding", 16)) content_encoding.set(value, value_size);
+                else if(is_equal_lowercase(line, name_size, "retry-after", 11)) retry_after.set(value, value_size);
+                else if(is_equal_lowercase(line, name_size, "etag", 4)) etag.set(value, value_size);
+                else if(is_equal_lowercase(line, name_size, "last-modified", 13)) last_modified.set(value, value_size);
+            }
+
+            /** \brief Получить паузу из заголовка Retry-After
+             *
+             * Поддерживаются обе формы заголовка: число секунд и дата в формате
+             * IMF-fixdate, например "Sun, 06 Nov 1994 08:49:37 GMT".
+             * Устаревшие форматы даты не разбираются
+             * \param timestamp Текущее время сервера
+             * \return Пауза в секундах или 0, если заголовка нет или его не удалось разобрать
+             */
+            double get_retry_after(const xtime::ftimestamp_t timestamp) const {
+                if(retry_after.empty()) return 0;
+                const char *str = retry_after.data();
+                const size_t size = retry_after.size();
+                uint32_t value = 0;
+                if(str[0] >= '0' && str[0] <= '9') {
+                    size_t len = 0;
+                    while(len < size && str[len] >= '0' && str[len] <= '9') ++len;
+                    if(!read_number(str, len, value)) return 0;
+                    return (double)value;
+                }
+                /* Sun, 06 Nov 1994 08:49:37 GMT */
+                if(size < 29 || str[3] != ',' || str[16] != ' ' || str[19] != ':' || str[22] != ':') return 0;
+                static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+                uint32_t month = 0;
+                for(uint32_t m = 0; m < 12; ++m) {
+                    if(std::memcmp(str + 8, months + m * 3, 3) != 0) continue;
+                    month = m + 1;
+                    break;
+                }
+                uint32_t day = 0, year = 0, hour = 0, minute = 0, second = 0;
+                if (month == 0 ||
+                    !read_number(str + 5, 2, day) ||
+                    !read_number(str + 12, 4, year) ||
+                    !read_number(str + 17, 2, hour) ||
+                    !read_number(str + 20, 2, minute) ||
+                    !read_number(str + 23, 2, second)) return 0;
+                const xtime::ftimestamp_t date = (xtime::ftimestamp_t)xtime::get_timestamp(day, month, year, hour, minute, second);
+                return date > timestamp ? (double)(date - timestamp) : 0.0;
+            }
+
+            /** \brief Получить тип кодирования тела ответа
+             * \return Тип кодирования, определенный по заголовкам ответа
+             */
+            Encoding get_encoding() {
+                if(encoding != Encoding::UNKNOWN) return encoding;
+                if(content_encoding.empty()) encoding = Encoding::IDENTITY;
+                else if(content_encoding.contains("gzip")) encoding = Encoding::GZIP;
+                else if(content_encoding.contains("deflate")) encoding = Encoding::DEFLATE;
+                else if(content_encoding.contains("identity")) encoding = Encoding::IDENTITY;
+                else encoding = Encoding::NOT_SUPPORT;
+                return encoding;
+            }
+
+            /** \brief Записать очередную часть тела ответа
+             * \param data Данные
+             * \param size Размер данных
+             * \return Вернет false в случае ошибки распаковки
+             */
+            bool write(const char *data, const size_t size) {
+                received += size;
+                switch(get_encoding()) {
+                case Encoding::IDENTITY:
+                    write_output(data, size);
+                    return true;
+                case Encoding::GZIP:
+                case Encoding::DEFLATE:
+                    return inflate_data(data, size);
+                default:
+                    /* тело ответа не понадобится, ошибка будет возвращена после запроса */
+                    return true;
+                }
+            }
+
+        private:
+            Encoding encoding = Encoding::UNKNOWN;
+            z_stream stream;
+            bool is_stream_init = false;
+
+            /** \brief Прочитать число из цифр
+             * \param str Строка
+             * \param size Количество цифр
+             * \param value Число
+             * \return Вернет false, если в строке есть не только цифры
+             */
+            static bool read_number(const char *str, const size_t size, uint32_t &value) {
+                if(size == 0 || size > 9) return false;
+                value = 0;
+                for(size_t i = 0; i < size; ++i) {
+                    if(str[i] < '0' || str[i] > '9') return false;
+                    value = value * 10 + (str[i] - '0');
+                }
+                return true;
+            }
+
+            inline void write_output(const char *data, const size_t size) {
+                response.append(data, size);
+            }
+
+            bool inflate_data(const char *data, const size_t size) {
+                if(!is_stream_init) {
+                    std::memset(&stream, 0, sizeof(stream));
+                    /* 16 + MAX_WBITS - формат gzip, MAX_WBITS - формат zlib */
+                    const int window_bits = encoding == Encoding::GZIP ? (16 + MAX_WBITS) : MAX_WBITS;
+                    if(inflateInit2(&stream, window_bits) != Z_OK) {
+                        is_error = true;
+                        return false;
+                    }
+                    is_stream_init = true;
+                }
+                if(is_stream_end) return true;
+                std::array<char, 16384> output;
+                stream.next_in = (Bytef*)data;
+                stream.avail_in = (uInt)size;
+                do {
+                    stream.next_out = (Bytef*)output.data();
+                    stream.avail_out = (uInt)output.size();
+                    const int err = inflate(&stream, Z_NO_FLUSH);
+                    if(err == Z_STREAM_END) {
+                        is_stream_end = true;
+                    } else
+                    if(err != Z_OK && err != Z_BUF_ERROR) {
+                        is_error = true;
+                        return false;
                     }
-                    start_pos = found_beg + 1;
-                } else break;
+                    const size_t output_size = output.size() - stream.avail_out;
+                    if(output_size > 0) write_output(output.data(), output_size);
+                } while(stream.avail_out == 0 && !is_stream_end);
+                return true;
             }
+        };
+
+        /** \brief Callback-функция для обработки ответа
+         * Данная функция нужна для внутреннего использования
+         */
+        static int binomo_writer(char *data, size_t size, size_t nmemb, void *userdata) {
+            ResponseWriter *writer = (ResponseWriter*)userdata;
+            if(writer == NULL) return 0;
+            /* возврат 0 прерывает запрос с ошибкой CURLE_WRITE_ERROR */
+            if(!writer->write(data, size * nmemb)) return 0;
+            return size * nmemb;
         }
 
         /** \brief Callback-функция для обработки HTTP Header ответа
@@ -177,11 +576,8 @@ namespace binomo_api {
          */
         static int binomo_header_callback(char *buffer, size_t size, size_t nitems, void *userdata) {
             size_t buffer_size = nitems * size;
-            std::map<std::string,std::string> *headers = (std::map<std::string,std::string>*)userdata;
-            std::string str_buffer(buffer, buffer_size);
-            std::string key, val;
-            parse_pair(str_buffer, key, val);
-            headers->insert({key, val});
+            ResponseWriter *writer = (ResponseWriter*)userdata;
+            writer->parse_header(buffer, buffer_size);
             return buffer_size;
         }
 
@@ -228,52 +624,46 @@ namespace binomo_api {
 
         /** \brief Инициализация CURL
          *
-         * Данная метод является общей инициализацией для разного рода запросов
+         * Данная метод является общей инициализацией для разного рода запросов.
+         * Соединение берется из пула, поэтому здесь задаются только параметры запроса
          * Данный метод нужен для внутреннего использования
+         * \param curl Соединение из пула
          * \param url URL запроса
          * \param body Тело запроса
-         * \param response Ответ сервера
+         * \param writer Приемник ответа сервера
          * \param http_headers Заголовки HTTP
          * \param timeout Таймаут
          * \param writer_callback Callback-функция для записи данных от сервера
          * \param header_callback Callback-функция для обработки заголовков ответа
-         * \param is_use_cookie Использовать cookie файлы
          * \param is_clear_cookie Очистить cookie файлы
          * \param type_req Использовать POST, GET и прочие запросы
-         * \return вернет указатель на CURL или NULL, если инициализация не удалась
+         * \return вернет указатель на CURL
          */
         CURL *init_curl(
+                CURL *curl,
                 const std::string &url,
                 const std::string &body,
-                std::string &response,
+                ResponseWriter &writer,
                 struct curl_slist *http_headers,
                 const int timeout,
                 int (*writer_callback)(char*, size_t, size_t, void*),
                 int (*header_callback)(char*, size_t, size_t, void*),
-                void *userdata,
-                const bool is_use_cookie = false,
                 const bool is_clear_cookie = false,
                 const TypesRequest type_request = TypesRequest::REQUEST_GET) {
-            CURL *curl = curl_easy_init();
-            if(!curl) return NULL;
-            curl_easy_setopt(curl, CURLOPT_CAINFO, sert_file.c_str());
-            curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, error_buffer);
             curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
             //curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+            /* метод запроса мог остаться от предыдущего запроса, сбрасываем его */
+            curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, NULL);
+            curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
             if(type_request == TypesRequest::REQUEST_POST) curl_easy_setopt(curl, CURLOPT_POST, 1L);
-            else if(type_request == TypesRequest::REQUEST_GET) curl_easy_setopt(curl, CURLOPT_POST, 0);
             else if(type_request == TypesRequest::REQUEST_PUT) curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "PUT");
             else if(type_request == TypesRequest::REQUEST_DELETE) curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "DELETE");
 			else if(type_request == TypesRequest::REQUEST_OPTIONS) curl_easy_setopt(curl, CURLOPT_CUSTOMREQUEST, "OPTIONS");
             curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writer_callback);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &writer);
             curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout); // выход через N сек
-            if(is_use_cookie) {
-                if(is_clear_cookie) curl_easy_setopt(curl, CURLOPT_COOKIELIST, "ALL");
-                else curl_easy_setopt(curl, CURLOPT_COOKIEFILE, cookie_file.c_str()); // запускаем cookie engine
-                curl_easy_setopt(curl, CURLOPT_COOKIEJAR, cookie_file.c_str()); // запишем cookie после вызова curl_easy_cleanup
-            }
-            curl_easy_setopt(curl, CURLOPT_HEADERDATA, userdata);
+            if(is_clear_cookie) curl_easy_setopt(curl, CURLOPT_COOKIELIST, "ALL");
+            curl_easy_setopt(curl, CURLOPT_HEADERDATA, &writer);
             curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_callback);
             curl_easy_setopt(curl, CURLOPT_HTTPHEADER, http_headers);
             if (type_request == TypesRequest::REQUEST_POST ||
@@ -286,48 +676,53 @@ namespace binomo_api {
 
         /** \brief Обработать ответ сервера
          * \param curl Указатель на структуру CURL
-         * \param headers Заголовки, которые были приняты
-         * \param buffer Буфер с ответом сервера
+         * \param writer Приемник ответа сервера
          * \param response Итоговый ответ, который будет возвращен
          * \return Код ошибки
          */
-        int process_server_response(CURL *curl, std::map<std::string,std::string> &headers, std::string &buffer, std::string &response) {
+        int process_server_response(CURL *curl, ResponseWriter &writer, std::string &response) {
             CURLcode result = curl_easy_perform(curl);
+            return decode_server_response(curl, result, writer, response);
+        }
+
+        /** \brief Разобрать ответ сервера после завершения запроса
+         * \param curl Указатель на структуру CURL
+         * \param result Результат выполнения запроса
+         * \param writer Приемник ответа сервера
+         * \param response Итоговый ответ, который будет возвращен
+         * \return Код ошибки
+         */
+        int decode_server_response(CURL *curl, const CURLcode result, ResponseWriter &writer, std::string &response) {
             long response_code = 0;
             curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
+            writer.response_code = response_code;
 
+            if(writer.is_error) return common::DECOMPRESSION_ERROR;
             if(result == CURLE_OK) {
-                if(headers.find("Content-Encoding:") != headers.end()) {
-                    std::string content_encoding = headers["Content-Encoding:"];
-                    if(content_encoding.find("gzip") != std::string::npos) {
-                        if(buffer.size() == 0) return common::NO_ANSWER;
-                        const char *compressed_pointer = buffer.data();
-                        response = gzip::decompress(compressed_pointer, buffer.size());
-                    } else
-                    if(content_encoding.find("identity") != std::string::npos) {
-                        response = buffer;
-                    } else {
-                        if(response_code != 200 && response_code != 204) return common::CURL_REQUEST_FAILED;
-                        return common::CONTENT_ENCODING_NOT_SUPPORT;
-                    }
-                } else
-                if(headers.find("content-encoding:") != headers.end()) {
-                    std::string content_encoding = headers["content-encoding:"];
-                    if(content_encoding.find("gzip") != std::string::npos) {
-                        if(buffer.size() == 0) return common::NO_ANSWER;
-                        const char *compressed_pointer = buffer.data();
-                        response = gzip::decompress(compressed_pointer, buffer.size());
-                    } else
-                    if(content_encoding.find("identity") != std::string::npos) {
-                        response = buffer;
-                    } else {
-                        if(response_code != 200 && response_code != 204) return common::CURL_REQUEST_FAILED;
-                        return common::CONTENT_ENCODING_NOT_SUPPORT;
-                    }
-                } else {
-                    response = buffer;
+                /* сервер сообщает о превышении лимита, снижаем скорость запросов */
+                if(response_code == 429 || response_code == 418 || response_code == 403) {
+                    std::atomic_load(&rate_limiter)->on_limit_response(writer.get_retry_after(get_server_ftimestamp()));
+                    if(response_code == 429) return common::LIMITING_NUMBER_REQUESTS;
+                    if(response_code == 418) return common::IP_BLOCKED;
+                    return common::WAF_LIMIT;
+                }
+                /* сервер перегружен и сообщает, когда повторить запрос */
+                if(response_code == 503 && !writer.retry_after.empty()) {
+                    std::atomic_load(&rate_limiter)->on_limit_response(writer.get_retry_after(get_server_ftimestamp()));
+                    return common::CURL_REQUEST_FAILED;
+                }
+                if(response_code == 200 || response_code == 204) std::atomic_load(&rate_limiter)->on_success();
+                const typename ResponseWriter::Encoding encoding = writer.get_encoding();
+                if(encoding == ResponseWriter::Encoding::NOT_SUPPORT) {
                     if(response_code != 200 && response_code != 204) return common::CURL_REQUEST_FAILED;
+                    return common::CONTENT_ENCODING_NOT_SUPPORT;
+                } else
+                if(encoding == ResponseWriter::Encoding::GZIP ||
+                    encoding == ResponseWriter::Encoding::DEFLATE) {
+                    if(writer.received == 0) return common::NO_ANSWER;
+                    if(!writer.is_stream_end) return common::DECOMPRESSION_ERROR;
                 }
+                response = std::move(writer.response);
                 if(response_code != 200 && response_code != 204) return common::CURL_REQUEST_FAILED;
             }
             return result;
@@ -353,24 +748,23 @@ namespace binomo_api {
                 const bool is_use_cookie = false,
                 const bool is_clear_cookie = false,
                 const int timeout = TIME_OUT) {
-            std::map<std::string,std::string> headers;
-            std::string buffer;
+            ResponseWriter writer;
+            std::unique_ptr<CurlHandle> handle = acquire_curl(is_use_cookie);
+            if(!handle) return common::CURL_CANNOT_BE_INIT;
             CURL *curl = init_curl(
+                handle->curl,
                 url,
                 body,
-                buffer,
+                writer,
                 http_headers,
                 timeout,
                 binomo_writer,
                 binomo_header_callback,
-                &headers,
-                is_use_cookie,
                 is_clear_cookie,
                 TypesRequest::REQUEST_POST);
 
-            if(curl == NULL) return common::CURL_CANNOT_BE_INIT;
-            int err = process_server_response(curl, headers, buffer, response);
-            curl_easy_cleanup(curl);
+            int err = process_server_response(curl, writer, response);
+            release_curl(std::move(handle), is_use_cookie);
             return err;
         }
 
@@ -394,24 +788,23 @@ namespace binomo_api {
                 const bool is_use_cookie = false,
                 const bool is_clear_cookie = false,
                 const int timeout = TIME_OUT) {
-            std::map<std::string,std::string> headers;
-            std::string buffer;
+            ResponseWriter writer;
+            std::unique_ptr<CurlHandle> handle = acquire_curl(is_use_cookie);
+            if(!handle) return common::CURL_CANNOT_BE_INIT;
             CURL *curl = init_curl(
+                handle->curl,
                 url,
                 body,
-                buffer,
+                writer,
                 http_headers,
                 timeout,
                 binomo_writer,
                 binomo_header_callback,
-                &headers,
-                is_use_cookie,
                 is_clear_cookie,
                 TypesRequest::REQUEST_PUT);
 
-            if(curl == NULL) return common::CURL_CANNOT_BE_INIT;
-            int err = process_server_response(curl, headers, buffer, response);
-            curl_easy_cleanup(curl);
+            int err = process_server_response(curl, writer, response);
+            release_curl(std::move(handle), is_use_cookie);
             return err;
         }
 
@@ -435,24 +828,23 @@ namespace binomo_api {
                 const bool is_use_cookie = false,
                 const bool is_clear_cookie = false,
                 const int timeout = TIME_OUT) {
-            std::map<std::string,std::string> headers;
-            std::string buffer;
+            ResponseWriter writer;
+            std::unique_ptr<CurlHandle> handle = acquire_curl(is_use_cookie);
+            if(!handle) return common::CURL_CANNOT_BE_INIT;
             CURL *curl = init_curl(
+                handle->curl,
                 url,
                 body,
-                buffer,
+                writer,
                 http_headers,
                 timeout,
                 binomo_writer,
                 binomo_header_callback,
-                &headers,
-                is_use_cookie,
                 is_clear_cookie,
                 TypesRequest::REQUEST_DELETE);
 
-            if(curl == NULL) return common::CURL_CANNOT_BE_INIT;
-            int err = process_server_response(curl, headers, buffer, response);
-            curl_easy_cleanup(curl);
+            int err = process_server_response(curl, writer, response);
+            release_curl(std::move(handle), is_use_cookie);
             return err;
         }
 
@@ -476,24 +868,23 @@ namespace binomo_api {
                 const bool is_clear_cookie = false,
                 const int timeout = TIME_OUT) {
             //int content_encoding = 0;   // Тип кодирования сообщения
-            std::map<std::string,std::string> headers;
-            std::string buffer;
+            ResponseWriter writer;
+            std::unique_ptr<CurlHandle> handle = acquire_curl(is_use_cookie);
+            if(!handle) return common::CURL_CANNOT_BE_INIT;
             CURL *curl = init_curl(
+                handle->curl,
                 url,
                 body,
-                buffer,
+                writer,
                 http_headers,
                 timeout,
                 binomo_writer,
                 binomo_header_callback,
-                &headers,
-                is_use_cookie,
                 is_clear_cookie,
                 TypesRequest::REQUEST_GET);
 
-            if(curl == NULL) return common::CURL_CANNOT_BE_INIT;
-            int err = process_server_response(curl, headers, buffer, response);
-            curl_easy_cleanup(curl);
+            int err = process_server_response(curl, writer, response);
+            release_curl(std::move(handle), is_use_cookie);
             return err;
         }
 
@@ -517,24 +908,23 @@ namespace binomo_api {
                 const bool is_clear_cookie = false,
                 const int timeout = TIME_OUT) {
             //int content_encoding = 0;   // Тип кодирования сообщения
-            std::map<std::string,std::string> headers;
-            std::string buffer;
+            ResponseWriter writer;
+            std::unique_ptr<CurlHandle> handle = acquire_curl(is_use_cookie);
+            if(!handle) return common::CURL_CANNOT_BE_INIT;
             CURL *curl = init_curl(
+                handle->curl,
                 url,
                 body,
-                buffer,
+                writer,
                 http_headers,
                 timeout,
                 binomo_writer,
                 binomo_header_callback,
-                &headers,
-                is_use_cookie,
                 is_clear_cookie,
                 TypesRequest::REQUEST_OPTIONS);
 
-            if(curl == NULL) return common::CURL_CANNOT_BE_INIT;
-            int err = process_server_response(curl, headers, buffer, response);
-            curl_easy_cleanup(curl);
+            int err = process_server_response(curl, writer, response);
+            release_curl(std::move(handle), is_use_cookie);
             return err;
         }
 
@@ -579,60 +969,31 @@ namespace binomo_api {
         }
         */
 
+        /** \brief Разобрать исторические данные
+         * \param candles Массив баров, новые бары будут добавлены в конец
+         * \param response Ответ сервера
+         */
         void parse_history(
                 std::vector<CANDLE> &candles,
-                std::string &response) {
-            try {
-                json j = json::parse(response);
-				if(j["success"] != true) return;
-				json j_data = j["data"];
-                const size_t size_data = j_data.size();
-                for(size_t i = 0; i < size_data; ++i) {
-                    json j_canlde = j_data[i];
-					CANDLE candle;
-                    std::string str_iso = j_canlde["created_at"];
-                    xtime::DateTime date_time;
-					if(!xtime::convert_iso(str_iso, date_time)) continue;
-                    candle.timestamp = date_time.get_timestamp();
-                    candle.open = j_canlde["open"];
-                    candle.high = j_canlde["high"];
-                    candle.low = j_canlde["low"];
-                    candle.close = j_canlde["close"];
-                    candle.volume = 0;
-                    candles.push_back(candle);
-                }
-            } catch(...) {}
+                const std::string &response) {
+            binomo_api::parse_history(response, candles);
         }
 
+        /** \brief Разобрать исторические данные
+         * \param candles Бары, упорядоченные по метке времени
+         * \param response Ответ сервера
+         */
         void parse_history(
                 std::map<xtime::timestamp_t, CANDLE> &candles,
-                std::string &response) {
-			try {
-                json j = json::parse(response);
-				if(j["success"] != true) return;
-				json j_data = j["data"];
-                const size_t size_data = j_data.size();
-                for(size_t i = 0; i < size_data; ++i) {
-                    json j_canlde = j_data[i];
-					CANDLE candle;
-					std::string str_iso = j_canlde["created_at"];
-                    xtime::DateTime date_time;
-					if(!xtime::convert_iso(str_iso, date_time)) continue;
-                    candle.timestamp = date_time.get_timestamp();
-                    candle.open = j_canlde["open"];
-                    candle.high = j_canlde["high"];
-                    candle.low = j_canlde["low"];
-                    candle.close = j_canlde["close"];
-                    candle.volume = 0;
-                    candles[(uint64_t)candle.timestamp] = candle;
-                }
-            } catch(...) {}
+                const std::string &response) {
+            binomo_api::parse_history(response, candles);
         }
 
-        int get_request_none_security(std::string &response, const std::string &url, const uint64_t weight = 1) {
-            const std::string body;
-            check_request_limit(weight);
-            HttpHeaders http_headers({
+        /** \brief Получить заголовки запроса без авторизации
+         * \return Список заголовков
+         */
+        static std::vector<std::string> get_none_security_headers() {
+            return {
                 //"Host: api.binomo.com",
                 "User-Agent: Mozilla/5.0 (Windows NT 6.3; Win64; x64; rv:80.0) Gecko/20100101 Firefox/80.0",
                 "Accept: application/json, text/plain, */*",
@@ -644,8 +1005,26 @@ namespace binomo_api {
                 "Origin: https://binomo.com",
                 "Referer: https://binomo.com/trading",
                 "Connection: keep-alive",
-                "Content-Type: application/json"});
-            int err = get_request(url, body, http_headers.get(), response, true, false);
+                "Content-Type: application/json"};
+        }
+
+        /** \brief Получить заголовки OPTIONS запроса без авторизации
+         * \return Список заголовков
+         */
+        static std::vector<std::string> get_options_headers() {
+            return {
+                "accept: */*",
+                "accept-encoding: gzip",
+                "accept-language: ru-RU,ru;q=0.9,en-US;q=0.8,en;q=0.7",
+                "access-control-request-headers: authorization-token,cache-control,content-type,device-id,device-type,user-timezone,version",
+                "access-control-request-headers: authorization-token,cache-control,content-type,device-id,device-type,user-timezone,version",
+                "Content-Type: application/json"};
+        }
+
+        int get_request_none_security(std::string &response, const std::string &url, const uint64_t weight = 1) {
+            const std::string body;
+            check_request_limit(weight);
+            int err = get_request(url, body, none_security_headers->get(), response, true, false);
             return err;
         }
 
@@ -683,139 +1062,959 @@ namespace binomo_api {
         int options_request_none_security(std::string &response, const std::string &url, const uint64_t weight = 1) {
             const std::string body;
             check_request_limit(weight);
-            HttpHeaders http_headers({
-                "accept: */*",
-                "accept-encoding: gzip",
-                "accept-language: ru-RU,ru;q=0.9,en-US;q=0.8,en;q=0.7",
-                "access-control-request-headers: authorization-token,cache-control,content-type,device-id,device-type,user-timezone,version",
-                "access-control-request-headers: authorization-token,cache-control,content-type,device-id,device-type,user-timezone,version",
-                "Content-Type: application/json"});
-            int err = options_request(url, body, http_headers.get(), response, true, false);
+            int err = options_request(url, body, options_headers->get(), response, true, false);
             return err;
         }
 
-    public:
-
-        /** \brief Получить исторические данные
+        /** \brief Выровнять начало загрузки и получить длину участка истории
          *
-         * \param candles Массив баров
-         * \param symbol Имя символа
+         * Сервер отдает исторические данные участками фиксированной длины,
+         * которая зависит от периода баров
          * \param period Период
-         * \param start_date Начальная дата загрузки
-         * \param stop_date Конечная дата загрузки
-         * \return Код ошибки
+         * \param start_date Начальная дата загрузки, будет выровнена по началу участка
+         * \param time_period Длина участка
+         * \return Вернет false, если период не поддерживается
          */
-        int get_historical_data(
-                std::vector<CANDLE> &candles,
-                const std::string &symbol,
+        static bool get_history_chunk(
                 const uint32_t period,
-                xtime::timestamp_t start_date,
-                xtime::timestamp_t stop_date) {
-            std::string s = common::normalize_symbol_name(symbol);
-			auto it = common::normalize_name_to_ric.find(s);
-            if(it == common::normalize_name_to_ric.end()) return common::DATA_NOT_AVAILABLE;
-
-			xtime::timestamp_t time_period = 0;
-			switch(period) {
+                xtime::timestamp_t &start_date,
+                xtime::timestamp_t &time_period) {
+            switch(period) {
             case 1:
             case 5:
             case 15:
             case 30:
             case xtime::SECONDS_IN_MINUTE:
-                start_date = xtime::get_first_timestamp_day(start_date);
                 time_period = xtime::SECONDS_IN_DAY;
                 break;
             case (5 * xtime::SECONDS_IN_MINUTE):
-                start_date = xtime::get_first_timestamp_day(start_date);
-                start_date = start_date - (start_date % (xtime::SECONDS_IN_DAY*4));
                 time_period = xtime::SECONDS_IN_DAY*4;
                 break;
             case (15 * xtime::SECONDS_IN_MINUTE):
             case (30 * xtime::SECONDS_IN_MINUTE):
-                start_date = xtime::get_first_timestamp_day(start_date);
-                start_date = start_date - (start_date % (xtime::SECONDS_IN_DAY*24));
+                time_period = xtime::SECONDS_IN_DAY*24;
                 break;
             case xtime::SECONDS_IN_HOUR:
-                start_date = xtime::get_first_timestamp_day(start_date);
-                start_date = start_date - (start_date % (xtime::SECONDS_IN_DAY*48));
+                time_period = xtime::SECONDS_IN_DAY*48;
                 break;
             case (3*xtime::SECONDS_IN_HOUR):
-                start_date = xtime::get_first_timestamp_day(start_date);
-                start_date = start_date - (start_date % (xtime::SECONDS_IN_DAY*96));
+                time_period = xtime::SECONDS_IN_DAY*96;
                 break;
             case xtime::SECONDS_IN_DAY:
-                start_date = xtime::get_first_timestamp_day(start_date);
-                start_date = start_date - (start_date % (xtime::SECONDS_IN_DAY*1536));
+                time_period = xtime::SECONDS_IN_DAY*1536;
                 break;
             default:
-                return common::DATA_NOT_AVAILABLE;
-                break;
-			}
-			xtime::timestamp_t current_date = start_date;
-
-			while(true) {
-                // https://api.binomo.com/platform/candles/Z-CRY%2FIDX/2020-09-23T00:00:00/3600?locale=ru
-                std::string url("https://api.binomo.com/platform/candles/");
-                url += common::url_encode(it->second);
-                url += "/";
-                // 2020-08-06T00:00:00
-                url += xtime::to_string("%YYYY-%MM-%DDT%hh:%mm:%ss", current_date);
-                url += "/";
-                url += std::to_string(period);
-                url += "?locale=en";
-                std::string response;
-                int err = get_request_none_security(response, url);
-                if(err != common::OK) return err;
-                std::vector<CANDLE> temp;
-                parse_history(temp, response);
-
-                candles.insert(candles.end(), temp.begin(), temp.end());
-                if(candles.size() > 0) if(candles.back().timestamp >= stop_date) break;
-                current_date += time_period;
+                return false;
+            }
+            start_date = xtime::get_first_timestamp_day(start_date);
+            start_date = start_date - (start_date % time_period);
+            return true;
+        }
+
+        /** \brief Получить URL участка исторических данных
+         * \param ric Имя символа у брокера
+         * \param date Начало участка
+         * \param period Период
+         * \return URL запроса
+         */
+        std::string get_history_url(
+                const std::string &ric,
+                const xtime::timestamp_t date,
+                const uint32_t period) {
+            // https://api.binomo.com/platform/candles/Z-CRY%2FIDX/2020-09-23T00:00:00/3600?locale=ru
+            std::string url(get_api_url() + "/platform/candles/");
+            url += common::url_encode(ric);
+            url += "/";
+            // 2020-08-06T00:00:00
+            url += xtime::to_string("%YYYY-%MM-%DDT%hh:%mm:%ss", date);
+            url += "/";
+            url += std::to_string(period);
+            url += "?locale=en";
+            return url;
+        }
+
+        /// Callback-функция асинхронного запроса, получает код ошибки, ответ сервера и его заголовки
+        using async_callback_t = std::function<void(const int err, const std::string &response, const ResponseWriter &writer)>;
+
+        /** \brief Асинхронный HTTP запрос
+         *
+         * Одинаковые запросы, которые выполняются одновременно, объединяются в один,
+         * а его результат передается всем ожидающим
+         */
+        class AsyncRequest {
+        public:
+            std::string key;                                /**< Ключ объединения запросов */
+            std::string url;
+            http_headers_t http_headers;                    /**< Общий набор заголовков, не изменяется */
+            uint32_t weight = 1;                            /**< Вес запроса в ограничителе скорости */
+            bool is_use_cookie = false;
+            ResponseWriter writer;
+            std::unique_ptr<CurlHandle> handle;
+            std::vector<async_callback_t> callbacks;
+
+            AsyncRequest() {};
+        };
+
+        /* общий цикл асинхронных запросов на основе curl_multi */
+        std::map<std::string, std::shared_ptr<AsyncRequest>> async_requests;   /**< Незавершенные запросы по ключу */
+        std::deque<std::shared_ptr<AsyncRequest>> async_queue;                  /**< Запросы, ожидающие запуска */
+        std::mutex async_mutex;
+        std::condition_variable async_cv;
+        std::thread async_thread;
+        CURLM *async_multi_handle = nullptr;
+        bool is_async_started = false;
+        std::atomic<bool> is_async_shutdown = ATOMIC_VAR_INIT(false);
+        std::atomic<uint32_t> async_max_requests = ATOMIC_VAR_INIT(16);
+
+        /** \brief Разбудить цикл асинхронных запросов
+         */
+        void wakeup_async_loop() {
+            async_cv.notify_all();
+#           if LIBCURL_VERSION_NUM >= 0x074400
+            if(async_multi_handle != nullptr) curl_multi_wakeup(async_multi_handle);
+#           endif
+        }
+
+        /** \brief Проверить, вызван ли метод из потока асинхронных запросов
+         *
+         * Синхронные методы ждут результата от этого потока, поэтому из него их вызывать нельзя
+         * \return Вернет true для потока асинхронных запросов
+         */
+        bool is_async_thread() {
+            std::lock_guard<std::mutex> lock(async_mutex);
+            return is_async_started && async_thread.get_id() == std::this_thread::get_id();
+        }
+
+        /** \brief Запустить поток асинхронных запросов, если он еще не запущен
+         *
+         * Метод вызывается под async_mutex
+         * \return Вернет false, если curl_multi не удалось инициализировать
+         */
+        bool start_async_loop() {
+            if(is_async_started) return true;
+            async_multi_handle = curl_multi_init();
+            if(async_multi_handle == nullptr) return false;
+            is_async_started = true;
+            async_thread = std::thread([this]() {
+                async_loop();
+            });
+            return true;
+        }
+
+        /** \brief Завершить асинхронный запрос и передать результат всем ожидающим
+         * \param request Запрос
+         * \param err Код ошибки
+         * \param response Ответ сервера
+         */
+        void complete_async_request(std::shared_ptr<AsyncRequest> request, const int err, const std::string &response) {
+            std::vector<async_callback_t> callbacks;
+            {
+                std::lock_guard<std::mutex> lock(async_mutex);
+                auto it = async_requests.find(request->key);
+                if(it != async_requests.end() && it->second == request) async_requests.erase(it);
+                callbacks.swap(request->callbacks);
+            }
+            for(size_t i = 0; i < callbacks.size(); ++i) {
+                if(callbacks[i]) callbacks[i](err, response, request->writer);
+            }
+        }
+
+        /** \brief Цикл асинхронных запросов
+         *
+         * Запросы запускаются с учетом ограничителя скорости и ограничения
+         * количества одновременных запросов, ответы передаются в callback-функции запросов
+         */
+        void async_loop() {
+            common::set_thread_name("binomo-http");
+            std::map<CURL*, std::shared_ptr<AsyncRequest>> running;
+            while(!is_async_shutdown) {
+                /* запускаем ожидающие запросы, пока позволяют лимиты */
+                std::vector<std::shared_ptr<AsyncRequest>> failed;
+                double limiter_wait = 0;
+                bool is_queue_empty = true;
+                {
+                    std::unique_lock<std::mutex> lock(async_mutex);
+                    if(running.empty() && async_queue.empty()) {
+                        async_cv.wait_for(lock, std::chrono::milliseconds(100));
+                        continue;
+                    }
+                    while(!async_queue.empty() && running.size() < async_max_requests) {
+                        std::shared_ptr<AsyncRequest> request = async_queue.front();
+                        if(!try_request_limit(request->weight)) {
+                            limiter_wait = std::atomic_load(&rate_limiter)->get_wait_time(request->weight);
+                            break;
+                        }
+                        async_queue.pop_front();
+                        request->handle = acquire_curl(request->is_use_cookie);
+                        if(!request->handle) {
+                            failed.push_back(request);
+                            continue;
+                        }
+                        const std::string body;
+                        CURL *curl = init_curl(
+                            request->handle->curl,
+                            request->url,
+                            body,
+                            request->writer,
+                            request->http_headers->get(),
+                            TIME_OUT,
+                            binomo_writer,
+                            binomo_header_callback,
+                            false,
+                            TypesRequest::REQUEST_GET);
+                        curl_multi_add_handle(async_multi_handle, curl);
+                        running[curl] = request;
+                    }
+                    is_queue_empty = async_queue.empty();
+                }
+                for(size_t i = 0; i < failed.size(); ++i) {
+                    complete_async_request(failed[i], common::CURL_CANNOT_BE_INIT, std::string());
+                }
+
+                if(!running.empty()) {
+                    int running_handles = 0;
+                    curl_multi_perform(async_multi_handle, &running_handles);
+
+                    /* обрабатываем завершенные запросы */
+                    int messages = 0;
+                    CURLMsg *message = nullptr;
+                    while((message = curl_multi_info_read(async_multi_handle, &messages)) != nullptr) {
+                        if(message->msg != CURLMSG_DONE) continue;
+                        CURL *curl = message->easy_handle;
+                        const CURLcode result = message->data.result;
+                        curl_multi_remove_handle(async_multi_handle, curl);
+                        auto it = running.find(curl);
+                        if(it == running.end()) continue;
+                        std::shared_ptr<AsyncRequest> request = it->second;
+                        running.erase(it);
+
+                        std::string response;
+                        const int err = decode_server_response(curl, result, request->writer, response);
+                        release_curl(std::move(request->handle), request->is_use_cookie);
+                        complete_async_request(request, err, response);
+                    }
+                }
+
+                /* ждем ответов, новых запросов или освобождения места в лимите запросов */
+                int timeout = 100;
+                if(!is_queue_empty && limiter_wait > 0) {
+                    timeout = std::max(1, std::min(timeout, (int)(limiter_wait * 1000.0) + 1));
+                }
+                if(!running.empty()) {
+#                   if LIBCURL_VERSION_NUM >= 0x074400
+                    curl_multi_poll(async_multi_handle, nullptr, 0, timeout, nullptr);
+#                   else
+                    /* без curl_multi_wakeup новые запросы замечаются только по таймауту */
+                    curl_multi_wait(async_multi_handle, nullptr, 0, std::min(timeout, 10), nullptr);
+#                   endif
+                } else
+                if(!is_queue_empty) {
+                    std::unique_lock<std::mutex> lock(async_mutex);
+                    async_cv.wait_for(lock, std::chrono::milliseconds(timeout));
+                }
+            }
+
+            /* отменяем незавершенные запросы */
+            for(auto &item : running) {
+                curl_multi_remove_handle(async_multi_handle, item.first);
+                release_curl(std::move(item.second->handle), item.second->is_use_cookie);
+                complete_async_request(item.second, common::NO_ANSWER, std::string());
+            }
+            std::deque<std::shared_ptr<AsyncRequest>> queue;
+            {
+                std::lock_guard<std::mutex> lock(async_mutex);
+                queue.swap(async_queue);
+            }
+            for(size_t i = 0; i < queue.size(); ++i) {
+                complete_async_request(queue[i], common::NO_ANSWER, std::string());
+            }
+        }
+
+        /** \brief Асинхронный GET запрос
+         *
+         * Если такой же запрос уже выполняется, новый запрос не отправляется,
+         * а callback-функция получит результат выполняемого запроса
+         * \param url URL запроса
+         * \param headers Заголовки запроса
+         * \param weight Вес запроса в ограничителе скорости
+         * \param is_use_cookie Использовать cookie файлы
+         * \param callback Callback-функция, которая получит код ошибки, ответ сервера и его заголовки
+         */
+        void async_get_request(
+                const std::string &url,
+                http_headers_t headers,
+                const uint32_t weight,
+                const bool is_use_cookie,
+                async_callback_t callback) {
+            const std::string key((is_use_cookie ? "cookie " : "") + url);
+            {
+                std::lock_guard<std::mutex> lock(async_mutex);
+                if(!is_async_shutdown && start_async_loop()) {
+                    auto it = async_requests.find(key);
+                    if(it != async_requests.end()) {
+                        it->second->callbacks.push_back(std::move(callback));
+                        return;
+                    }
+                    std::shared_ptr<AsyncRequest> request = std::make_shared<AsyncRequest>();
+                    request->key = key;
+                    request->url = url;
+                    request->http_headers = std::move(headers);
+                    request->weight = weight;
+                    request->is_use_cookie = is_use_cookie;
+                    request->callbacks.push_back(std::move(callback));
+                    async_requests[key] = request;
+                    async_queue.push_back(request);
+                    callback = nullptr;
+                }
+            }
+            if(!callback) {
+                wakeup_async_loop();
+                return;
+            }
+            ResponseWriter writer;
+            callback(is_async_shutdown ? common::NO_ANSWER : common::CURL_CANNOT_BE_INIT, std::string(), writer);
+        }
+
+        /** \brief Участок исторических данных для параллельной загрузки
+         */
+        class HistoryChunk {
+        public:
+            size_t request_index = 0;                       /**< Индекс ряда в списке запросов */
+            xtime::timestamp_t date = 0;                    /**< Начало участка */
+            xtime::timestamp_t stop_date = 0;               /**< Конец участка (не включительно) */
+            bool is_cached = false;                         /**< Участок полностью прочитан из хранилища */
+            std::string url;
+            std::vector<CANDLE> candles;
+
+            HistoryChunk() {};
+        };
+
+    public:
+
+        /** \brief Параметры загрузки исторических данных одного ряда
+         */
+        class HistoryRequest {
+        public:
+            std::string symbol;                 /**< Имя символа */
+            uint32_t period = 0;                /**< Период */
+            xtime::timestamp_t start_date = 0;  /**< Начальная дата загрузки */
+            xtime::timestamp_t stop_date = 0;   /**< Конечная дата загрузки */
+            std::vector<CANDLE> candles;        /**< Загруженные бары, упорядочены по времени */
+            int error = common::OK;             /**< Код ошибки загрузки ряда */
+
+            HistoryRequest() {};
+
+            HistoryRequest(
+                    const std::string &user_symbol,
+                    const uint32_t user_period,
+                    const xtime::timestamp_t user_start_date,
+                    const xtime::timestamp_t user_stop_date) :
+                symbol(user_symbol),
+                period(user_period),
+                start_date(user_start_date),
+                stop_date(user_stop_date) {
+            };
+        };
+
+        using history_callback_t = std::function<void(const int err, std::vector<HistoryRequest> &requests)>;
+
+    private:
+
+        /** \brief Задача загрузки исторических данных нескольких рядов
+         */
+        class HistoryJob {
+        public:
+            std::vector<HistoryRequest> requests;
+            std::vector<HistoryChunk> chunks;
+            history_callback_t callback;
+            std::shared_ptr<CandleStore<CANDLE>> store;
+            std::mutex job_mutex;
+            size_t next_chunk = 0;      /**< Следующий участок для запуска */
+            size_t in_flight = 0;       /**< Количество выполняемых запросов задачи */
+            size_t done = 0;            /**< Количество обработанных участков */
+            size_t max_requests = 8;    /**< Максимальное количество одновременных запросов задачи */
+            uint32_t weight = 1;        /**< Вес запроса участка */
+            bool is_finished = false;
+
+            HistoryJob() {};
+        };
+
+        /** \brief Загруженный участок истории в очереди записи в хранилище
+         */
+        class StoreTask {
+        public:
+            std::shared_ptr<CandleStore<CANDLE>> store;
+            std::string symbol;
+            uint32_t period = 0;
+            xtime::timestamp_t date = 0;        /**< Начало участка */
+            xtime::timestamp_t stop_date = 0;   /**< Конец закрытой части участка (не включительно) */
+            std::vector<CANDLE> candles;
+
+            StoreTask() {};
+        };
+
+        std::deque<StoreTask> store_queue;      /**< Очередь записи участков истории в хранилище */
+        std::mutex store_mutex;
+        std::condition_variable store_cv;
+        std::thread store_thread;               /**< Поток записи в хранилище, запускается при первой записи */
+        bool is_store_stop = false;             /**< Флаг для остановки потока записи, защищен store_mutex */
+
+        /** \brief Поставить участок истории в очередь записи в хранилище
+         *
+         * Запись на диск не должна задерживать цикл асинхронных запросов,
+         * поэтому участки записывает отдельный поток
+         * \param task Участок истории
+         */
+        void queue_store_task(StoreTask &&task) {
+            {
+                std::lock_guard<std::mutex> lock(store_mutex);
+                store_queue.push_back(std::move(task));
+                if(!store_thread.joinable()) {
+                    store_thread = std::thread([this]() {
+                        run_store_writer();
+                    });
+                }
+            }
+            store_cv.notify_one();
+        }
+
+        /** \brief Цикл потока записи в хранилище
+         *
+         * При остановке поток дописывает всю очередь
+         */
+        void run_store_writer() {
+            common::set_thread_name("binomo-store");
+            std::unique_lock<std::mutex> lock(store_mutex);
+            while(true) {
+                store_cv.wait(lock, [&]{ return is_store_stop || !store_queue.empty(); });
+                if(store_queue.empty()) break;
+                StoreTask task(std::move(store_queue.front()));
+                store_queue.pop_front();
+                lock.unlock();
+                std::sort(task.candles.begin(), task.candles.end(),
+                        [](const CANDLE &a, const CANDLE &b) {
+                    return a.timestamp < b.timestamp;
+                });
+                task.store->put_candles(task.symbol, task.period, task.candles, task.date, task.stop_date);
+                lock.lock();
+            }
+        }
+
+        /** \brief Запустить загрузку следующих участков истории
+         * \param job Задача загрузки
+         */
+        void submit_history_chunks(std::shared_ptr<HistoryJob> job) {
+            std::vector<size_t> indexes;
+            bool is_finish = false;
+            {
+                std::lock_guard<std::mutex> lock(job->job_mutex);
+                while(job->in_flight < job->max_requests && job->next_chunk < job->chunks.size()) {
+                    const size_t index = job->next_chunk++;
+                    HistoryChunk &chunk = job->chunks[index];
+                    HistoryRequest &request = job->requests[chunk.request_index];
+                    if(chunk.is_cached || request.error != common::OK) {
+                        /* ряд уже загружен с ошибкой, остальные его участки не нужны */
+                        ++job->done;
+                        continue;
+                    }
+                    if(is_async_shutdown) {
+                        request.error = common::NO_ANSWER;
+                        ++job->done;
+                        continue;
+                    }
+                    ++job->in_flight;
+                    indexes.push_back(index);
+                }
+                if(job->done == job->chunks.size() && !job->is_finished) {
+                    job->is_finished = true;
+                    is_finish = true;
+                }
+            }
+            for(size_t i = 0; i < indexes.size(); ++i) {
+                const size_t index = indexes[i];
+                async_get_request(
+                        job->chunks[index].url,
+                        none_security_headers,
+                        job->weight,
+                        true,
+                        [this, job, index](const int err, const std::string &response, const ResponseWriter &writer) {
+                    (void)writer;
+                    on_history_chunk(job, index, err, response);
+                });
+            }
+            if(is_finish) finish_history_job(job);
+        }
+
+        /** \brief Обработать загруженный участок истории
+         * \param job Задача загрузки
+         * \param index Индекс участка
+         * \param err Код ошибки запроса
+         * \param response Ответ сервера
+         */
+        void on_history_chunk(std::shared_ptr<HistoryJob> job, const size_t index, const int err, const std::string &response) {
+            HistoryChunk &chunk = job->chunks[index];
+            if(err == common::OK) {
+                parse_history(chunk.candles, response);
+                /* запоминаем закрытую часть участка */
+                if(job->store && chunk.stop_date > chunk.date) {
+                    const HistoryRequest &request = job->requests[chunk.request_index];
+                    StoreTask task;
+                    task.store = job->store;
+                    task.symbol = request.symbol;
+                    task.period = request.period;
+                    task.date = chunk.date;
+                    task.stop_date = chunk.stop_date;
+                    task.candles = chunk.candles;
+                    queue_store_task(std::move(task));
+                }
+            }
+            {
+                std::lock_guard<std::mutex> lock(job->job_mutex);
+                HistoryRequest &request = job->requests[chunk.request_index];
+                if(err != common::OK && request.error == common::OK) request.error = err;
+                --job->in_flight;
+                ++job->done;
+            }
+            submit_history_chunks(job);
+        }
+
+        /** \brief Объединить участки истории и передать результат
+         * \param job Задача загрузки
+         */
+        void finish_history_job(std::shared_ptr<HistoryJob> job) {
+            std::vector<HistoryRequest> &requests = job->requests;
+            /* объединяем участки каждого ряда в порядке времени */
+            for(size_t i = 0; i < job->chunks.size(); ++i) {
+                HistoryRequest &request = requests[job->chunks[i].request_index];
+                if(request.error != common::OK) continue;
+                request.candles.insert(request.candles.end(), job->chunks[i].candles.begin(), job->chunks[i].candles.end());
+            }
+            std::vector<HistoryChunk>().swap(job->chunks);
+
+            int err = common::OK;
+            for(size_t i = 0; i < requests.size(); ++i) {
+                HistoryRequest &request = requests[i];
+                if(request.error != common::OK) {
+                    request.candles.clear();
+                    if(err == common::OK) err = request.error;
+                    continue;
+                }
+                std::stable_sort(request.candles.begin(), request.candles.end(),
+                        [](const CANDLE &a, const CANDLE &b) {
+                    return a.timestamp < b.timestamp;
+                });
+                auto it_end = std::unique(request.candles.begin(), request.candles.end(),
+                        [](const CANDLE &a, const CANDLE &b) {
+                    return a.timestamp == b.timestamp;
+                });
+                request.candles.erase(it_end, request.candles.end());
             }
+            if(job->callback) job->callback(err, requests);
+        }
+
+    public:
+
+        /** \brief Асинхронно получить исторические данные нескольких рядов
+         *
+         * URL всех участков истории вычисляются заранее, после чего участки
+         * загружаются параллельно в общем цикле запросов с учетом ограничителя скорости.
+         * Если другой вызов уже загружает такой же участок, повторный запрос не отправляется.
+         * Если задано хранилище баров, закрытые участки без пропусков читаются из него,
+         * а загруженные участки записываются в него.
+         * Бары каждого ряда объединяются в порядке возрастания времени.
+         * Callback-функция вызывается из потока запросов, в ней нельзя вызывать синхронные методы загрузки истории
+         * \param requests Список рядов
+         * \param callback Callback-функция, которая получит код первой ошибки и ряды с барами и кодами ошибок
+         * \param max_requests Максимальное количество одновременных запросов
+         */
+        void async_get_historical_data(
+                std::vector<HistoryRequest> requests,
+                history_callback_t callback,
+                const uint32_t max_requests = 8) {
+            std::shared_ptr<HistoryJob> job = std::make_shared<HistoryJob>();
+            job->requests = std::move(requests);
+            job->callback = std::move(callback);
+            job->store = std::atomic_load(&candle_store);
+            job->max_requests = std::max(max_requests, (uint32_t)1);
+            job->weight = get_request_weight("candles");
+
+            /* вычисляем все участки истории */
+            const xtime::timestamp_t server_timestamp = (xtime::timestamp_t)get_server_ftimestamp();
+            for(size_t i = 0; i < job->requests.size(); ++i) {
+                HistoryRequest &request = job->requests[i];
+                request.candles.clear();
+                request.error = common::OK;
+
+                std::string s = common::normalize_symbol_name(request.symbol);
+                auto it = common::normalize_name_to_ric.find(s);
+                if(it == common::normalize_name_to_ric.end()) {
+                    request.error = common::DATA_NOT_AVAILABLE;
+                    continue;
+                }
+
+                xtime::timestamp_t start_date = request.start_date;
+                xtime::timestamp_t time_period = 0;
+                if(!get_history_chunk(request.period, start_date, time_period)) {
+                    request.error = common::DATA_NOT_AVAILABLE;
+                    continue;
+                }
+
+                /* бары до этой метки времени уже закрыты и не изменятся */
+                const xtime::timestamp_t closed_date = server_timestamp - (server_timestamp % request.period);
+
+                for(xtime::timestamp_t date = start_date; date <= request.stop_date; date += time_period) {
+                    job->chunks.resize(job->chunks.size() + 1);
+                    HistoryChunk &chunk = job->chunks.back();
+                    chunk.request_index = i;
+                    chunk.date = date;
+                    chunk.stop_date = std::min(date + time_period, closed_date);
+                    chunk.url = get_history_url(it->second, date, request.period);
+                    if(!job->store || (date + time_period) > closed_date) continue;
+                    /* участок закрыт, пробуем прочитать его из хранилища */
+                    bool is_complete = false;
+                    job->store->get_candles(request.symbol, request.period, date, date + time_period, chunk.candles, is_complete);
+                    if(is_complete) chunk.is_cached = true;
+                    else chunk.candles.clear();
+                }
+            }
+            submit_history_chunks(job);
+        }
+
+        /** \brief Асинхронно получить исторические данные нескольких рядов
+         * \param requests Список рядов
+         * \param max_requests Максимальное количество одновременных запросов
+         * \return Future с рядами, в каждый ряд будут записаны бары и код ошибки
+         */
+        std::future<std::vector<HistoryRequest>> async_get_historical_data(
+                std::vector<HistoryRequest> requests,
+                const uint32_t max_requests = 8) {
+            std::shared_ptr<std::promise<std::vector<HistoryRequest>>> promise =
+                std::make_shared<std::promise<std::vector<HistoryRequest>>>();
+            std::future<std::vector<HistoryRequest>> future = promise->get_future();
+            async_get_historical_data(std::move(requests),
+                    [promise](const int err, std::vector<HistoryRequest> &result) {
+                /* код ошибки каждого ряда записан в сам ряд */
+                (void)err;
+                promise->set_value(std::move(result));
+            }, max_requests);
+            return future;
+        }
 
+        /** \brief Получить исторические данные нескольких рядов
+         *
+         * Синхронная версия async_get_historical_data.
+         * Метод нельзя вызывать из callback-функций асинхронных запросов, в этом случае вернется WRONG_THREAD
+         * \param requests Список рядов. Бары и код ошибки будут записаны в каждый ряд
+         * \param max_requests Максимальное количество одновременных запросов
+         * \return Код первой ошибки или 0 в случае успеха
+         */
+        int get_historical_data(
+                std::vector<HistoryRequest> &requests,
+                const uint32_t max_requests = 8) {
+            if(is_async_thread()) return common::WRONG_THREAD;
+            std::promise<int> promise;
+            std::future<int> future = promise.get_future();
+            async_get_historical_data(std::move(requests),
+                    [&](const int err, std::vector<HistoryRequest> &result) {
+                requests = std::move(result);
+                promise.set_value(err);
+            }, max_requests);
+            return future.get();
+        }
+
+        /** \brief Установить максимальное количество одновременных асинхронных запросов
+         * \param max_requests Количество запросов для всех задач вместе
+         */
+        void set_max_async_requests(const uint32_t max_requests) {
+            async_max_requests = std::max(max_requests, (uint32_t)1);
+            wakeup_async_loop();
+        }
+
+        /** \brief Установить хранилище баров
+         *
+         * При загрузке истории будут запрашиваться только участки, которых нет в хранилище
+         * \param store Хранилище баров
+         */
+        void set_candle_store(std::shared_ptr<CandleStore<CANDLE>> store) {
+            std::atomic_store(&candle_store, store);
+        }
+
+        /** \brief Получить исторические данные
+         *
+         * \param candles Массив баров
+         * \param symbol Имя символа
+         * \param period Период
+         * \param start_date Начальная дата загрузки
+         * \param stop_date Конечная дата загрузки
+         * \return Код ошибки
+         */
+        int get_historical_data(
+                std::vector<CANDLE> &candles,
+                const std::string &symbol,
+                const uint32_t period,
+                xtime::timestamp_t start_date,
+                xtime::timestamp_t stop_date) {
+            std::vector<HistoryRequest> requests;
+            requests.push_back(HistoryRequest(symbol, period, start_date, stop_date));
+            int err = get_historical_data(requests);
+            if(err != common::OK) return err;
+            candles.insert(candles.end(), requests[0].candles.begin(), requests[0].candles.end());
             return common::OK;
         }
 
-        int get_assets() {
-            // https://api.binomo.com/platform/private/v3/assets?locale=ru
-            std::string url("https://api.binomo.com/platform/private/v3/assets?locale=en");
-            std::string response;
+        /** \brief Ответ сервера в кэше запросов
+         */
+        class CachedResponse {
+        public:
+            std::string body;                       /**< Распакованный ответ сервера */
+            std::shared_ptr<const json> document;   /**< Разобранный ответ сервера */
+            std::string etag;                       /**< Значение заголовка ETag */
+            std::string last_modified;              /**< Значение заголовка Last-Modified */
 
-            std::string temp1;
-            std::string temp2;
+            CachedResponse() {};
+        };
+
+        using cached_response_t = std::shared_ptr<const CachedResponse>;
+        using cache_callback_t = std::function<void(const int err, cached_response_t response)>;
+
+    private:
+
+        /// Запись кэша запросов
+        class CacheEntry {
+        public:
+            cached_response_t response;
+            double validation_time = 0; /**< Время получения или последнего подтверждения ответа, секунды */
+
+            CacheEntry() {};
+        };
+
+        std::map<std::string, CacheEntry> response_cache;                  /**< Кэш ответов по URL */
+        std::map<std::string, double> cache_ttl = {{"assets", 300.0}};     /**< Время жизни ответа по имени конечной точки, секунды */
+        std::mutex response_cache_mutex;
+
+        static double get_cache_time() {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        /** \brief Асинхронный GET запрос с кэшированием ответа
+         *
+         * Пока ответ в кэше моложе времени жизни конечной точки, запрос не отправляется.
+         * Затем запрос отправляется с заголовками If-None-Match и If-Modified-Since,
+         * и ответ 304 только продлевает жизнь ответа в кэше
+         * \param endpoint Имя конечной точки, задает время жизни и вес запроса
+         * \param url URL запроса
+         * \param headers Заголовки запроса
+         * \param is_use_cookie Использовать cookie файлы
+         * \param callback Callback-функция, которая получит код ошибки и ответ сервера
+         */
+        void async_cached_get_request(
+                const std::string &endpoint,
+                const std::string &url,
+                http_headers_t headers,
+                const bool is_use_cookie,
+                cache_callback_t callback) {
+            cached_response_t cached;
+            bool is_fresh = false;
             {
-                std::lock_guard<std::mutex> lock(auth_mutex);
-                temp1 = device_id;
-                temp2 = authorization_token;
+                std::lock_guard<std::mutex> lock(response_cache_mutex);
+                auto it = response_cache.find(url);
+                if(it != response_cache.end()) {
+                    cached = it->second.response;
+                    auto it_ttl = cache_ttl.find(endpoint);
+                    const double ttl = it_ttl == cache_ttl.end() ? 0.0 : it_ttl->second;
+                    is_fresh = (get_cache_time() - it->second.validation_time) < ttl;
+                }
             }
-            if(temp1.size() == 0 || temp2.size() == 0) return common::AUTHORIZATION_ERROR;
-            //
-            HttpHeaders http_headers({
+            if(is_fresh) {
+                if(callback) callback(common::OK, cached);
+                return;
+            }
+            if(cached && (!cached->etag.empty() || !cached->last_modified.empty())) {
+                /* условный запрос, дополняем готовый набор заголовков */
+                std::shared_ptr<HttpHeaders> conditional_headers = std::make_shared<HttpHeaders>(headers->get_lines());
+                if(!cached->etag.empty()) conditional_headers->add_header("If-None-Match", cached->etag);
+                if(!cached->last_modified.empty()) conditional_headers->add_header("If-Modified-Since", cached->last_modified);
+                headers = conditional_headers;
+            }
+            async_get_request(url, std::move(headers), get_request_weight(endpoint), is_use_cookie,
+                    [this, url, callback](const int err, const std::string &response, const ResponseWriter &writer) {
+                if(writer.response_code == 304) {
+                    /* ответ не изменился, берем его из кэша */
+                    cached_response_t cached;
+                    {
+                        std::lock_guard<std::mutex> lock(response_cache_mutex);
+                        auto it = response_cache.find(url);
+                        if(it != response_cache.end()) {
+                            it->second.validation_time = get_cache_time();
+                            cached = it->second.response;
+                        }
+                    }
+                    if(callback) callback(cached ? common::OK : common::DATA_NOT_AVAILABLE, cached);
+                    return;
+                }
+                if(err != common::OK) {
+                    if(callback) callback(err, cached_response_t());
+                    return;
+                }
+
+                std::shared_ptr<CachedResponse> entry = std::make_shared<CachedResponse>();
+                try {
+                    entry->document = std::make_shared<const json>(json::parse(response));
+                } catch(...) {
+                    if(callback) callback(common::JSON_PARSER_ERROR, cached_response_t());
+                    return;
+                }
+                entry->body = response;
+                entry->etag = writer.etag.str();
+                entry->last_modified = writer.last_modified.str();
+                {
+                    std::lock_guard<std::mutex> lock(response_cache_mutex);
+                    CacheEntry &cache_entry = response_cache[url];
+                    cache_entry.response = entry;
+                    cache_entry.validation_time = get_cache_time();
+                }
+                if(callback) callback(common::OK, entry);
+            });
+        }
+
+        /** \brief Собрать заголовки запросов с авторизацией
+         *
+         * Набор собирается при изменении авторизации и затем используется всеми запросами
+         * \param user_device_id Идентификатор устройства
+         * \param user_authorization_token Токен авторизации
+         * \return Набор заголовков или nullptr, если авторизации нет
+         */
+        static http_headers_t make_assets_headers(const std::string &user_device_id, const std::string &user_authorization_token) {
+            if(user_device_id.size() == 0 || user_authorization_token.size() == 0) return http_headers_t();
+            return std::make_shared<const HttpHeaders>(std::vector<std::string>{
                 "User-Agent: Mozilla/5.0 (Windows NT 6.3; Win64; x64; rv:81.0) Gecko/20100101 Firefox/81.0",
                 "Accept: application/json, text/plain, */*",
                 "Accept-Language: ru-RU,ru;q=0.8,en-US;q=0.5,en;q=0.3",
-                "Accept-Encoding: gzip, deflate, br",
-                std::string("Device-Id: " + temp1),
+                "Accept-Encoding: gzip, deflate",
+                std::string("Device-Id: " + user_device_id),
                 "Version: 602419c9",
                 "Device-Type: web",
-                "Cache-Control: no-cache, no-store, must-revalidate",
+                "Cache-Control: no-cache",
                 "User-Timezone: Europe/Moscow",
-                std::string("Authorization-Token: " + temp2),
+                std::string("Authorization-Token: " + user_authorization_token),
                 "Content-Type: application/json",
                 "Origin: https://binomo.com",
                 "Referer: https://binomo.com/trading",
                 "Connection: keep-alive"});
-            const std::string body;
-            int err = get_request(url, body, http_headers.get(), response, false, false);
-            std::cout << "response: " << std::endl << response << std::endl;
-            if(err != common::OK) return err;
+        }
+
+        /** \brief Получить заголовки запроса списка активов
+         * \return Набор заголовков или nullptr, если авторизации нет
+         */
+        http_headers_t get_assets_headers() {
+            std::lock_guard<std::mutex> lock(auth_mutex);
+            return assets_headers;
+        }
+
+    public:
+
+        /** \brief Асинхронно получить список активов
+         *
+         * Ответ хранится в кэше вместе с разобранным JSON. Пока ответ моложе
+         * времени жизни конечной точки "assets", запрос не отправляется, затем ответ
+         * подтверждается условным запросом. Если список уже запрашивается,
+         * повторный запрос не отправляется.
+         * Callback-функция вызывается из потока запросов или сразу, если ответ взят из кэша
+         * \param callback Callback-функция, которая получит код ошибки и ответ сервера
+         */
+        void async_get_assets(cache_callback_t callback) {
+            const std::string url(get_api_url() + "/platform/private/v3/assets?locale=en");
+            http_headers_t headers = get_assets_headers();
+            if(!headers) {
+                if(callback) callback(common::AUTHORIZATION_ERROR, cached_response_t());
+                return;
+            }
+            async_cached_get_request("assets", url, std::move(headers), false, std::move(callback));
+        }
+
+        /** \brief Получить список активов
+         *
+         * Синхронная версия async_get_assets.
+         * Метод нельзя вызывать из callback-функций асинхронных запросов, в этом случае вернется WRONG_THREAD
+         * \param assets Ответ сервера со списком активов
+         * \return Код ошибки
+         */
+        int get_assets(cached_response_t &assets) {
+            if(is_async_thread()) return common::WRONG_THREAD;
+            std::promise<int> promise;
+            std::future<int> future = promise.get_future();
+            async_get_assets([&](const int err, cached_response_t response) {
+                assets = response;
+                promise.set_value(err);
+            });
+            return future.get();
+        }
+
+        /** \brief Обновить список активов
+         * \return Код ошибки
+         */
+        int get_assets() {
+            cached_response_t assets;
+            return get_assets(assets);
+        }
+
+        /** \brief Установить время жизни ответов конечной точки в кэше
+         * \param endpoint Имя конечной точки, например "assets"
+         * \param ttl Время жизни в секундах. Если 0, каждый запрос подтверждается на сервере
+         */
+        void set_cache_ttl(const std::string &endpoint, const double ttl) {
+            std::lock_guard<std::mutex> lock(response_cache_mutex);
+            cache_ttl[endpoint] = ttl;
+        }
+
+        /** \brief Очистить кэш запросов
+         */
+        void clear_cache() {
+            std::lock_guard<std::mutex> lock(response_cache_mutex);
+            response_cache.clear();
+        }
+
+        /** \brief Установить адрес API
+         *
+         * Позволяет направить запросы на локальный сервер, например для тестов производительности
+         * \param url Адрес API без завершающего слэша, по умолчанию https://api.binomo.com
+         */
+        void set_api_url(const std::string &url) {
+            std::lock_guard<std::mutex> lock(api_url_mutex);
+            api_url = url;
+            while(!api_url.empty() && api_url.back() == '/') api_url.pop_back();
+        }
+
+        /** \brief Получить адрес API
+         * \return Адрес API
+         */
+        std::string get_api_url() {
+            std::lock_guard<std::mutex> lock(api_url_mutex);
+            return api_url;
+        }
+
+        /** \brief Установить ограничитель скорости запросов
+         *
+         * По умолчанию все экземпляры класса используют общий ограничитель get_shared_rate_limiter()
+         * \param limiter Ограничитель скорости запросов
+         */
+        void set_rate_limiter(std::shared_ptr<RateLimiter> limiter) {
+            if(!limiter) return;
+            std::atomic_store(&rate_limiter, limiter);
+        }
+
+        /** \brief Получить ограничитель скорости запросов
+         * \return Ограничитель скорости запросов, через него можно изменить лимит и получить статистику
+         */
+        std::shared_ptr<RateLimiter> get_rate_limiter() {
+            return std::atomic_load(&rate_limiter);
         }
 
         void set_auth(const std::string &user_authorization_token, const std::string &user_device_id) {
             std::lock_guard<std::mutex> lock(auth_mutex);
             authorization_token = user_authorization_token;
             device_id = user_device_id;
+            assets_headers = make_assets_headers(device_id, authorization_token);
         }
 
         /** \brief Конструктор класса Binance Api для http запросов
@@ -828,9 +2027,37 @@ namespace binomo_api {
             sert_file = user_sert_file;
             cookie_file = user_cookie_file;
             curl_global_init(CURL_GLOBAL_ALL);
+            curl_share = init_curl_share(false);
+            curl_cookie_share = init_curl_share(true);
+            none_security_headers = std::make_shared<const HttpHeaders>(get_none_security_headers());
+            options_headers = std::make_shared<const HttpHeaders>(get_options_headers());
         };
 
-        ~BinomoApiHttp() {}
+        ~BinomoApiHttp() {
+            /* цикл асинхронных запросов использует пул соединений, останавливаем его первым */
+            {
+                std::lock_guard<std::mutex> lock(async_mutex);
+                is_async_shutdown = true;
+            }
+            wakeup_async_loop();
+            if(async_thread.joinable()) async_thread.join();
+            if(async_multi_handle != nullptr) curl_multi_cleanup(async_multi_handle);
+            /* поток записи дописывает участки, поставленные циклом запросов */
+            {
+                std::lock_guard<std::mutex> lock(store_mutex);
+                is_store_stop = true;
+            }
+            store_cv.notify_one();
+            if(store_thread.joinable()) store_thread.join();
+            /* соединения должны быть закрыты до удаления общего кэша */
+            {
+                std::lock_guard<std::mutex> lock(curl_pool_mutex);
+                curl_pool.clear();
+                curl_cookie_pool.clear();
+            }
+            if(curl_share != nullptr) curl_share_cleanup(curl_share);
+            if(curl_cookie_share != nullptr) curl_share_cleanup(curl_cookie_share);
+        }
     };
 }
 #endif // BINOMO_CPP_API_HTTP_HPP_INCLUDED
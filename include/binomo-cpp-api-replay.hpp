@@ -0,0 +1,383 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_REPLAY_HPP_INCLUDED
+#define BINOMO_CPP_API_REPLAY_HPP_INCLUDED
+
+#include "binomo-cpp-api-websocket.hpp"
+#include "tools/binomo-cpp-api-tick-tape.hpp"
+#include "tools/binomo-cpp-api-history-parser.hpp"
+#include <fstream>
+#include <sstream>
+#include <functional>
+#include <future>
+#include <atomic>
+#include <vector>
+
+namespace binomo_api {
+
+    /** \brief Воспроизведение тиков через поток котировок
+     *
+     * Тики из источников (лента тиков, файлы HST или CSV) подаются в BinomoApiPriceStream::replay_tick,
+     * поэтому бары и функции обратного вызова обрабатываются так же, как при работе с сервером.
+     * Время сервера потока котировок следует времени воспроизведения.
+     *
+     * Источники сливаются по метке времени, тики с одинаковой меткой идут в порядке добавления источников.
+     * Тики передаются из одного потока, поэтому при одинаковых источниках результат воспроизведения повторяется
+     */
+    template<class CANDLE = common::Candle>
+    class BinomoApiReplay {
+    public:
+        /** \brief Источник тиков
+         *
+         * Функция записывает следующий тик и возвращает false, когда тиков больше нет.
+         * Тики одного источника должны идти по возрастанию метки времени
+         */
+        using tick_source_t = std::function<bool(common::StreamTick &tick)>;
+
+        static constexpr double REAL_TIME = 1.0;    /**< Скорость реального времени */
+        static constexpr double MAX_SPEED = 0.0;    /**< Воспроизведение без ожидания */
+
+        /// Статистика воспроизведения
+        class Stats {
+        public:
+            uint64_t ticks = 0;                         /**< Воспроизведено тиков */
+            xtime::ftimestamp_t first_timestamp = 0;    /**< Время первого тика */
+            xtime::ftimestamp_t last_timestamp = 0;     /**< Время последнего тика */
+            double elapsed = 0;                         /**< Длительность воспроизведения, секунды */
+
+            Stats() {};
+        };
+
+    private:
+        BinomoApiPriceStream<CANDLE> &stream;
+        std::vector<tick_source_t> sources;
+        double speed = MAX_SPEED;
+
+        std::future<void> replay_future;
+        std::atomic<bool> is_stop = ATOMIC_VAR_INIT(false);
+        std::atomic<bool> is_running = ATOMIC_VAR_INIT(false);
+
+        Stats stats;
+        std::mutex stats_mutex;
+
+        /** \brief Подождать, пока время сервера не дойдет до тика
+         * \return Вернет false, если воспроизведение остановлено
+         */
+        bool wait_tick(const xtime::ftimestamp_t timestamp) {
+            while(!is_stop) {
+                const double delay = (timestamp - stream.get_server_timestamp()) / speed;
+                if(delay <= 0) return true;
+                /* ожидание ограничено, чтобы быстро реагировать на stop() */
+                std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(std::min(delay, 0.1) * 1000000.0) + 1));
+            }
+            return false;
+        }
+
+    public:
+
+        /** \brief Конструктор воспроизведения
+         * \param user_stream Поток котировок. Поток должен существовать до завершения воспроизведения
+         * \param user_speed Скорость воспроизведения. REAL_TIME - реальное время, N - в N раз быстрее, MAX_SPEED - без ожидания
+         */
+        BinomoApiReplay(BinomoApiPriceStream<CANDLE> &user_stream, const double user_speed = MAX_SPEED) :
+                stream(user_stream), speed(std::max(0.0, user_speed)) {
+        }
+
+        ~BinomoApiReplay() {
+            stop();
+            wait();
+        }
+
+        /** \brief Добавить источник тиков
+         * \param source Источник тиков
+         */
+        void add_source(tick_source_t source) {
+            sources.push_back(std::move(source));
+        }
+
+        /** \brief Установить скорость воспроизведения
+         *
+         * Скорость применяется при следующем запуске
+         * \param user_speed Скорость воспроизведения. REAL_TIME - реальное время, N - в N раз быстрее, MAX_SPEED - без ожидания
+         */
+        void set_speed(const double user_speed) {
+            speed = std::max(0.0, user_speed);
+        }
+
+        /** \brief Воспроизвести тики в текущем потоке
+         *
+         * Метод возвращается, когда тики закончились или вызван stop().
+         * После завершения время сервера остается на последнем тике
+         * \return Количество воспроизведенных тиков
+         */
+        uint64_t run() {
+            is_running = true;
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                stats = Stats();
+            }
+            const std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+            /* по одному ожидающему тику на источник */
+            std::vector<common::StreamTick> pending(sources.size());
+            std::vector<bool> is_pending(sources.size(), false);
+            for(size_t i = 0; i < sources.size(); ++i) {
+                is_pending[i] = sources[i](pending[i]);
+            }
+
+            bool is_first = true;
+            uint64_t ticks = 0;
+            xtime::ftimestamp_t last_timestamp = 0;
+            while(!is_stop) {
+                size_t index = sources.size();
+                for(size_t i = 0; i < sources.size(); ++i) {
+                    if(!is_pending[i]) continue;
+                    if(index == sources.size() || pending[i].timestamp < pending[index].timestamp) index = i;
+                }
+                if(index == sources.size()) break;
+                const common::StreamTick tick = pending[index];
+                is_pending[index] = sources[index](pending[index]);
+
+                if(is_first) {
+                    stream.set_replay_clock(tick.timestamp, speed);
+                    std::lock_guard<std::mutex> lock(stats_mutex);
+                    stats.first_timestamp = tick.timestamp;
+                    is_first = false;
+                }
+                if(speed > 0 && !wait_tick(tick.timestamp)) break;
+                stream.replay_tick(tick);
+                last_timestamp = tick.timestamp;
+                ++ticks;
+                if((ticks & 0xFF) == 0) {
+                    std::lock_guard<std::mutex> lock(stats_mutex);
+                    stats.ticks = ticks;
+                    stats.last_timestamp = last_timestamp;
+                }
+            }
+
+            /* время сервера останавливается на последнем тике */
+            if(!is_first) stream.set_replay_clock(last_timestamp, MAX_SPEED);
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                stats.ticks = ticks;
+                stats.last_timestamp = last_timestamp;
+                stats.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+            }
+            is_running = false;
+            return ticks;
+        }
+
+        /** \brief Запустить воспроизведение в отдельном потоке
+         */
+        void start() {
+            if(replay_future.valid()) return;
+            is_stop = false;
+            is_running = true;
+            replay_future = std::async(std::launch::async, [&]() {
+                run();
+            });
+        }
+
+        /** \brief Остановить воспроизведение
+         */
+        void stop() {
+            is_stop = true;
+        }
+
+        /** \brief Подождать завершения воспроизведения, запущенного через start()
+         */
+        void wait() {
+            if(!replay_future.valid()) return;
+            try {
+                replay_future.get();
+            }
+            catch(const std::exception &e) {
+                std::cerr << "binomo api: BinomoApiReplay error, what: " << e.what() << std::endl;
+            }
+            catch(...) {
+                std::cerr << "binomo api: BinomoApiReplay error" << std::endl;
+            }
+        }
+
+        /** \brief Проверить, идет ли воспроизведение
+         * \return Вернет true, если воспроизведение идет
+         */
+        inline bool check_running() {
+            return is_running;
+        }
+
+        /** \brief Получить статистику воспроизведения
+         * \return Статистика
+         */
+        Stats get_stats() {
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            return stats;
+        }
+
+        /** \brief Создать источник тиков из файлов ленты
+         * \param file_names Имена файлов ленты в порядке времени
+         * \return Источник тиков
+         */
+        static tick_source_t make_tape_source(const std::vector<std::string> &file_names) {
+            std::shared_ptr<size_t> index = std::make_shared<size_t>(0);
+            std::shared_ptr<TickTapeReader> reader;
+            return [file_names, index, reader](common::StreamTick &tick) mutable -> bool {
+                while(true) {
+                    if(reader && reader->read(tick)) return true;
+                    if(*index >= file_names.size()) return false;
+                    reader = std::make_shared<TickTapeReader>(file_names[(*index)++]);
+                    if(!reader->is_open()) {
+                        std::cerr << "binomo api: tick tape " << file_names[*index - 1] << " can't be opened" << std::endl;
+                    }
+                }
+            };
+        }
+
+        /** \brief Создать источник тиков из файла HST
+         *
+         * Поддерживаются версии 400 и 401. Каждый бар заменяется четырьмя тиками внутри бара:
+         * open, low и high (high и low для падающего бара), close.
+         * Метка времени бара HST считается меткой времени бара потока котировок,
+         * как ее записывает MqlHst
+         * \param file_name Имя файла HST
+         * \param symbol Имя символа
+         * \param timezone Часовой пояс файла, секунды (как в MqlHst)
+         * \return Источник тиков. Если файл не открыт, источник пуст
+         */
+        static tick_source_t make_hst_source(
+                const std::string &file_name,
+                const std::string &symbol,
+                const int64_t timezone = 0) {
+            std::shared_ptr<std::ifstream> file = std::make_shared<std::ifstream>(file_name, std::ios_base::binary);
+            uint32_t version = 0, period = 0, digits = 0;
+            const common::SymbolId symbol_id = common::get_symbol_id(symbol);
+            if(file->is_open()) {
+                char header[148];
+                file->read(header, sizeof(header));
+                if(file->gcount() == (std::streamsize)sizeof(header)) {
+                    std::memcpy(&version, header, sizeof(version));
+                    std::memcpy(&period, header + 80, sizeof(period));
+                    std::memcpy(&digits, header + 84, sizeof(digits));
+                }
+            }
+            if((version != 400 && version != 401) || period == 0 || symbol_id == common::INVALID_SYMBOL_ID) {
+                std::cerr << "binomo api: hst file " << file_name << " can't be replayed" << std::endl;
+                return [](common::StreamTick &) { return false; };
+            }
+            /* период HST указан в минутах */
+            const double bar_period = (double)period * xtime::SECONDS_IN_MINUTE;
+            std::shared_ptr<std::array<double, 4>> prices = std::make_shared<std::array<double, 4>>();
+            std::shared_ptr<size_t> index = std::make_shared<size_t>(4);
+            std::shared_ptr<double> bar_timestamp = std::make_shared<double>(0);
+            return [=](common::StreamTick &tick) -> bool {
+                if(*index >= 4) {
+                    int64_t timestamp = 0;
+                    double open = 0, high = 0, low = 0, close = 0;
+                    if(version == 400) {
+                        char record[44];
+                        file->read(record, sizeof(record));
+                        if(file->gcount() != (std::streamsize)sizeof(record)) return false;
+                        uint32_t time = 0;
+                        std::memcpy(&time, record, sizeof(time));
+                        timestamp = time;
+                        std::memcpy(&open, record + 4, sizeof(double));
+                        std::memcpy(&low, record + 12, sizeof(double));
+                        std::memcpy(&high, record + 20, sizeof(double));
+                        std::memcpy(&close, record + 28, sizeof(double));
+                    } else {
+                        char record[60];
+                        file->read(record, sizeof(record));
+                        if(file->gcount() != (std::streamsize)sizeof(record)) return false;
+                        std::memcpy(&timestamp, record, sizeof(timestamp));
+                        std::memcpy(&open, record + 8, sizeof(double));
+                        std::memcpy(&high, record + 16, sizeof(double));
+                        std::memcpy(&low, record + 24, sizeof(double));
+                        std::memcpy(&close, record + 32, sizeof(double));
+                    }
+                    *prices = close >= open ?
+                        std::array<double, 4>{open, low, high, close} :
+                        std::array<double, 4>{open, high, low, close};
+                    *bar_timestamp = (double)(timestamp - timezone);
+                    *index = 0;
+                }
+                /* тики лежат в (bar_timestamp - period, bar_timestamp], последний - на закрытии бара */
+                const double step = (bar_period - 1.0) / 3.0;
+                tick.symbol_id = symbol_id;
+                tick.precision = digits;
+                tick.price = (*prices)[*index];
+                tick.timestamp = *bar_timestamp - bar_period + 1.0 + step * (double)(*index);
+                ++(*index);
+                return true;
+            };
+        }
+
+        /** \brief Создать источник тиков из файла CSV
+         *
+         * Строка файла: время,символ,цена,точность.
+         * Время указывается в секундах UTC (можно с дробной частью) или в формате ISO 8601,
+         * точность можно не указывать. Строки, которые не удалось разобрать (например, заголовок), пропускаются
+         * \param file_name Имя файла CSV
+         * \param default_precision Точность, если она не указана в строке
+         * \return Источник тиков
+         */
+        static tick_source_t make_csv_source(const std::string &file_name, const uint32_t default_precision = 5) {
+            std::shared_ptr<std::ifstream> file = std::make_shared<std::ifstream>(file_name);
+            if(!file->is_open()) {
+                std::cerr << "binomo api: csv file " << file_name << " can't be opened" << std::endl;
+            }
+            std::shared_ptr<std::string> line = std::make_shared<std::string>();
+            return [file, line, default_precision](common::StreamTick &tick) -> bool {
+                while(std::getline(*file, *line)) {
+                    if(!line->empty() && line->back() == '\r') line->pop_back();
+                    std::istringstream stream(*line);
+                    std::string str_time, symbol, str_price, str_precision;
+                    if(!std::getline(stream, str_time, ',') ||
+                        !std::getline(stream, symbol, ',') ||
+                        !std::getline(stream, str_price, ',')) continue;
+                    std::getline(stream, str_precision, ',');
+                    try {
+                        xtime::timestamp_t timestamp = 0;
+                        if(str_time.find('-') != std::string::npos) {
+                            if(!parse_iso_timestamp(str_time.data(), str_time.size(), timestamp)) continue;
+                            tick.timestamp = (xtime::ftimestamp_t)timestamp;
+                        } else {
+                            tick.timestamp = std::stod(str_time);
+                        }
+                        tick.price = std::stod(str_price);
+                        tick.precision = str_precision.empty() ? default_precision : (uint32_t)std::stoul(str_precision);
+                    }
+                    catch(...) {
+                        continue;
+                    }
+                    tick.symbol_id = common::get_symbol_id(symbol);
+                    if(tick.symbol_id == common::INVALID_SYMBOL_ID) continue;
+                    return true;
+                }
+                return false;
+            };
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_REPLAY_HPP_INCLUDED
@@ -25,14 +25,24 @@
 #define BINOMO_CPP_API_WEBSOCKET_HPP_INCLUDED
 
 #include "binomo-cpp-api-common.hpp"
+#include "tools/binomo-cpp-api-candle-store.hpp"
+#include "tools/binomo-cpp-api-candle-series.hpp"
+#include "tools/binomo-cpp-api-tick-tape.hpp"
+#include "tools/binomo-cpp-api-quote-parser.hpp"
+#include "tools/binomo-cpp-api-spsc-ring.hpp"
+#include "tools/binomo-cpp-api-subscription-manager.hpp"
 #include "client_wss.hpp"
 #include <openssl/ssl.h>
+#ifdef _WIN32
 #include <wincrypt.h>
+#endif
 #include <xtime.hpp>
 #include <nlohmann/json.hpp>
 #include <mutex>
 #include <atomic>
 #include <future>
+#include <thread>
+#include <condition_variable>
 #include <cstdlib>
 //#include "utf8.h" // http://utfcpp.sourceforge.net/
 
@@ -59,16 +69,293 @@ namespace binomo_api {
         std::future<void> client_future;		/**< Поток соединения */
         std::mutex save_connection_mutex;
 
-        std::map<std::string, std::list<uint32_t>> list_subscriptions;
+        common::ThreadConfig thread_config;     /**< Настройки потоков */
+        std::mutex thread_config_mutex;
+
+        std::shared_ptr<CandleStore<CANDLE>> candle_store;  /**< Хранилище баров, сюда записываются закрытые бары */
+        std::shared_ptr<TickTapeWriter> tick_tape;          /**< Лента тиков, сюда записываются все тики потока */
+
+        /** \brief Закрытый бар в очереди записи в хранилище
+         */
+        class StoreItem {
+        public:
+            common::SymbolId symbol_id = 0;
+            uint32_t period = 0;
+            CANDLE candle;
+
+            StoreItem() {};
+
+            StoreItem(const common::SymbolId user_symbol_id, const uint32_t user_period, const CANDLE &user_candle) :
+                symbol_id(user_symbol_id), period(user_period), candle(user_candle) {};
+        };
+
+        std::vector<StoreItem> store_queue;     /**< Очередь записи закрытых баров в хранилище */
+        std::future<void> store_future;         /**< Поток записи баров в хранилище */
+        std::mutex store_mutex;
+        std::condition_variable store_cv;
+        bool is_store_stop = false;             /**< Флаг для остановки потока записи, защищен store_mutex */
+
+        /** \brief Поставить закрытый бар в очередь записи в хранилище
+         *
+         * Бар записывается потоком записи, поэтому парсер не ждет диск
+         * \param symbol_id Номер символа
+         * \param period Период
+         * \param candle Бар
+         */
+        void queue_store_candle(const common::SymbolId symbol_id, const uint32_t period, const CANDLE &candle) {
+            {
+                std::lock_guard<std::mutex> lock(store_mutex);
+                if(!store_future.valid()) return;
+                store_queue.push_back(StoreItem(symbol_id, period, candle));
+            }
+            store_cv.notify_one();
+        }
+
+        /** \brief Цикл потока записи баров в хранилище
+         *
+         * Поток забирает всю очередь за раз и сбрасывает файлы на диск один раз на пачку
+         */
+        void run_store_writer() {
+            std::vector<StoreItem> items;
+            std::unique_lock<std::mutex> lock(store_mutex);
+            while(true) {
+                store_cv.wait(lock, [&]{ return is_store_stop || !store_queue.empty(); });
+                if(store_queue.empty()) break;
+                items.swap(store_queue);
+                lock.unlock();
+                std::shared_ptr<CandleStore<CANDLE>> store = std::atomic_load(&candle_store);
+                if(store) {
+                    for(size_t i = 0; i < items.size(); ++i) {
+                        store->put_candle(common::get_symbol_name(items[i].symbol_id), items[i].period, items[i].candle);
+                    }
+                    store->flush();
+                }
+                items.clear();
+                lock.lock();
+            }
+        }
+
+        const common::SymbolRegistry &symbol_registry = common::SymbolRegistry::get();
+
+        /** \brief Периоды символов, индекс - номер символа */
+        std::vector<std::list<uint32_t>> list_subscriptions = std::vector<std::list<uint32_t>>(common::SymbolRegistry::get().size());
         std::mutex list_subscriptions_mutex;
 
+        SubscriptionManager subscription_manager;   /**< Желаемый набор символов и состояние подписок на сервере */
+        std::future<void> subscription_future;      /**< Поток отправки изменений подписок */
+        std::mutex subscription_mutex;              /**< Упорядочивает отправку изменений и сброс подписок */
+        std::condition_variable subscription_cv;
+        std::atomic<uint32_t> subscription_interval = ATOMIC_VAR_INIT(100);    /**< Интервал отправки изменений подписок в мс */
+
+        /** \brief Составить сообщение подписки
+         * \param action Действие, subscribe или unsubscribe
+         * \param symbols Номера символов
+         * \return Сообщение для сервера
+         */
+        std::string make_subscription_message(
+                const std::string &action,
+                const std::vector<common::SymbolId> &symbols) {
+            // {"action":"subscribe","rics":["BTC/USD"]}
+            json j;
+            j["action"] = action;
+            j["rics"] = json::array();
+            for(size_t i = 0; i < symbols.size(); ++i) {
+                j["rics"].push_back(symbol_registry.get_info(symbols[i]).ric);
+            }
+            return j.dump();
+        }
+
+        /** \brief Отправить изменения подписок
+         *
+         * Метод вызывается под subscription_mutex. Все изменения
+         * за интервал уходят одним сообщением на действие
+         */
+        void flush_subscriptions() {
+            std::vector<common::SymbolId> subscribe;
+            std::vector<common::SymbolId> unsubscribe;
+            if(!subscription_manager.get_changes(xtime::get_ftimestamp(), subscribe, unsubscribe)) return;
+            if(!unsubscribe.empty()) send(make_subscription_message("unsubscribe", unsubscribe));
+            if(!subscribe.empty()) send(make_subscription_message("subscribe", subscribe));
+        }
+
+        /** \brief Цикл потока отправки изменений подписок
+         */
+        void run_subscriptions() {
+            std::unique_lock<std::mutex> lock(subscription_mutex);
+            while(!is_close_connection) {
+                subscription_cv.wait_for(lock, std::chrono::milliseconds(subscription_interval));
+                if(is_close_connection) break;
+                if(!is_open) continue;
+                flush_subscriptions();
+            }
+        }
+
+        /** \brief Сбросить подписки на сервере
+         *
+         * На новом соединении подписок нет, поэтому поток отправки
+         * сразу передаст весь желаемый набор
+         */
+        void reset_subscriptions() {
+            {
+                std::lock_guard<std::mutex> lock(subscription_mutex);
+                subscription_manager.reset();
+            }
+            subscription_cv.notify_one();
+        }
+
+        using period_list = std::vector<uint32_t>;
+        using subscription_index = std::vector<period_list>;    /**< Индекс - номер символа */
+        /** \brief Снимок периодов символов для парсера
+         *
+         * Снимок заменяется целиком при изменении подписок, поэтому парсер
+         * получает периоды тика без блокировки и без копирования списка
+         */
+        std::shared_ptr<const subscription_index> subscriptions = std::make_shared<const subscription_index>(common::SymbolRegistry::get().size());
+
+        /** \brief Опубликовать снимок периодов символов
+         *
+         * Метод вызывается под list_subscriptions_mutex
+         */
+        void publish_subscriptions() {
+            std::shared_ptr<subscription_index> index = std::make_shared<subscription_index>(list_subscriptions.size());
+            for(size_t i = 0; i < list_subscriptions.size(); ++i) {
+                (*index)[i].assign(list_subscriptions[i].begin(), list_subscriptions[i].end());
+            }
+            std::atomic_store(&subscriptions, std::shared_ptr<const subscription_index>(index));
+        }
+
+        std::string frame_buffer;   /**< Буфер сообщения, используется повторно потоком соединения */
+
+        /** \brief Сообщение в очереди потока разбора
+         */
+        class ReceivedFrame {
+        public:
+            std::string data;                       /**< Текст сообщения, память ячейки используется повторно */
+            xtime::ftimestamp_t timestamp = 0;      /**< Время получения сообщения по часам ПК */
+
+            ReceivedFrame() {};
+        };
+
+        std::unique_ptr<SpscRing<ReceivedFrame>> frame_ring;    /**< Очередь сообщений для потока разбора. nullptr - сообщения разбираются в io-потоке */
+        std::thread parser_thread;              /**< Поток разбора сообщений */
+        std::mutex parser_mutex;
+        std::condition_variable parser_cv;
+        std::atomic<bool> is_parser_wait = ATOMIC_VAR_INIT(false);  /**< Поток разбора ждет сообщений */
+        std::atomic<bool> is_parser_stop = ATOMIC_VAR_INIT(false);  /**< Флаг для остановки потока разбора */
+
+        std::atomic<bool> is_parser_thread = ATOMIC_VAR_INIT(false);        /**< Режим разбора, задается до start() */
+        std::atomic<size_t> frame_ring_capacity = ATOMIC_VAR_INIT(4096);    /**< Размер очереди сообщений, задается до start() */
+
+        std::atomic<uint64_t> pipeline_frames = ATOMIC_VAR_INIT(0);     /**< Получено сообщений */
+        std::atomic<uint64_t> pipeline_dropped = ATOMIC_VAR_INIT(0);    /**< Отброшено сообщений из-за переполнения очереди */
+        std::atomic<size_t> pipeline_max_queue = ATOMIC_VAR_INIT(0);    /**< Наибольшая занятость очереди */
+
+        /** \brief Принять сообщение в io-потоке
+         *
+         * В режиме потока разбора сообщение копируется в очередь,
+         * иначе разбирается сразу
+         * \param message Сообщение вебсокета
+         */
+        void receive_frame(const std::shared_ptr<WssClient::InMessage> &message) {
+            ++pipeline_frames;
+            const xtime::ftimestamp_t timestamp = xtime::get_ftimestamp();
+            if(!frame_ring) {
+                /* буфер сообщения используется повторно, чтобы не выделять память на каждое сообщение */
+                frame_buffer.resize(message->size());
+                message->read(&frame_buffer[0], frame_buffer.size());
+                parser(frame_buffer.data(), (size_t)message->gcount(), timestamp);
+                return;
+            }
+
+            ReceivedFrame *frame = frame_ring->begin_push();
+            if(!frame) {
+                /* поток разбора не успевает, сообщение отбрасываем, чтобы не задерживать чтение сокета */
+                ++pipeline_dropped;
+                return;
+            }
+            frame->data.resize(message->size());
+            message->read(&frame->data[0], frame->data.size());
+            frame->data.resize((size_t)message->gcount());
+            frame->timestamp = timestamp;
+            frame_ring->end_push();
+
+            const size_t queue = frame_ring->size();
+            size_t max_queue = pipeline_max_queue.load(std::memory_order_relaxed);
+            while(queue > max_queue && !pipeline_max_queue.compare_exchange_weak(max_queue, queue)) {};
+
+            /* будим поток разбора, только если он ждет */
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if(is_parser_wait) {
+                std::lock_guard<std::mutex> lock(parser_mutex);
+                parser_cv.notify_one();
+            }
+        }
+
+        /** \brief Цикл потока разбора сообщений
+         * \param config Настройки потоков
+         */
+        void run_parser_thread(const common::ThreadConfig config) {
+            std::string name;
+            if(!config.name.empty()) name = config.name + "-parser";
+            common::apply_thread_config(config.callback_cores, 0, name);
+            const uint64_t WAIT_DELAY = 100;
+            while(!is_parser_stop) {
+                ReceivedFrame *frame = frame_ring->front();
+                if(frame) {
+                    parser(frame->data.data(), frame->data.size(), frame->timestamp);
+                    frame_ring->pop();
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(parser_mutex);
+                is_parser_wait = true;
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                parser_cv.wait_for(lock, std::chrono::milliseconds(WAIT_DELAY), [&]{
+                    return is_parser_stop || !frame_ring->empty();
+                });
+                is_parser_wait = false;
+            }
+        }
+
+        /** \brief Остановить поток разбора сообщений
+         */
+        void stop_parser_thread() {
+            if(!parser_thread.joinable()) return;
+            {
+                std::lock_guard<std::mutex> lock(parser_mutex);
+                is_parser_stop = true;
+            }
+            parser_cv.notify_one();
+            parser_thread.join();
+        }
+
         //std::map<std::string, common::SymbolConfig> symbols_config;
         //std::mutex symbols_config_mutex;
 
-        using candle_data = std::map<xtime::timestamp_t, CANDLE>;
-        using period_data = std::map<uint32_t, candle_data>;
-        std::map<std::string, period_data> candles;
-        std::recursive_mutex candles_mutex;
+        using period_data = std::vector<std::shared_ptr<CandleSeries<CANDLE>>>;    /**< Ряды баров символа, по одному на период */
+        using candle_index = std::vector<period_data>;     /**< Индекс - номер символа */
+        /** \brief Индекс рядов баров
+         *
+         * Индекс не изменяется после публикации: новый ряд добавляется в копию индекса,
+         * которая заменяет текущую через atomic_store. Поэтому читатели находят ряд без блокировок
+         */
+        std::shared_ptr<const candle_index> candles = std::make_shared<const candle_index>(common::SymbolRegistry::get().size());
+        std::recursive_mutex candles_mutex;     /**< Защищает запись баров, читатели его не используют */
+
+        CandleRetention default_retention;      /**< Политика хранения новых рядов */
+        std::map<std::pair<common::SymbolId, uint32_t>, CandleRetention> series_retention;  /**< Политика хранения отдельных рядов */
+        std::mutex retention_mutex;
+
+        /** \brief Получить политику хранения ряда
+         * \param symbol_id Номер символа
+         * \param period Период
+         * \return Политика хранения
+         */
+        CandleRetention get_retention(const common::SymbolId symbol_id, const uint32_t period) {
+            std::lock_guard<std::mutex> lock(retention_mutex);
+            auto it = series_retention.find(std::make_pair(symbol_id, period));
+            if(it == series_retention.end()) return default_retention;
+            return it->second;
+        }
 
         std::atomic<bool> is_websocket_init;    /**< Состояние соединения */
         std::atomic<bool> is_error;             /**< Ошибка соединения */
@@ -94,6 +381,11 @@ namespace binomo_api {
 
         std::atomic<double> last_server_timestamp = ATOMIC_VAR_INIT(0.0);
 
+        std::atomic<bool> is_replay = ATOMIC_VAR_INIT(false);           /**< Время сервера задает воспроизведение */
+        std::atomic<double> replay_timestamp = ATOMIC_VAR_INIT(0.0);    /**< Время воспроизведения в момент replay_pc_timestamp */
+        std::atomic<double> replay_pc_timestamp = ATOMIC_VAR_INIT(0.0); /**< Время компьютера при установке часов воспроизведения */
+        std::atomic<double> replay_speed = ATOMIC_VAR_INIT(0.0);        /**< Скорость воспроизведения, 0 - время стоит на последнем тике */
+
         /** \brief Обновить смещение метки времени
          *
          * Данный метод использует оптимизированное скользящее среднее
@@ -120,187 +412,277 @@ namespace binomo_api {
                 (xtime::ftimestamp_t)array_offset_timestamp_size;
         }
 
+        /** \brief Найти ряд баров
+         *
+         * Метод не использует блокировки и предназначен для читателей
+         * \param symbol_id Номер символа
+         * \param period Период
+         * \return Ряд или nullptr, если ряда нет
+         */
+        std::shared_ptr<const CandleSeries<CANDLE>> find_series(const common::SymbolId symbol_id, const uint32_t period) {
+            std::shared_ptr<const candle_index> index = std::atomic_load(&candles);
+            if(symbol_id >= index->size()) return nullptr;
+            const period_data &symbol_data = (*index)[symbol_id];
+            for(size_t i = 0; i < symbol_data.size(); ++i) {
+                if(symbol_data[i]->get_period() == period) return symbol_data[i];
+            }
+            return nullptr;
+        }
+
+        /** \brief Найти ряд баров для записи
+         *
+         * Метод нужно вызывать под candles_mutex с известным номером символа
+         * \param symbol_id Номер символа
+         * \param period Период
+         * \return Ряд или nullptr, если ряда нет
+         */
+        CandleSeries<CANDLE> *find_write_series(const common::SymbolId symbol_id, const uint32_t period) {
+            /* индекс меняет только писатель под candles_mutex, поэтому читаем его напрямую */
+            const period_data &symbol_data = (*candles)[symbol_id];
+            for(size_t i = 0; i < symbol_data.size(); ++i) {
+                if(symbol_data[i]->get_period() == period) return symbol_data[i].get();
+            }
+            return nullptr;
+        }
+
+        /** \brief Получить ряд баров для записи, создав его при необходимости
+         *
+         * Метод нужно вызывать под candles_mutex с известным номером символа
+         * \param symbol_id Номер символа
+         * \param period Период
+         * \return Ряд баров
+         */
+        CandleSeries<CANDLE> &get_series(const common::SymbolId symbol_id, const uint32_t period) {
+            CandleSeries<CANDLE> *current_series = find_write_series(symbol_id, period);
+            if(current_series != nullptr) return *current_series;
+            std::shared_ptr<candle_index> index = std::make_shared<candle_index>(*candles);
+            std::shared_ptr<CandleSeries<CANDLE>> series = std::make_shared<CandleSeries<CANDLE>>(period, get_retention(symbol_id, period));
+            (*index)[symbol_id].push_back(series);
+            std::atomic_store(&candles, std::shared_ptr<const candle_index>(index));
+            return *series;
+        }
+
+        /** \brief Добавить к бару тик или приращение дочернего бара
+         * \param candle Бар
+         * \param price Цена
+         * \param volume Приращение объема
+         */
+        static inline void merge_candle(CANDLE &candle, const double price, const double volume) {
+            candle.close = price;
+            if(price > candle.high) candle.high = price;
+            if(price < candle.low) candle.low = price;
+            candle.volume += volume;
+        }
+
+        /** \brief Обновить бары символа тиком
+         *
+         * Периоды образуют цепочку агрегации: тик обновляет бар наименьшего периода,
+         * а бары старших периодов получают то же приращение цены и объема за O(1),
+         * поэтому объем считается один раз на тик. Закрытие бара проходит вверх по цепочке
+         * за один проход: бар старшего периода может закрыться только вместе с баром младшего.
+         * Ряды изменяются между begin_write и end_write, а функции обратного вызова
+         * вызываются после записи, чтобы они могли читать бары потока.
+         * Ряды создаются вместе с подпиской, поэтому период без ряда уже удален и пропускается
+         * \param tick Тик
+         * \param list_period Периоды символа в порядке возрастания
+         */
+        void update_candles(const common::StreamTick &tick, const period_list &list_period) {
+            std::lock_guard<std::recursive_mutex> lock(candles_mutex);
+
+            /* в ходе наблюдений было обнаружено,
+             * что 0-секунда считается прыдудщим баром, а не новым
+             * поэтому нужно вычесть 1 секунду из метки времени
+             */
+            const xtime::timestamp_t timestamp = (xtime::timestamp_t)tick.timestamp - 1;
+
+            /* приращение объема определяется по бару наименьшего периода */
+            double volume_delta = 0;
+            bool is_volume_delta = false;
+            bool is_child_closed = true;
+
+            for(auto &p : list_period) {
+                /* в ходе наблюдений было обнаружено,
+                 * что время бара взято как время окончания бара
+                 * а не время начала
+                 */
+                const xtime::timestamp_t bar_timestamp = (timestamp - (timestamp % (p))) + p;
+
+                /* снимок подписок мог быть взят до удаления периода */
+                CandleSeries<CANDLE> *current_series = find_write_series(tick.symbol_id, p);
+                if(current_series == nullptr) continue;
+                CandleSeries<CANDLE> &series = *current_series;
+                CANDLE closed_candle;
+                CANDLE candle;
+                bool is_closed = false;
+                bool is_updated = false;
+                series.begin_write();
+                CANDLE *last_candle = series.get_last();
+                if(!is_volume_delta) {
+                    if(volume_mode == MODE_VOLUME_ACC) {
+                        volume_delta = 1.0d;
+                    } else
+                    if(volume_mode == MODE_VOLUME_WEIGHT_ACC && last_candle != nullptr) {
+                        const double diff = std::abs(tick.price - last_candle->close);
+                        volume_delta = (std::pow(10.0d, tick.precision) * diff + 0.5d);
+                    }
+                    is_volume_delta = true;
+                }
+                /* если бар младшего периода не закрылся, бар старшего периода - последний в ряду */
+                CANDLE *current_candle = (!is_child_closed && last_candle != nullptr && last_candle->timestamp == bar_timestamp) ?
+                    last_candle : series.find(bar_timestamp);
+                if(current_candle == nullptr) {
+                    if(last_candle != nullptr && last_candle->timestamp < bar_timestamp) {
+                        /* новый бар закрывает последний бар */
+                        closed_candle = *last_candle;
+                        is_closed = true;
+                    }
+                    /* добавляем бар */
+                    candle = CANDLE(tick.price,tick.price,tick.price,tick.price,bar_timestamp);
+                    if(volume_mode == MODE_VOLUME_ACC) {
+                        candle.volume = 1;
+                    } else
+                    if(volume_mode == MODE_VOLUME_WEIGHT_ACC) {
+                        candle.volume = 0;
+                    }
+                    is_updated = series.set(candle);
+                } else {
+                    merge_candle(*current_candle, tick.price, volume_mode == MODE_NO_VOLUME ? 0.0 : volume_delta);
+                    candle = *current_candle;
+                    is_updated = true;
+                }
+                series.end_write();
+                is_child_closed = is_closed || current_candle == nullptr;
+
+                if(is_closed) {
+                    /* вызываем функцию обратного вызова закрытия бара */
+                    if(on_candle != nullptr) on_candle(tick.symbol_id, closed_candle, p, true);
+                    /* записываем закрытый бар в хранилище */
+                    queue_store_candle(tick.symbol_id, p, closed_candle);
+                }
+                if(is_updated && on_candle != nullptr) on_candle(tick.symbol_id, candle, p, false);
+            }
+        }
+
+        /** \brief Заполнить ряд старшего периода из ряда младшего периода
+         *
+         * Младшим выбирается наибольший период символа, на который делится period.
+         * Если ряд периода уже есть, он не изменяется.
+         * Метод нужно вызывать под candles_mutex
+         * \param symbol_id Номер символа
+         * \param period Период
+         */
+        void aggregate_series(const common::SymbolId symbol_id, const uint32_t period) {
+            std::shared_ptr<CandleSeries<CANDLE>> child;
+            const period_data &symbol_data = (*candles)[symbol_id];
+            for(size_t i = 0; i < symbol_data.size(); ++i) {
+                const uint32_t child_period = symbol_data[i]->get_period();
+                /* ряд уже есть, его бары не пересчитываются */
+                if(child_period == period) return;
+                if(child_period >= period || (period % child_period) != 0) continue;
+                if(!child || child->get_period() < child_period) child = symbol_data[i];
+            }
+            if(!child || child->empty()) return;
+            CandleSeries<CANDLE> &series = get_series(symbol_id, period);
+            series.begin_write();
+            /* бары младшего ряда перебираются по ячейкам за один проход в порядке времени */
+            child->for_each([&](const CANDLE &child_candle) {
+                const xtime::timestamp_t bar_timestamp = ((child_candle.timestamp - 1) / period) * period + period;
+                CANDLE *candle = series.find(bar_timestamp);
+                if(candle == nullptr) {
+                    CANDLE new_candle = child_candle;
+                    new_candle.timestamp = bar_timestamp;
+                    series.set(new_candle);
+                    return;
+                }
+                merge_candle(*candle, child_candle.close, child_candle.volume);
+                if(child_candle.high > candle->high) candle->high = child_candle.high;
+                if(child_candle.low < candle->low) candle->low = child_candle.low;
+            });
+            series.end_write();
+        }
+
         void send(const std::string &message) {
             std::lock_guard<std::mutex> lock(save_connection_mutex);
             if(!save_connection) return;
             save_connection->send(message);
         }
 
+        /** \brief Обработать тик
+         *
+         * Тик записывается в ленту, передается в on_tick и обновляет бары символа.
+         * Через этот метод проходят и тики потока, и тики воспроизведения
+         * \param tick Тик
+         * \param index Снимок периодов символов
+         */
+        void process_tick(const common::StreamTick &tick, const subscription_index &index) {
+            /* записываем тик в ленту, запись на диск выполняет поток ленты */
+            std::shared_ptr<TickTapeWriter> tape = std::atomic_load(&tick_tape);
+            if(tape) tape->write(tick);
+
+            /* обрабатываем функцию обратного вызова поступления тика */
+            if(on_tick != nullptr) on_tick(tick);
+
+            const period_list &list_period = index[tick.symbol_id];
+            if(list_period.empty()) return;
+            update_candles(tick, list_period);
+        }
+
         /** \brief Парсер сообщения от вебсокета
-         * \param response Ответ от сервера
+         *
+         * Сообщение разбирается по месту, на каждый тик память не выделяется
+         * \param data Ответ от сервера
+         * \param size Длина ответа
+         * \param receive_timestamp Время получения сообщения по часам ПК
          */
-        void parser(const std::string &response) {
-            //std::cout << response << std::endl;
+        void parser(const char *data, const size_t size, const xtime::ftimestamp_t receive_timestamp) {
             /* Пример сообщений
              * {"data":[{"field":"BTC/USD","action":"subscribe"}],"success":true,"errors":[]}
              * {"data":[{"assets":[{"rate":10800.91635,"precision":5,"repeat":0,"ask":10900.9164,"created_at":"2020-09-27T01:25:08.000000Z","bid":10700.9163,"ric":"BTC/USD"}],"action":"assets"}],"success":true,"errors":[]}
              * {"data":[{"assets":[{"rate":10800.90365,"precision":5,"repeat":0,"ask":10900.9037,"created_at":"2020-09-27T01:25:10.000000Z","bid":10700.9036,"ric":"BTC/USD"}],"action":"assets"}],"success":true,"errors":[]}
              */
-            try {
-                json j = json::parse(response);
-                if(j["success"] == true) {
-                    json j_data = j["data"];
-                    for(size_t j = 0; j < j_data.size(); ++j) {
-                        if(j_data[j]["action"] != "assets") continue;
-                        json j_assets = j_data[j]["assets"];
-                        for(size_t i = 0; i < j_assets.size(); ++i) {
-                            json j_element = j_assets[i];
-                            common::StreamTick tick;
-                            tick.price = j_element["rate"];
-                            tick.precision = j_element["precision"];
-                            //j_element["ask"];
-                            //j_element["bid"];
-                            tick.symbol = j_element["ric"];
-                            auto it_normalize_name = common::ric_to_normalize_name.find(tick.symbol);
-                            if(it_normalize_name == common::ric_to_normalize_name.end()) continue;
-                            tick.symbol = it_normalize_name->second;//common::normalize_symbol_name(tick.symbol);
-
-                            std::string str_iso = j_element["created_at"];
-                            xtime::DateTime date_time;
-                            if(!xtime::convert_iso(str_iso, date_time)) continue;
-                            const double ftimestamp = date_time.get_ftimestamp();
-                            tick.timestamp = date_time.get_timestamp();
-
-                            /* проверяем, не поменялась ли метка времени */
-                            if(last_timestamp < ftimestamp) {
-
-                                /* если метка времени поменялась, найдем время сервера */
-                                xtime::ftimestamp_t pc_timestamp = xtime::get_ftimestamp();
-                                xtime::ftimestamp_t offset_timestamp = ftimestamp - pc_timestamp;
-                                update_offset_timestamp(offset_timestamp);
-                                last_timestamp = ftimestamp;
-
-                                /* запоминаем последнюю метку времени сервера */
-                                last_server_timestamp = ftimestamp;
-                            }
-
-                            /* обрабатываем функцию обратного вызова поступления тика */
-                            if(on_tick != nullptr) on_tick(tick);
-
-                            std::list<uint32_t> list_period;
-                            {
-                                std::lock_guard<std::mutex> lock(list_subscriptions_mutex);
-                                auto it_list_symbol = list_subscriptions.find(tick.symbol);
-                                if(it_list_symbol == list_subscriptions.end()) {
-                                    continue;
-                                }
-                                list_period = it_list_symbol->second;
-                            }
-
-                            std::lock_guard<std::recursive_mutex> lock(candles_mutex);
-                            for(auto &p : list_period) {
-
-                                /* в ходе наблюдений было обнаружено,
-                                 * что 0-секунда считается прыдудщим баром, а не новым
-                                 * поэтому нужно вычесть 1 секунду из метки времени
-                                 */
-                                const xtime::timestamp_t timestamp = tick.timestamp - 1;
-
-                                /* в ходе наблюдений было обнаружено,
-                                 * что время бара взято как время окончания бара
-                                 * а не время начала
-                                 */
-                                const xtime::timestamp_t bar_timestamp = (timestamp - (timestamp % (p))) + p;
-
-                                auto it_symbol = candles.find(tick.symbol);
-                                if(it_symbol == candles.end()) {
-                                    /* если символ не найден, значит бара вообще нет. Инициализируем */
-                                    CANDLE candle(tick.price,tick.price,tick.price,tick.price, bar_timestamp);
-                                    if(volume_mode == MODE_VOLUME_ACC) {
-                                        candle.volume = 1;
-                                    } else
-                                    if(volume_mode == MODE_VOLUME_WEIGHT_ACC) {
-                                        candle.volume = 0;
-                                    }
-                                    candles[tick.symbol][(p)][bar_timestamp] = candle;
-                                    if(on_candle != nullptr) on_candle(tick.symbol, candle, p,  false);
-                                } else {
-                                    /* символ найдет, ищем период */
-                                    auto it_period = it_symbol->second.find(p);
-                                    if(it_period == it_symbol->second.end()) {
-                                        /* период не найден, значит бара вообще нет. Инициализируем */
-                                        CANDLE candle(tick.price,tick.price,tick.price,tick.price,bar_timestamp);
-                                        if(volume_mode == MODE_VOLUME_ACC) {
-                                            candle.volume = 1;
-                                        } else
-                                        if(volume_mode == MODE_VOLUME_WEIGHT_ACC) {
-                                            candle.volume = 0;
-                                        }
-                                        candles[tick.symbol][(p)][bar_timestamp] = candle;
-                                        if(on_candle != nullptr) on_candle(tick.symbol, candle, p, false);
-                                    } else {
-                                        /* период найдет, ищем бар */
-                                        auto it_last_candle = it_period->second.find(bar_timestamp);
-                                        if(it_last_candle == it_period->second.end()) {
-                                            /* бар не найден */
-                                            if(it_period->second.size() > 0) {
-                                                /* если данные уже есть */
-                                                auto it_candle = it_period->second.begin();
-                                                /* получаем последний бар, вызываем функцию обратного вызова */
-                                                std::advance(it_candle, it_period->second.size() - 1);
-                                                if(on_candle != nullptr) on_candle(tick.symbol, it_candle->second, p, true);
-                                            }
-                                            /* добавляем бар */
-                                            CANDLE candle(tick.price,tick.price,tick.price,tick.price,bar_timestamp);
-                                            if(volume_mode == MODE_VOLUME_ACC) {
-                                                candle.volume = 1;
-                                            } else
-                                            if(volume_mode == MODE_VOLUME_WEIGHT_ACC) {
-                                                candle.volume = 0;
-                                            }
-                                            candles[tick.symbol][p][bar_timestamp] = candle;
-                                            if(on_candle != nullptr) on_candle(tick.symbol, candle, p, false);
-                                        } else {
-                                            auto &candle = it_last_candle->second;
-                                            if(volume_mode == MODE_VOLUME_ACC) {
-                                                candle.volume += 1.0d;
-                                            } else
-                                            if(volume_mode == MODE_VOLUME_WEIGHT_ACC) {
-                                                if(candle.volume == 0) {
-                                                    auto it_candle = it_period->second.begin();
-                                                    /* получаем последний бар, вызываем функцию обратного вызова */
-                                                    std::advance(it_candle, it_period->second.size() - 1);
-                                                    const double diff = std::abs(tick.price - it_candle->second.close);
-                                                    candle.volume += (std::pow(10.0d, tick.precision) * diff + 0.5d);
-                                                } else {
-                                                    const double diff = std::abs(tick.price - candle.close);
-                                                    candle.volume += (std::pow(10.0d, tick.precision) * diff + 0.5d);
-                                                }
-                                            }
-                                            candle.close = tick.price;
-                                            if(tick.price > candle.high) candle.high = tick.price;
-                                            if(tick.price < candle.low) candle.low = tick.price;
-                                            if(on_candle != nullptr) on_candle(tick.symbol, candle, p, false);
-                                        }
-                                    }
-                                }
-                            } // for
-                        } // for i
-                    } // for j
+            std::shared_ptr<const subscription_index> index = std::atomic_load(&subscriptions);
+            const bool is_parsed = QuoteFrameParser::parse(data, size, [&](const common::StreamTick &tick) {
+                /* проверяем, не поменялась ли метка времени */
+                if(last_timestamp < tick.timestamp) {
+
+                    /* если метка времени поменялась, найдем время сервера.
+                     * Берем время получения сообщения, чтобы задержка в очереди потока разбора не смещала оценку
+                     */
+                    xtime::ftimestamp_t offset_timestamp = tick.timestamp - receive_timestamp;
+                    update_offset_timestamp(offset_timestamp);
+                    last_timestamp = tick.timestamp;
+
+                    /* запоминаем последнюю метку времени сервера */
+                    last_server_timestamp = tick.timestamp;
                 }
-                is_websocket_init = true;
-            }
-            catch(const json::parse_error& e) {
-                std::cerr << "binomo api: BinomoApiPriceStream--->parser json::parse_error, what = " << e.what()
-                   << " exception_id = " << e.id << std::endl;
-            }
-            catch(json::out_of_range& e) {
-                std::cerr << "binomo api: BinomoApiPriceStream--->parser json::out_of_range, what = " << e.what()
-                   << " exception_id = " << e.id << std::endl;
-            }
-            catch(json::type_error& e) {
-                std::cerr << "binomo api: BinomoApiPriceStream--->parser json::type_error, what = " << e.what()
-                   << " exception_id = " << e.id << std::endl;
-            }
-            catch(...) {
+
+                process_tick(tick, *index);
+            },
+            [&](const common::SymbolId symbol_id, const bool is_subscribe) {
+                subscription_manager.on_ack(symbol_id, is_subscribe);
+            });
+            if(!is_parsed) {
                 std::cerr << "binomo api: BinomoApiPriceStream--->parser json error" << std::endl;
+                return;
             }
+            is_websocket_init = true;
+        }
+
+        /** \brief Парсер сообщения от вебсокета
+         * \param response Ответ от сервера
+         */
+        inline void parser(const std::string &response) {
+            parser(response.data(), response.size(), xtime::get_ftimestamp());
         }
 
     public:
 
+        /** \brief Функция обратного вызова обновления бара
+         *
+         * Имя символа можно получить через common::get_symbol_name(symbol_id)
+         */
         std::function<void(
-            const std::string &symbol,
+            const common::SymbolId symbol_id,
             const CANDLE &candle,
             const uint32_t period,
             const bool close_candle)> on_candle = nullptr;
@@ -325,6 +707,7 @@ namespace binomo_api {
             std::shared_ptr<WssClient> client_ptr = std::atomic_load(&client);
             if(client_ptr) {
                 client_ptr->stop();
+                if(client_ptr->io_service) client_ptr->io_service->stop();
             }
 
             if(client_future.valid()) {
@@ -339,6 +722,22 @@ namespace binomo_api {
                     std::cerr << "binomo api: ~BinomoApiPriceStream() error" << std::endl;
                 }
             }
+            if(subscription_future.valid()) {
+                {
+                    std::lock_guard<std::mutex> lock(subscription_mutex);
+                }
+                subscription_cv.notify_one();
+                subscription_future.wait();
+            }
+            stop_parser_thread();
+            if(store_future.valid()) {
+                {
+                    std::lock_guard<std::mutex> lock(store_mutex);
+                    is_store_stop = true;
+                }
+                store_cv.notify_one();
+                store_future.wait();
+            }
         };
 
         /** \brief Состояние соединения
@@ -373,9 +772,57 @@ namespace binomo_api {
          * \return Метка времени сервера
          */
         inline xtime::ftimestamp_t get_server_timestamp() {
+            if(is_replay) {
+                if(replay_speed <= 0) return replay_timestamp;
+                return replay_timestamp + (xtime::get_ftimestamp() - replay_pc_timestamp) * replay_speed;
+            }
             return xtime::get_ftimestamp() + offset_timestamp;
         }
 
+        /** \brief Установить часы воспроизведения
+         *
+         * После вызова время сервера задает воспроизведение: get_server_timestamp()
+         * и wait_candle_close() следуют времени тиков, а не времени компьютера
+         * \param timestamp Время воспроизведения
+         * \param speed Скорость воспроизведения. 1 - реальное время, N - в N раз быстрее,
+         * 0 - время изменяется только тиками replay_tick
+         */
+        void set_replay_clock(const xtime::ftimestamp_t timestamp, const double speed) {
+            is_replay = false;
+            replay_speed = std::max(0.0, speed);
+            replay_pc_timestamp = xtime::get_ftimestamp();
+            replay_timestamp = timestamp;
+            is_replay = true;
+        }
+
+        /** \brief Вернуть время сервера к времени потока котировок
+         */
+        void reset_replay_clock() {
+            is_replay = false;
+        }
+
+        /** \brief Проверить, задает ли время сервера воспроизведение
+         * \return Вернет true, если установлены часы воспроизведения
+         */
+        inline bool check_replay() {
+            return is_replay;
+        }
+
+        /** \brief Воспроизвести тик
+         *
+         * Тик проходит тот же путь, что и тик потока котировок: on_tick, бары, on_candle.
+         * Если скорость воспроизведения 0, время сервера становится временем тика
+         * \param tick Тик
+         */
+        void replay_tick(const common::StreamTick &tick) {
+            if(tick.symbol_id >= list_subscriptions.size()) return;
+            if(is_replay && replay_speed <= 0) replay_timestamp = tick.timestamp;
+            last_server_timestamp = tick.timestamp;
+            is_websocket_init = true;
+            std::shared_ptr<const subscription_index> index = std::atomic_load(&subscriptions);
+            process_tick(tick, *index);
+        }
+
         /** \brief Получить последнюю метку времени сервера
          *
          * Данный метод возвращает последнюю полученную метку времени сервера. Часовая зона: UTC/GMT
@@ -392,6 +839,21 @@ namespace binomo_api {
             return offset_timestamp;
         }
 
+        /** \brief Получить цену тика символа
+         *
+         * \param symbol_id Номер символа
+         * \param period Период
+         * \return Последняя цена bid
+         */
+        inline double get_price(const common::SymbolId symbol_id, const uint32_t period) {
+            if(!is_websocket_init) return 0.0;
+            std::shared_ptr<const CandleSeries<CANDLE>> series = find_series(symbol_id, period);
+            if(!series) return 0.0;
+            CANDLE candle;
+            if(!series->load_last(candle)) return 0.0;
+            return candle.close;
+        }
+
         /** \brief Получить цену тика символа
          *
          * \param symbol Имя символа
@@ -399,18 +861,7 @@ namespace binomo_api {
          * \return Последняя цена bid
          */
         inline double get_price(const std::string &symbol, const uint32_t period) {
-            if(!is_websocket_init) return 0.0;
-            std::string s = common::to_upper_case(symbol);
-            std::lock_guard<std::recursive_mutex> lock(candles_mutex);
-            auto it_symbol = candles.find(s);
-            if(it_symbol == candles.end()) return 0.0;
-            auto it_period = it_symbol->second.find(period);
-            if(it_period == it_symbol->second.end()) return 0.0;
-            const size_t size_candle = it_period->second.size();
-            if(size_candle == 0) return 0.0;
-            auto it_begin_candle = it_period->second.begin();
-            std::advance(it_begin_candle, (size_candle - 1));
-            return it_begin_candle->second.close;
+            return get_price(symbol_registry.get_id(symbol), period);
         }
 
         /** \brief Получить цену тика символа
@@ -419,14 +870,32 @@ namespace binomo_api {
          */
         inline double get_price(const std::string &symbol) {
             if(!is_websocket_init) return 0.0;
-            std::string s = common::to_upper_case(symbol);
-            std::lock_guard<std::recursive_mutex> lock(candles_mutex);
-            auto it_symbol = candles.find(s);
-            if(it_symbol == candles.end()) return 0.0;
-            if(it_symbol->second.size() == 0) return 0.0;
-            auto it_period = it_symbol->second.begin();
-            auto it_begin_candle = it_period->second.begin();
-            return it_begin_candle->second.close;
+            const common::SymbolId symbol_id = symbol_registry.get_id(symbol);
+            std::shared_ptr<const candle_index> index = std::atomic_load(&candles);
+            if(symbol_id >= index->size()) return 0.0;
+            if((*index)[symbol_id].size() == 0) return 0.0;
+            CANDLE candle;
+            if(!(*index)[symbol_id].front()->load_last(candle)) return 0.0;
+            return candle.close;
+        }
+
+        /** \brief Получить бар
+         *
+         * \param symbol_id Номер символа
+         * \param period Период
+         * \param offset Смещение
+         * \return Бар
+         */
+        inline CANDLE get_candle(
+                const common::SymbolId symbol_id,
+                const uint32_t period,
+                const size_t offset = 0) {
+            if(!is_websocket_init) return CANDLE();
+            std::shared_ptr<const CandleSeries<CANDLE>> series = find_series(symbol_id, period);
+            if(!series) return CANDLE();
+            CANDLE candle;
+            if(!series->load(offset, candle)) return CANDLE();
+            return candle;
         }
 
         /** \brief Получить бар
@@ -440,19 +909,21 @@ namespace binomo_api {
                 const std::string &symbol,
                 const uint32_t period,
                 const size_t offset = 0) {
-            if(!is_websocket_init) return CANDLE();
-            std::string s = common::to_upper_case(symbol);
-            std::lock_guard<std::recursive_mutex> lock(candles_mutex);
-            auto it_symbol = candles.find(s);
-            if(it_symbol == candles.end()) return CANDLE();
-            auto it_period = it_symbol->second.find(period);
-            if(it_period == it_symbol->second.end()) return CANDLE();
-            const size_t size_candle = it_period->second.size();
-            if(size_candle == 0) return CANDLE();
-            if(offset >= size_candle) return CANDLE();
-            auto it_begin_candle = it_period->second.begin();
-            std::advance(it_begin_candle, (size_candle - 1 - offset));
-            return it_begin_candle->second;
+            return get_candle(symbol_registry.get_id(symbol), period, offset);
+        }
+
+        /** \brief Получить количество баров
+         * \param symbol_id Номер символа
+         * \param period Период
+         * \return Количество баров
+         */
+        inline uint32_t get_num_candles(
+                const common::SymbolId symbol_id,
+                const uint32_t period) {
+            if(!is_websocket_init) return 0;
+            std::shared_ptr<const CandleSeries<CANDLE>> series = find_series(symbol_id, period);
+            if(!series) return 0;
+            return series->load_size();
         }
 
         /** \brief Получить количество баров
@@ -463,14 +934,25 @@ namespace binomo_api {
         inline uint32_t get_num_candles(
                 const std::string &symbol,
                 const uint32_t period) {
-            if(!is_websocket_init) return 0;
-            std::string s = common::to_upper_case(symbol);
-            std::lock_guard<std::recursive_mutex> lock(candles_mutex);
-            auto it_symbol = candles.find(s);
-            if(it_symbol == candles.end()) return 0;
-            auto it_period = it_symbol->second.find(period);
-            if(it_period == it_symbol->second.end()) return 0;
-            return it_period->second.size();
+            return get_num_candles(symbol_registry.get_id(symbol), period);
+        }
+
+        /** \brief Получить бар по метке времени
+         * \param symbol_id Номер символа
+         * \param period Период
+         * \param timestamp Метка времени
+         * \return Бар
+         */
+        inline CANDLE get_timestamp_candle(
+                const common::SymbolId symbol_id,
+                const uint32_t period,
+                const xtime::timestamp_t timestamp) {
+            if(!is_websocket_init) return CANDLE();
+            std::shared_ptr<const CandleSeries<CANDLE>> series = find_series(symbol_id, period);
+            if(!series) return CANDLE();
+            CANDLE candle;
+            if(!series->load_timestamp(timestamp, candle)) return CANDLE();
+            return candle;
         }
 
         /** \brief Получить бар по метке времени
@@ -483,20 +965,12 @@ namespace binomo_api {
                 const std::string &symbol,
                 const uint32_t period,
                 const xtime::timestamp_t timestamp) {
-            if(!is_websocket_init) return CANDLE();
-            std::string s = common::to_upper_case(symbol);
-            std::lock_guard<std::recursive_mutex> lock(candles_mutex);
-            auto it_symbol = candles.find(s);
-            if(it_symbol == candles.end()) return CANDLE();
-            auto it_period = it_symbol->second.find(period);
-            if(it_period == it_symbol->second.end()) return CANDLE();
-            if(it_period->second.size() == 0) return CANDLE();
-            auto it_candle = it_period->second.find(timestamp);
-            if(it_candle == it_period->second.end()) return CANDLE();
-            return it_candle->second;
+            return get_timestamp_candle(symbol_registry.get_id(symbol), period, timestamp);
         }
 
         /** \brief Инициализировать массив японских свечей
+         *
+         * Бары, которые не проходят политику хранения ряда, не записываются
          * \param symbol Имя символа
          * \param period Период
          * \param new_candles Массив баров
@@ -507,26 +981,119 @@ namespace binomo_api {
                 const std::string &symbol,
                 const uint32_t period,
                 const T &new_candles) {
-            std::string s = common::to_upper_case(symbol);
+            const common::SymbolId symbol_id = symbol_registry.get_id(symbol);
+            if(symbol_id == common::INVALID_SYMBOL_ID) return common::DATA_NOT_AVAILABLE;
             std::lock_guard<std::recursive_mutex> lock(candles_mutex);
-            auto it_symbol = candles.find(s);
-            if(it_symbol == candles.end()) {
-                candles.insert(
-                    std::pair<std::string, period_data>(s, period_data()));
-                it_symbol = candles.find(s);
+            CandleSeries<CANDLE> &series = get_series(symbol_id, period);
+            series.begin_write();
+            for(auto &candle : new_candles) {
+                series.set(candle);
             }
-            auto it_period = it_symbol->second.find(period);
-            if(it_period == it_symbol->second.end()) {
-                it_symbol->second.insert(
-                    std::pair<uint32_t, candle_data>(period, candle_data()));
-                it_period = it_symbol->second.find(period);
+            series.end_write();
+            return common::OK;
+        }
+
+        /** \brief Установить емкость рядов баров
+         *
+         * Емкость применяется к рядам, которые будут созданы после вызова метода
+         * \param capacity Количество периодов, которое хранит ряд баров
+         */
+        void set_series_capacity(const size_t capacity) {
+            std::lock_guard<std::mutex> lock(retention_mutex);
+            default_retention.max_candles = capacity > 0 ? capacity : 1;
+        }
+
+        /** \brief Установить политику хранения баров по умолчанию
+         *
+         * Политика применяется к рядам, которые будут созданы после вызова метода
+         * \param retention Политика хранения
+         */
+        void set_retention(const CandleRetention &retention) {
+            std::lock_guard<std::mutex> lock(retention_mutex);
+            default_retention = retention;
+        }
+
+        /** \brief Установить политику хранения баров ряда
+         *
+         * Если ряд уже существует, он пересоздается с новой политикой,
+         * бары, которые не проходят политику, удаляются
+         * \param symbol Имя символа
+         * \param period Период
+         * \param retention Политика хранения
+         */
+        void set_retention(const std::string &symbol, const uint32_t period, const CandleRetention &retention) {
+            const common::SymbolId symbol_id = symbol_registry.get_id(symbol);
+            if(symbol_id == common::INVALID_SYMBOL_ID) return;
+            {
+                std::lock_guard<std::mutex> lock(retention_mutex);
+                series_retention[std::make_pair(symbol_id, period)] = retention;
             }
+            std::lock_guard<std::recursive_mutex> lock(candles_mutex);
+            const period_data &symbol_data = (*candles)[symbol_id];
+            for(size_t i = 0; i < symbol_data.size(); ++i) {
+                const CandleSeries<CANDLE> &old_series = *symbol_data[i];
+                if(old_series.get_period() != period) continue;
+                std::shared_ptr<CandleSeries<CANDLE>> series = std::make_shared<CandleSeries<CANDLE>>(period, retention);
+                series->begin_write();
+                old_series.for_each([&](const CANDLE &candle) {
+                    series->set(candle);
+                });
+                series->end_write();
+                std::shared_ptr<candle_index> index = std::make_shared<candle_index>(*candles);
+                (*index)[symbol_id][i] = series;
+                std::atomic_store(&candles, std::shared_ptr<const candle_index>(index));
+                return;
+            }
+        }
 
-            for(auto &candle : new_candles) {
-                it_period->second.insert(
-                    std::pair<xtime::timestamp_t, CANDLE>(candle.timestamp, candle));
+        /// Состояние ряда баров
+        class SeriesStats {
+        public:
+            common::SymbolId symbol_id = common::INVALID_SYMBOL_ID;
+            std::string symbol;
+            uint32_t period = 0;
+            size_t candles = 0;             /**< Количество баров */
+            size_t max_candles = 0;         /**< Емкость ряда */
+            xtime::timestamp_t max_age = 0; /**< Максимальный возраст бара, секунды */
+            size_t memory_usage = 0;        /**< Объем памяти, байты */
+
+            SeriesStats() {};
+        };
+
+        /** \brief Получить состояние рядов баров
+         *
+         * Метод не блокирует поток котировок
+         * \return Состояние каждого ряда
+         */
+        std::vector<SeriesStats> get_series_stats() {
+            std::vector<SeriesStats> stats;
+            std::shared_ptr<const candle_index> index = std::atomic_load(&candles);
+            for(common::SymbolId symbol_id = 0; symbol_id < index->size(); ++symbol_id) {
+                const period_data &symbol_data = (*index)[symbol_id];
+                for(size_t i = 0; i < symbol_data.size(); ++i) {
+                    const CandleSeries<CANDLE> &series = *symbol_data[i];
+                    SeriesStats item;
+                    item.symbol_id = symbol_id;
+                    item.symbol = symbol_registry.get_name(symbol_id);
+                    item.period = series.get_period();
+                    item.candles = series.load_size();
+                    item.max_candles = series.get_retention().max_candles;
+                    item.max_age = series.get_retention().max_age;
+                    item.memory_usage = series.get_memory_usage();
+                    stats.push_back(item);
+                }
             }
-            return common::OK;
+            return stats;
+        }
+
+        /** \brief Получить объем памяти, который занимают ряды баров
+         * \return Объем памяти, байты
+         */
+        size_t get_memory_usage() {
+            size_t value = 0;
+            std::vector<SeriesStats> stats = get_series_stats();
+            for(size_t i = 0; i < stats.size(); ++i) value += stats[i].memory_usage;
+            return value;
         }
 
         /** \brief Ждать закрытие бара (минутного)
@@ -542,7 +1109,8 @@ namespace binomo_api {
                 const xtime::ftimestamp_t t = get_server_timestamp();
                 if(t >= timestamp_stop) break;
                 if(f != nullptr) f(t, timestamp_stop);
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                /* при воспроизведении время идет быстрее, поэтому проверяем его чаще */
+                std::this_thread::sleep_for(std::chrono::milliseconds(is_replay ? 1 : 100));
             }
         }
 
@@ -571,83 +1139,74 @@ namespace binomo_api {
         }
 
         /** \brief Подписаться на поток котировок символа
+         *
+         * Символ добавляется в желаемый набор. Подписка уходит на сервер
+         * с ближайшим пакетом изменений и восстанавливается после переподключения
          * \param symbol Имя символа
          */
         void subscribe_symbol(const std::string &symbol) {
-            // {"action":"subscribe","rics":["BTC/USD"]}
-            std::string s = common::to_upper_case(symbol);
-            s = binomo_api::common::normalize_symbol_name(s);
-            auto it_ric = binomo_api::common::normalize_name_to_ric.find(s);
-            if(it_ric == binomo_api::common::normalize_name_to_ric.end()) {
-                std::cerr << "binomo api: symbol " << s << " does not exist!" << std::endl;
+            const common::SymbolId symbol_id = symbol_registry.get_id(common::to_upper_case(symbol));
+            if(symbol_id == common::INVALID_SYMBOL_ID) {
+                std::cerr << "binomo api: symbol " << symbol << " does not exist!" << std::endl;
                 return;
             }
-            json j;
-            j["action"] = "subscribe";
-            j["rics"] = json::array();
-            j["rics"][0] = it_ric->second;
-            send(j.dump());
+            subscription_manager.set_direct(symbol_id, true);
         }
 
         /** \brief Одписаться от потока котировок символа
+         *
+         * Символ убирается из желаемого набора. Если у символа есть периоды баров,
+         * поток котировок символа сохраняется
          * \param symbol Имя символа
          */
         void unsubscribe_symbol(const std::string &symbol) {
-            // {"action":"unsubscribe","rics":["BTC/LTC"]}
-            std::string s = common::to_upper_case(symbol);
-            s = binomo_api::common::normalize_symbol_name(s);
-            auto it_ric = binomo_api::common::normalize_name_to_ric.find(s);
-            if(it_ric == binomo_api::common::normalize_name_to_ric.end()) {
-                std::cerr << "binomo api: symbol " << s << " does not exist!" << std::endl;
+            const common::SymbolId symbol_id = symbol_registry.get_id(common::to_upper_case(symbol));
+            if(symbol_id == common::INVALID_SYMBOL_ID) {
+                std::cerr << "binomo api: symbol " << symbol << " does not exist!" << std::endl;
                 return;
             }
-            json j;
-            j["action"] = "unsubscribe";
-            j["rics"] = json::array();
-            j["rics"][0] = it_ric->second;
-            send(j.dump());
+            subscription_manager.set_direct(symbol_id, false);
         }
 
         /** \brief Подписаться на поток котировок символов
          * \param symbols Имена символов
          */
         void subscribe_symbols(const std::vector<std::string> &symbols) {
-            // {"action":"subscribe","rics":["BTC/USD"]}
-            json j;
-            j["action"] = "subscribe";
-            j["rics"] = json::array();
             for(size_t i = 0; i < symbols.size(); ++i) {
-                std::string s = common::to_upper_case(symbols[i]);
-                s = binomo_api::common::normalize_symbol_name(s);
-                auto it_ric = binomo_api::common::normalize_name_to_ric.find(s);
-                if(it_ric == binomo_api::common::normalize_name_to_ric.end()) {
-					std::cerr << "binomo api: symbol " << s << " does not exist!" << std::endl;
-                    continue;
-				}
-                j["rics"][i] = it_ric->second;
+                subscribe_symbol(symbols[i]);
             }
-            send(j.dump());
         }
 
         /** \brief Отписаться от потока котировок символов
          * \param symbols Имена символов
          */
         void unsubscribe_symbols(const std::vector<std::string> &symbols) {
-            // {"action":"unsubscribe","rics":["BTC/LTC"]}
-            json j;
-            j["action"] = "unsubscribe";
-            j["rics"] = json::array();
             for(size_t i = 0; i < symbols.size(); ++i) {
-                std::string s = common::to_upper_case(symbols[i]);
-                s = binomo_api::common::normalize_symbol_name(s);
-                auto it_ric = binomo_api::common::normalize_name_to_ric.find(s);
-                if(it_ric == binomo_api::common::normalize_name_to_ric.end()) {
-					std::cerr << "binomo api: symbol " << s << " does not exist!" << std::endl;
-                    continue;
-				}
-                j["rics"][i] = it_ric->second;
+                unsubscribe_symbol(symbols[i]);
             }
-            send(j.dump());
+        }
+
+        /** \brief Установить интервал отправки изменений подписок
+         *
+         * Изменения подписок за интервал отправляются одним сообщением на действие
+         * \param interval Интервал в миллисекундах
+         */
+        void set_subscription_interval(const uint32_t interval) {
+            subscription_interval = std::max((uint32_t)1, interval);
+        }
+
+        /** \brief Получить желаемый набор символов
+         * \return Номера символов, на которые нужна подписка
+         */
+        std::vector<common::SymbolId> get_subscribed_symbols() {
+            return subscription_manager.get_desired();
+        }
+
+        /** \brief Получить статистику подписок
+         * \return Статистика подписок
+         */
+        SubscriptionManager::Stats get_subscription_stats() {
+            return subscription_manager.get_stats();
         }
 
         /** \brief Подписаться на котировки
@@ -655,22 +1214,117 @@ namespace binomo_api {
          * \return Вернет true, если подключение есть и сообщения были переданы
          */
         bool add_candles_stream(const std::vector<std::pair<std::string, uint32_t>> &symbol_list) {
+            std::lock_guard<std::recursive_mutex> candles_lock(candles_mutex);
             std::lock_guard<std::mutex> lock(list_subscriptions_mutex);
             for(auto &symbol : symbol_list) {
-                std::string s = binomo_api::common::normalize_symbol_name(symbol.first);
-				auto it_ric = binomo_api::common::normalize_name_to_ric.find(s);
-				if(it_ric == binomo_api::common::normalize_name_to_ric.end()) {
-					std::cerr << "binomo api: symbol " << s << " does not exist!" << std::endl;
+                const common::SymbolId symbol_id = symbol_registry.get_id(symbol.first);
+				if(symbol_id == common::INVALID_SYMBOL_ID) {
+					std::cerr << "binomo api: symbol " << symbol.first << " does not exist!" << std::endl;
                     continue;
 				}
-                list_subscriptions[symbol.first].push_back(symbol.second);
+                /* периоды хранятся по возрастанию, это порядок цепочки агрегации */
+                std::list<uint32_t> &list_period = list_subscriptions[symbol_id];
+                auto it_period = std::lower_bound(list_period.begin(), list_period.end(), symbol.second);
+                if(it_period == list_period.end() || *it_period != symbol.second) list_period.insert(it_period, symbol.second);
+                /* ряд создается до того, как период увидит парсер */
+                get_series(symbol_id, symbol.second);
+                subscription_manager.set_candles(symbol_id, true);
+            }
+            publish_subscriptions();
+            return true;
+        }
+
+        /** \brief Добавить период к символу во время работы
+         *
+         * Если символ уже в потоке, новая подписка на сервере не нужна:
+         * бары периода строятся из тех же тиков, а ряд заполняется барами младшего периода
+         * \param symbol Имя символа
+         * \param period Период
+         * \return Вернет false, если символ не существует
+         */
+        bool add_candles_period(const std::string &symbol, const uint32_t period) {
+            const common::SymbolId symbol_id = symbol_registry.get_id(common::to_upper_case(symbol));
+            if(symbol_id == common::INVALID_SYMBOL_ID) {
+                std::cerr << "binomo api: symbol " << symbol << " does not exist!" << std::endl;
+                return false;
             }
+            if(period == 0) return false;
+            {
+                /* ряд заполняется до того, как период увидит парсер */
+                std::lock_guard<std::recursive_mutex> candles_lock(candles_mutex);
+                aggregate_series(symbol_id, period);
+                get_series(symbol_id, period);
+                std::lock_guard<std::mutex> lock(list_subscriptions_mutex);
+                std::list<uint32_t> &list_period = list_subscriptions[symbol_id];
+                auto it_period = std::lower_bound(list_period.begin(), list_period.end(), period);
+                if(it_period == list_period.end() || *it_period != period) list_period.insert(it_period, period);
+                publish_subscriptions();
+            }
+            subscription_manager.set_candles(symbol_id, true);
             return true;
         }
 
+        /** \brief Убрать период символа во время работы
+         *
+         * Ряд баров периода удаляется. Если у символа не осталось периодов,
+         * символ отписывается от потока котировок
+         * \param symbol Имя символа
+         * \param period Период
+         */
+        void remove_candles_period(const std::string &symbol, const uint32_t period) {
+            const common::SymbolId symbol_id = symbol_registry.get_id(common::to_upper_case(symbol));
+            if(symbol_id == common::INVALID_SYMBOL_ID) return;
+            bool is_empty_symbol = false;
+            std::lock_guard<std::recursive_mutex> candles_lock(candles_mutex);
+            {
+                std::lock_guard<std::mutex> lock(list_subscriptions_mutex);
+                std::list<uint32_t> &list_period = list_subscriptions[symbol_id];
+                /* ряд удаляется, даже если периода уже нет в подписке */
+                const bool is_subscribed = !list_period.empty();
+                list_period.remove(period);
+                is_empty_symbol = is_subscribed && list_period.empty();
+                publish_subscriptions();
+            }
+            if(!(*candles)[symbol_id].empty()) {
+                std::shared_ptr<candle_index> index = std::make_shared<candle_index>(*candles);
+                period_data &symbol_data = (*index)[symbol_id];
+                for(size_t i = 0; i < symbol_data.size(); ++i) {
+                    if(symbol_data[i]->get_period() != period) continue;
+                    symbol_data.erase(symbol_data.begin() + i);
+                    break;
+                }
+                std::atomic_store(&candles, std::shared_ptr<const candle_index>(index));
+            }
+            if(is_empty_symbol) subscription_manager.set_candles(symbol_id, false);
+        }
+
         void set_volume_mode(const int value) {
             volume_mode = value;
         }
+
+        /** \brief Установить хранилище баров
+         *
+         * Закрытые бары потока котировок будут записываться в хранилище отдельным потоком
+         * \param store Хранилище баров
+         */
+        void set_candle_store(std::shared_ptr<CandleStore<CANDLE>> store) {
+            std::atomic_store(&candle_store, store);
+            if(!store) return;
+            std::lock_guard<std::mutex> lock(store_mutex);
+            if(store_future.valid()) return;
+            store_future = std::async(std::launch::async, [&]() {
+                run_store_writer();
+            });
+        }
+
+        /** \brief Установить ленту тиков
+         *
+         * Все тики потока котировок будут записываться в ленту
+         * \param tape Лента тиков. nullptr - запись ленты отключена
+         */
+        void set_tick_tape(std::shared_ptr<TickTapeWriter> tape) {
+            std::atomic_store(&tick_tape, tape);
+        }
 #if(0)
 		/** \brief Получить количество знаков после запятой
          * \param symbol Имя символа
@@ -768,8 +1422,78 @@ namespace binomo_api {
         }
 #endif
 
+        /** \brief Установить настройки потоков
+         *
+         * Функции on_tick и on_candle вызываются в io-потоках
+         * (или в потоке разбора, см. set_parser_thread()), поэтому
+         * закрепление io-потоков за ядрами отделяет поток котировок от открытия сделок.
+         * Метод нужно вызывать до start()
+         * \param config Настройки потоков
+         */
+        void set_thread_config(const common::ThreadConfig &config) {
+            std::lock_guard<std::mutex> lock(thread_config_mutex);
+            thread_config = config;
+        }
+
+        /** \brief Установить режим разбора сообщений
+         *
+         * В режиме потока разбора io-поток только копирует сообщение в очередь,
+         * а разбор и функции on_tick и on_candle выполняются в отдельном потоке,
+         * который закрепляется за ядром callback_cores[0] из настроек потоков.
+         * Поэтому медленная функция обратного вызова не задерживает чтение сокета.
+         * Если очередь заполнена, новые сообщения отбрасываются и учитываются в get_pipeline_stats().
+         * По умолчанию сообщения разбираются прямо в io-потоке. Метод нужно вызывать до start()
+         * \param use_parser_thread Использовать поток разбора
+         * \param ring_capacity Размер очереди сообщений, округляется вверх до степени двойки
+         */
+        void set_parser_thread(const bool use_parser_thread, const size_t ring_capacity = 4096) {
+            is_parser_thread = use_parser_thread;
+            frame_ring_capacity = std::max((size_t)1, ring_capacity);
+        }
+
+        /** \brief Статистика приема сообщений
+         */
+        class PipelineStats {
+        public:
+            uint64_t frames = 0;        /**< Получено сообщений */
+            uint64_t dropped = 0;       /**< Отброшено сообщений из-за переполнения очереди */
+            size_t queue = 0;           /**< Сообщений в очереди */
+            size_t max_queue = 0;       /**< Наибольшая занятость очереди */
+            size_t capacity = 0;        /**< Размер очереди, 0 - сообщения разбираются в io-потоке */
+
+            PipelineStats() {};
+        };
+
+        /** \brief Получить статистику приема сообщений
+         * \return Статистика приема сообщений
+         */
+        PipelineStats get_pipeline_stats() {
+            PipelineStats stats;
+            stats.frames = pipeline_frames;
+            stats.dropped = pipeline_dropped;
+            stats.max_queue = pipeline_max_queue;
+            if(frame_ring) {
+                stats.queue = frame_ring->size();
+                stats.capacity = frame_ring->capacity();
+            }
+            return stats;
+        }
+
         void start() {
             if(client_future.valid()) return;
+            if(is_parser_thread) {
+                common::ThreadConfig config;
+                {
+                    std::lock_guard<std::mutex> lock(thread_config_mutex);
+                    config = thread_config;
+                }
+                frame_ring = std::unique_ptr<SpscRing<ReceivedFrame>>(new SpscRing<ReceivedFrame>(frame_ring_capacity));
+                parser_thread = std::thread(&BinomoApiPriceStream::run_parser_thread, this, config);
+            }
+            /* изменения подписок отправляются пакетами в отдельном потоке */
+            subscription_future = std::async(std::launch::async, [&]() {
+                run_subscriptions();
+            });
             /* запустим соединение в отдельном потоке */
             client_future = std::async(std::launch::async,[&]() {
                 while(!is_close_connection) {
@@ -786,8 +1510,7 @@ namespace binomo_api {
                         client->on_message =
                                 [&](std::shared_ptr<WssClient::Connection> connection,
                                 std::shared_ptr<WssClient::InMessage> message) {
-                            parser(message->string());
-                            //std::cout << "on_message " << message->string() << std::endl;
+                            receive_frame(message);
                         };
 
                         client->on_open =
@@ -801,16 +1524,8 @@ namespace binomo_api {
                             /* вызываем функцию обратного вызова */
                             if(on_start != nullptr) on_start();
 
-                            /* подписываемся на поток котировок */
-                            std::list<std::string> list_symbol;
-                            {
-                                std::lock_guard<std::mutex> lock(list_subscriptions_mutex);
-                                if(list_subscriptions.size() == 0) return;
-                                for(auto &item_symbol : list_subscriptions) {
-                                    list_symbol.push_back(item_symbol.first);
-                                }
-                            }
-                            subscribe_symbols(std::vector<std::string>(list_symbol.begin(), list_symbol.end()));
+                            /* подписываемся на поток котировок: поток отправки сразу передаст весь желаемый набор */
+                            reset_subscriptions();
                             std::cout << "binomo api: wss start" << std::endl;
                         };
 
@@ -829,6 +1544,7 @@ namespace binomo_api {
                                 << point
                                 << " closed connection with status code " << status
                                 << std::endl;
+                            reset_subscriptions();
                         };
 
                         // See http://www.boost.org/doc/libs/1_55_0/doc/html/boost_asio/reference.html, Error Codes for error code meanings
@@ -849,8 +1565,19 @@ namespace binomo_api {
                                 << point
                                 << " wss error: " << ec
                                 << std::endl;
+                            reset_subscriptions();
                         };
+                        /* io_service создаем сами, чтобы запустить его в нужном количестве потоков */
+                        common::ThreadConfig config;
+                        {
+                            std::lock_guard<std::mutex> lock(thread_config_mutex);
+                            config = thread_config;
+                        }
+                        std::shared_ptr<SimpleWeb::asio::io_service> io_service =
+                            std::make_shared<SimpleWeb::asio::io_service>();
+                        client->io_service = io_service;
                         client->start();
+                        common::run_io_service(io_service, config, "wss");
                         client.reset();
                     } catch (std::exception& e) {
                         is_websocket_init = false;
@@ -33,6 +33,7 @@
 #include <mutex>
 #include <atomic>
 #include <future>
+#include <algorithm>
 //#include <cstdlib>
 
 namespace binomo_api {
@@ -91,6 +92,26 @@ namespace binomo_api {
         std::shared_ptr<WsServer::Connection> current_connection;               /**< Текущее соединение */
 		std::mutex current_connection_mutex;
 
+        common::ThreadConfig thread_config;                                     /**< Настройки потоков */
+        std::mutex thread_config_mutex;
+
+        /** \brief Получить настройки потоков
+         * \return Копия настроек потоков
+         */
+        common::ThreadConfig get_thread_config() {
+            std::lock_guard<std::mutex> lock(thread_config_mutex);
+            return thread_config;
+        }
+
+        /** \brief Остановить WS-сервер и его io_service
+         */
+        void stop_server() {
+            std::lock_guard<std::mutex> lock(server_mutex);
+            if(!server) return;
+            server->stop();
+            if(server->io_service) server->io_service->stop();
+        }
+
 		std::atomic<uint64_t> ref_counter = ATOMIC_VAR_INIT(5);                 /**< Счетчик запросов. Начинается с 5 и увеличивается с каждым запросом */
 
 		//std::atomic<bool> is_command_server_stop = ATOMIC_VAR_INIT(false);      /**< Команда на остановку сервера */
@@ -99,10 +120,31 @@ namespace binomo_api {
 		std::atomic<bool> is_connected = ATOMIC_VAR_INIT(false);                /**< Флаг установленного соединения */
         std::atomic<bool> is_open_connect = ATOMIC_VAR_INIT(false);             /**<  */
         std::atomic<bool> is_error = ATOMIC_VAR_INIT(false);                    /**<  */
+        std::atomic<bool> is_bridge_batch = ATOMIC_VAR_INIT(false);             /**< Флаг объединения сообщений брокера в один кадр на стороне расширения */
 
         std::atomic<double> bets_last_timestamp = ATOMIC_VAR_INIT(0.0d);	    /**< Последняя метка времени открытия сделки */
         std::atomic<double> bets_delay = ATOMIC_VAR_INIT(1.5d);         	    /**< Задержка между открытием сделок */
 
+        /* параметры повторных попыток открыть сделку */
+        std::atomic<uint32_t> bet_attempts = ATOMIC_VAR_INIT(3);               /**< Максимальное количество попыток открыть сделку */
+        std::atomic<uint32_t> bet_attempts_delay_ms = ATOMIC_VAR_INIT(0);      /**< Задержка между попытками открыть сделку, в мс */
+        std::atomic<double> bet_attempts_deadline = ATOMIC_VAR_INIT(5.0d);     /**< Время от первой попытки, после которого сделку не повторяем, в секундах */
+        std::atomic<uint64_t> join_replies = ATOMIC_VAR_INIT(0);               /**< Количество подтверждений phx_join канала base */
+
+        /* параметры контроля связи с брокером */
+        std::atomic<uint32_t> heartbeat_period_ms = ATOMIC_VAR_INIT(2000);      /**< Период отправки пингов, в мс */
+        std::atomic<double> link_degraded_timeout = ATOMIC_VAR_INIT(3.0d);      /**< Время ожидания ответа на пинг, после которого связь считается плохой, в секундах */
+        std::atomic<double> link_dead_timeout = ATOMIC_VAR_INIT(6.0d);          /**< Время ожидания ответа на пинг, после которого соединение считается потерянным, в секундах */
+        std::atomic<double> link_hold_timeout = ATOMIC_VAR_INIT(0.0d);          /**< Время удержания сделки при плохой связи, в секундах */
+        std::atomic<common::LinkState> link_state = ATOMIC_VAR_INIT(common::LinkState::DISCONNECTED);
+
+        std::map<uint64_t, xtime::ftimestamp_t> link_pings;                     /**< Пинги без ответа: номер запроса - метка времени отправки */
+        std::array<double, 256> link_rtt;                                       /**< Выборка времени ответа на пинг */
+        uint32_t link_rtt_index = 0;
+        uint32_t link_rtt_count = 0;
+        common::LinkStats link_stats;
+        std::mutex link_mutex;
+
         /* все для расчета смещения времени */
         std::atomic<double> last_timestamp = ATOMIC_VAR_INIT(0.0);
         const uint32_t array_offset_timestamp_size = 256;
@@ -154,6 +196,71 @@ namespace binomo_api {
         std::map<uint64_t, common::Bet> array_bets;
 		std::mutex array_bets_mutex;
 
+        using bets_snapshot_t = std::shared_ptr<const std::vector<common::Bet>>;
+
+        bets_snapshot_t open_bets_snapshot = std::make_shared<const std::vector<common::Bet>>();     /**< Снимок открытых сделок, публикуется при каждом изменении array_bets */
+        bets_snapshot_t closed_bets_snapshot = std::make_shared<const std::vector<common::Bet>>();   /**< Снимок закрытых сделок, от старых к новым. nullptr - снимок устарел */
+
+        const size_t closed_bets_capacity = 1024;                               /**< Размер кольцевого буфера закрытых сделок */
+        std::vector<common::Bet> closed_bets;                                   /**< Кольцевой буфер закрытых сделок */
+        size_t closed_bets_index = 0;                                           /**< Индекс следующей записи в кольцевом буфере */
+        std::mutex closed_bets_mutex;
+
+        /** \brief Опубликовать снимок открытых сделок
+         *
+         * Метод вызывается под array_bets_mutex после каждого изменения array_bets.
+         * Читатели получают снимок через std::atomic_load и не блокируют обработку сделок
+         */
+        void publish_open_bets() {
+            auto bets = std::make_shared<std::vector<common::Bet>>();
+            bets->reserve(array_bets.size());
+            for(auto &item : array_bets) {
+                bets->push_back(item.second);
+            }
+            std::atomic_store(&open_bets_snapshot, bets_snapshot_t(std::move(bets)));
+        }
+
+        /** \brief Добавить сделку в кольцевой буфер закрытых сделок
+         * \param bet Закрытая сделка
+         */
+        void push_closed_bet(const common::Bet &bet) {
+            std::lock_guard<std::mutex> lock(closed_bets_mutex);
+            if(closed_bets.size() < closed_bets_capacity) {
+                closed_bets.push_back(bet);
+            } else {
+                closed_bets[closed_bets_index] = bet;
+            }
+            closed_bets_index = (closed_bets_index + 1) % closed_bets_capacity;
+
+            /* снимок строит первый читатель, поэтому закрытие сделки не копирует весь буфер */
+            std::atomic_store(&closed_bets_snapshot, bets_snapshot_t());
+        }
+
+        /** \brief Получить снимок закрытых сделок
+         *
+         * Пока сделки не закрываются, читатели получают готовый снимок без блокировки
+         * \return Снимок закрытых сделок, упорядоченный от старых к новым
+         */
+        bets_snapshot_t get_closed_bets_snapshot() {
+            bets_snapshot_t snapshot = std::atomic_load(&closed_bets_snapshot);
+            if(snapshot) return snapshot;
+
+            std::lock_guard<std::mutex> lock(closed_bets_mutex);
+            snapshot = std::atomic_load(&closed_bets_snapshot);
+            if(snapshot) return snapshot;
+            auto bets = std::make_shared<std::vector<common::Bet>>();
+            bets->reserve(closed_bets.size());
+            if(closed_bets.size() < closed_bets_capacity) {
+                bets->assign(closed_bets.begin(), closed_bets.end());
+            } else {
+                bets->assign(closed_bets.begin() + closed_bets_index, closed_bets.end());
+                bets->insert(bets->end(), closed_bets.begin(), closed_bets.begin() + closed_bets_index);
+            }
+            snapshot = bets_snapshot_t(std::move(bets));
+            std::atomic_store(&closed_bets_snapshot, snapshot);
+            return snapshot;
+        }
+
         uint64_t bets_id_counter = 0;                                           /**< Счетчик номера сделок, открытых через API */
 		std::mutex bets_id_counter_mutex;
 
@@ -187,6 +294,345 @@ namespace binomo_api {
             });
         }
 
+        /** \brief Отправить запрос на подключение к каналу base
+         */
+        void send_phx_join() {
+            // {"topic":"base","event":"phx_join","payload":{},"ref":"5","join_ref":"5"}
+            json j;
+            j["topic"] = "base";
+            j["event"] = "phx_join";
+            j["payload"] = json::object();
+            j["ref"] = join_ref;
+            j["join_ref"] = join_ref;
+            send(j.dump());
+        }
+
+        /** \brief Отправить расширению список событий брокера, которые нужно пересылать
+         *
+         * Остальные сообщения брокера (например, majority_opinion) расширение отбрасывает,
+         * чтобы не тратить время на их разбор
+         */
+        void send_bridge_filter() {
+            // {"topic":"bridge","event":"filter","payload":{"events":["phx_reply","deal_created","close_deal_batch","change_balance"],"batch":false}}
+            json j;
+            j["topic"] = "bridge";
+            j["event"] = "filter";
+            j["payload"]["events"] = json::array({
+                "phx_reply",
+                "deal_created",
+                "close_deal_batch",
+                "change_balance"});
+            j["payload"]["batch"] = (bool)is_bridge_batch;
+            send(j.dump());
+        }
+
+        /** \brief Подождать восстановления связи с брокером
+         * \param stop_timestamp Метка времени, после которой ждать не нужно
+         * \return Вернет true, если брокер отвечает на пинги
+         */
+        bool wait_link(const xtime::ftimestamp_t stop_timestamp) {
+            while(true) {
+                const common::LinkState state = link_state;
+                if(state == common::LinkState::OK) return true;
+                if(state != common::LinkState::DEGRADED) return false;
+                if(is_shutdown || xtime::get_ftimestamp() >= stop_timestamp) return false;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+
+        /** \brief Сбросить состояние связи с брокером
+         * \param state Новое состояние связи
+         */
+        void reset_link(const common::LinkState state) {
+            std::lock_guard<std::mutex> lock(link_mutex);
+            link_pings.clear();
+            link_stats.last_reply_timestamp = xtime::get_ftimestamp();
+            link_state = state;
+        }
+
+        /** \brief Отправить пинги брокеру
+         *
+         * Отправляет heartbeat канала phoenix и ping канала base,
+         * время отправки запоминается для расчета времени ответа
+         */
+        void send_link_pings() {
+            // {"topic":"phoenix","event":"heartbeat","payload":{},"ref":"275"}
+            // {"topic":"base","event":"ping","payload":{},"ref":"276","join_ref":"5"}
+            const uint64_t heartbeat_ref = ref_counter++;
+            const uint64_t ping_ref = ref_counter++;
+            {
+                std::lock_guard<std::mutex> lock(link_mutex);
+                const xtime::ftimestamp_t timestamp = xtime::get_ftimestamp();
+                link_pings[heartbeat_ref] = timestamp;
+                link_pings[ping_ref] = timestamp;
+                link_stats.pings += 2;
+            }
+            json j_heartbeat;
+            j_heartbeat["topic"] = "phoenix";
+            j_heartbeat["event"] = "heartbeat";
+            j_heartbeat["payload"] = json::object();
+            j_heartbeat["ref"] = heartbeat_ref;
+            send(j_heartbeat.dump());
+
+            json j_ping;
+            j_ping["topic"] = "base";
+            j_ping["event"] = "ping";
+            j_ping["payload"] = json::object();
+            j_ping["ref"] = ping_ref;
+            j_ping["join_ref"] = join_ref;
+            send(j_ping.dump());
+        }
+
+        /** \brief Обновить состояние связи с брокером
+         *
+         * Состояние определяется по времени с последнего ответа на пинг, поэтому
+         * без ответов оно только ухудшается: из DEAD связь выходит лишь после ответа на пинг.
+         * Пинги, которые ждут ответа дольше link_dead_timeout, считаются потерянными
+         */
+        void update_link_state() {
+            if(link_state == common::LinkState::DISCONNECTED) return;
+            const xtime::ftimestamp_t timestamp = xtime::get_ftimestamp();
+            common::LinkState state = common::LinkState::OK;
+            {
+                std::lock_guard<std::mutex> lock(link_mutex);
+                const double delay = timestamp - link_stats.last_reply_timestamp;
+                if(delay >= link_dead_timeout) state = common::LinkState::DEAD;
+                else if(delay >= link_degraded_timeout) state = common::LinkState::DEGRADED;
+
+                /* номера запросов растут, поэтому первый элемент - самый старый пинг */
+                auto it_ping = link_pings.begin();
+                while(it_ping != link_pings.end()) {
+                    if((timestamp - it_ping->second) < link_dead_timeout) break;
+                    it_ping = link_pings.erase(it_ping);
+                    ++link_stats.missed;
+                }
+                /* под link_mutex, чтобы не затереть восстановление связи из parse_link_reply */
+                set_link_state(state);
+            }
+        }
+
+        /** \brief Установить состояние связи с брокером
+         * \param state Новое состояние связи
+         */
+        void set_link_state(const common::LinkState state) {
+            const common::LinkState last_state = link_state.exchange(state);
+            if(last_state == state) return;
+            if(state == common::LinkState::DEAD) {
+                is_connected = false;
+                std::cerr << "binomo api: no reply to ping, connection with the broker is lost" << std::endl;
+            } else
+            if(state == common::LinkState::DEGRADED) {
+                std::cerr << "binomo api: reply to ping is delayed" << std::endl;
+            } else
+            if(last_state == common::LinkState::DEAD) {
+                std::cerr << "binomo api: connection with the broker is restored" << std::endl;
+            }
+        }
+
+        /** \brief Получить номер запроса из сообщения
+         * \param j_ref Поле ref сообщения, число или строка
+         * \param ref Номер запроса
+         * \return Вернет false, если номера запроса нет
+         */
+        static bool get_message_ref(const json &j_ref, uint64_t &ref) {
+            if(j_ref.is_number()) ref = j_ref;
+            else if(j_ref.is_string()) ref = std::stoull(j_ref.get<std::string>());
+            else return false;
+            return true;
+        }
+
+        /** \brief Обработать ответ на пинг
+         * \param j Сообщение
+         * \return Вернет true, если сообщение было ответом на пинг
+         */
+        bool parse_link_reply(json &j) {
+            // {"event":"phx_reply","payload":{"response":{},"status":"ok"},"ref":"275","topic":"phoenix"}
+            // {"event":"phx_reply","payload":{"response":{"now":"2020-10-12T14:48:55.932967Z"},"status":"ok"},"ref":"276","topic":"base"}
+            try {
+                if (j["event"] == "phx_reply" && (j["topic"] == "phoenix" || j["topic"] == "base")) {
+                    uint64_t ref = 0;
+                    if(!get_message_ref(j["ref"], ref)) return false;
+
+                    const xtime::ftimestamp_t timestamp = xtime::get_ftimestamp();
+                    std::lock_guard<std::mutex> lock(link_mutex);
+                    auto it_ping = link_pings.find(ref);
+                    if(it_ping == link_pings.end()) return false;
+                    const double rtt = timestamp - it_ping->second;
+                    link_pings.erase(it_ping);
+
+                    link_rtt[link_rtt_index] = rtt;
+                    link_rtt_index = (link_rtt_index + 1) % link_rtt.size();
+                    if(link_rtt_count < link_rtt.size()) ++link_rtt_count;
+
+                    link_stats.last_rtt = rtt;
+                    link_stats.last_reply_timestamp = timestamp;
+                    ++link_stats.replies;
+                    /* связь восстановлена сразу, чтобы это сообщение уже вернуло is_connected */
+                    if(link_state == common::LinkState::DEAD) set_link_state(common::LinkState::OK);
+                    return true;
+                }
+            }
+            catch(...) {}
+            return false;
+        }
+
+        /** \brief Проверить, является ли ошибка брокера временной
+         *
+         * Брокер отклоняет сделку с кодом rate_limit, если сделки открываются слишком часто.
+         * Ограничение частоты проходит само, поэтому сделку можно повторить без изменений:
+         * {"reasons":[{"field":"amount","validation":"rate_limit"}]}
+         * \param reason Код причины или проверки
+         * \return Вернет true, если ошибка временная
+         */
+        static bool check_temporary_reason(const std::string &reason) {
+            return reason == "rate_limit";
+        }
+
+        /** \brief Определить причину отклонения сделки
+         * \param j_response Поле response ответа phx_reply
+         * \return Причина отклонения сделки
+         */
+        common::BetRejectType get_bet_reject_type(json &j_response) {
+            // {"reason":"unmatchedtopic"}
+            // {"reasons":[{"field":"expire_at","validation":"asset_unavailable_at_expire_time"}]}
+            // {"reasons":[{"field":"amount","validation":"rate_limit"}]}
+            try {
+                if(j_response.find("reason") != j_response.end() && j_response["reason"].is_string()) {
+                    const std::string reason = j_response["reason"];
+                    if(reason == "unmatchedtopic") return common::BetRejectType::UNMATCHED_TOPIC;
+                    if(check_temporary_reason(reason)) return common::BetRejectType::TEMPORARY;
+                    return common::BetRejectType::FATAL;
+                }
+                if(j_response.find("reasons") == j_response.end() || !j_response["reasons"].is_array()) {
+                    return common::BetRejectType::FATAL;
+                }
+                json j_reasons = j_response["reasons"];
+                if(j_reasons.size() == 0) return common::BetRejectType::FATAL;
+                /* ошибка времени требует пересчета экспирации, поэтому важнее временной ошибки */
+                common::BetRejectType reject_type = common::BetRejectType::TEMPORARY;
+                for(size_t i = 0; i < j_reasons.size(); ++i) {
+                    std::string field;
+                    std::string validation;
+                    if(j_reasons[i]["field"].is_string()) field = j_reasons[i]["field"];
+                    if(j_reasons[i]["validation"].is_string()) validation = j_reasons[i]["validation"];
+                    if (field == "expire_at" ||
+                        field == "created_at" ||
+                        validation.find("expire") != std::string::npos) {
+                        reject_type = common::BetRejectType::EXPIRATION_TIME;
+                    } else
+                    if(!check_temporary_reason(validation)) {
+                        /* любая другая ошибка делает повтор бессмысленным */
+                        return common::BetRejectType::FATAL;
+                    }
+                }
+                return reject_type;
+            }
+            catch(...) {}
+            return common::BetRejectType::FATAL;
+        }
+
+        /** \brief Ждать подтверждение phx_join канала base
+         * \param last_join_replies Количество подтверждений до отправки phx_join
+         * \param stop_timestamp Метка времени сервера, после которой ждать не имеет смысла
+         * \return Вернет true, если брокер подтвердил подключение к каналу
+         */
+        bool wait_join(const uint64_t last_join_replies, const xtime::ftimestamp_t stop_timestamp) {
+            while(join_replies == last_join_replies) {
+                if(is_shutdown || get_server_timestamp() > stop_timestamp) return false;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            return true;
+        }
+
+        /** \brief Повторить отклоненную сделку
+         *
+         * Метод проверяет причину отклонения сделки и, если повтор имеет смысл,
+         * пересчитывает экспирацию и отправляет сделку повторно,
+         * не дожидаясь задержки между открытием сделок
+         * \param j_deal Запрос на открытие сделки, будет обновлен
+         * \param deal_ref Номер запроса, будет обновлен
+         * \param bet Сделка, будет обновлена
+         * \param expiration Экспирация опциона в минутах или 0, если была задана дата экспирации
+         * \param stop_timestamp Метка времени, после которой сделку не повторяем
+         * \return Вернет true, если сделка отправлена повторно
+         */
+        bool repeat_bet(
+                json &j_deal,
+                uint64_t &deal_ref,
+                common::Bet &bet,
+                const uint32_t expiration,
+                const xtime::ftimestamp_t stop_timestamp) {
+            if(bet.attempts >= bet_attempts) return false;
+            switch(bet.reject_type) {
+            case common::BetRejectType::EXPIRATION_TIME:
+                if(expiration == 0) return false;
+                break;
+            case common::BetRejectType::UNMATCHED_TOPIC: {
+                    /* повтор до подключения к каналу снова получит unmatchedtopic */
+                    const uint64_t last_join_replies = join_replies;
+                    send_phx_join();
+                    if(!wait_join(last_join_replies, stop_timestamp)) return false;
+                }
+                break;
+            case common::BetRejectType::TEMPORARY:
+                break;
+            default:
+                return false;
+            };
+
+            /* ждем перед повторной попыткой, если успеваем */
+            const xtime::ftimestamp_t delay = (xtime::ftimestamp_t)bet_attempts_delay_ms / 1000.0d;
+            if((get_server_timestamp() + delay) > stop_timestamp) return false;
+            const xtime::ftimestamp_t repeat_timestamp = xtime::get_ftimestamp() + delay;
+            while(xtime::get_ftimestamp() < repeat_timestamp) {
+                if(is_shutdown) return false;
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+
+            /* повтор при плохой связи, как и первая отправка, ждет ее восстановления */
+            const xtime::ftimestamp_t link_stop_timestamp = xtime::get_ftimestamp() + (stop_timestamp - get_server_timestamp());
+            if(!wait_link(link_stop_timestamp)) return false;
+
+            const xtime::ftimestamp_t timestamp = get_server_timestamp();
+            xtime::timestamp_t expire_at_timestamp = j_deal["payload"]["expire_at"];
+            if(bet.reject_type == common::BetRejectType::EXPIRATION_TIME) {
+                expire_at_timestamp = get_classic_bo_closing_timestamp(timestamp, expiration);
+                if(expire_at_timestamp == 0) return false;
+            }
+
+            const uint64_t current_ref = ref_counter++;
+            j_deal["payload"]["expire_at"] = expire_at_timestamp;
+            j_deal["payload"]["created_at"] = (uint64_t)(timestamp * 1000.0d);
+            j_deal["ref"] = current_ref;
+
+            bet.bet_status = common::BetStatus::UNKNOWN_STATE;
+            bet.send_timestamp = timestamp;
+            bet.opening_timestamp = timestamp;
+            bet.closing_timestamp = expire_at_timestamp;
+            ++bet.attempts;
+
+            {
+                std::lock_guard<std::mutex> lock(array_bets_mutex);
+                auto it_array_bets = array_bets.find(bet.api_bet_id);
+                if(it_array_bets == array_bets.end()) return false;
+                it_array_bets->second = bet;
+                publish_open_bets();
+            }
+
+            /* переносим соотношение запрос - номер сделки на новый запрос */
+            {
+                std::lock_guard<std::mutex> lock(ref_to_bet_id_mutex);
+                auto it_ref_to_bet_id = ref_to_bet_id.find(deal_ref);
+                if(it_ref_to_bet_id != ref_to_bet_id.end()) ref_to_bet_id.erase(it_ref_to_bet_id);
+                ref_to_bet_id[current_ref] = bet.api_bet_id;
+            }
+            deal_ref = current_ref;
+
+            bets_last_timestamp = xtime::get_ftimestamp();
+            send(j_deal.dump());
+            return true;
+        }
+
         /** \brief Открыть сделку в асинхронном режиме
          * \param symbol_name Имя символа
          * \param note Заметка пользователя для ставки
@@ -195,6 +641,7 @@ namespace binomo_api {
          * \param contract_type Направление ставки
          * \param timestamp Метка времени открытия
          * \param expire_at_timestamp Экспирация опциона
+         * \param expiration Экспирация опциона в минутах, нужна для пересчета экспирации при повторе сделки. 0, если задана дата экспирации
          * \param api_bet_id API BET ID сделки
          * \param callback Функция обратного вызова
          * \return Код ошибки
@@ -207,8 +654,10 @@ namespace binomo_api {
                 const int contract_type,
                 const double timestamp,
                 const xtime::timestamp_t expire_at_timestamp,
+                const uint32_t expiration,
                 uint64_t &api_bet_id,
                 std::function<void(const common::Bet &bet)> callback = nullptr) {
+            if(link_state == common::LinkState::DEAD) return common::CONNECTION_LOST;
             if(!is_connected) return common::AUTHORIZATION_ERROR;
 
             if (contract_type != common::ContractType::BUY &&
@@ -290,6 +739,7 @@ namespace binomo_api {
             }
 
             user_bet.symbol_name = symbol;
+            user_bet.symbol_id = common::get_symbol_id(symbol);
             user_bet.note = note;
             user_bet.contract_type = contract_type;
             //user_bet.duration = duration;
@@ -299,13 +749,28 @@ namespace binomo_api {
             user_bet.is_demo = is_demo;
             user_bet.bet_status = common::BetStatus::UNKNOWN_STATE;
 
+            const common::ThreadConfig config = get_thread_config();
+
             /* запускаем асинхронное открытие сделки */
             {
                 std::lock_guard<std::mutex> lock(request_future_mutex);
                 request_future.resize(request_future.size() + 1);
                 request_future.back() = std::async(std::launch::async,
                         [&, j, user_bet, current_ref, api_bet_id,
-                         expire_at_timestamp, callback] {
+                         expire_at_timestamp, expiration, callback, config] {
+                    common::apply_thread_config(
+                        config.callback_cores, api_bet_id,
+                        config.name.empty() ? std::string() : config.name + "-bet");
+                    json j_deal = j;
+                    uint64_t deal_ref = current_ref;
+
+                    /* при плохой связи придерживаем сделку, пока брокер не ответит на пинг */
+                    if(!wait_link(xtime::get_ftimestamp() + link_hold_timeout)) {
+                        common::Bet bet = user_bet;
+                        bet.bet_status = common::BetStatus::OPENING_ERROR;
+                        if(callback != nullptr) callback(bet);
+                        return;
+                    }
 
                     /* проверяем, не надо ли подождать перед открытием сделки */
                     if(bets_last_timestamp > 0) {
@@ -319,12 +784,17 @@ namespace binomo_api {
 
                     /* время открытия сделки */
                     bet.send_timestamp = get_server_timestamp();
+                    bet.attempts = 1;
                     bets_last_timestamp = xtime::get_ftimestamp();
 
+                    /* после этого времени отклоненную сделку уже не повторяем */
+                    const xtime::ftimestamp_t attempts_stop_timestamp = bet.send_timestamp + bet_attempts_deadline;
+
                     /* запоминаем сделку */
                     {
                         std::lock_guard<std::mutex> lock(array_bets_mutex);
                         array_bets[api_bet_id] = bet;
+                        publish_open_bets();
                     }
 
                     /* запоминаем соотношение запрос - номер сделки */
@@ -355,7 +825,8 @@ namespace binomo_api {
                                 if(it_array_bets->second.bet_status == last_bet_status) continue;
                                 last_bet_status = it_array_bets->second.bet_status;
 
-                                const uint64_t stop_timestamp = user_bet.closing_timestamp + xtime::SECONDS_IN_MINUTE;
+                                /* экспирация могла измениться при повторе сделки */
+                                const uint64_t stop_timestamp = it_array_bets->second.closing_timestamp + xtime::SECONDS_IN_MINUTE;
                                 const uint64_t server_timestamp = get_server_timestamp();
                                 if(server_timestamp > stop_timestamp) {
                                     bet.bet_status = common::BetStatus::CHECK_ERROR;
@@ -365,6 +836,14 @@ namespace binomo_api {
                             }
                         }
 
+                        /* брокер отклонил сделку, пробуем отправить ее повторно */
+                        if (bet.bet_status == common::BetStatus::OPENING_ERROR &&
+                            repeat_bet(j_deal, deal_ref, bet, expiration, attempts_stop_timestamp)) {
+                            last_bet_status = common::BetStatus::UNKNOWN_STATE;
+                            if(callback != nullptr) callback(bet);
+                            continue;
+                        }
+
                         if(callback != nullptr) callback(bet);
 
                         if (bet.bet_status != common::BetStatus::WAITING_COMPLETION &&
@@ -380,7 +859,7 @@ namespace binomo_api {
                             /* удаляем соотношение номер запроса - номер сделки */
                             {
                                 std::lock_guard<std::mutex> lock(ref_to_bet_id_mutex);
-                                auto it_ref_to_bet_id = ref_to_bet_id.find(current_ref);
+                                auto it_ref_to_bet_id = ref_to_bet_id.find(deal_ref);
                                 if(it_ref_to_bet_id != ref_to_bet_id.end()) ref_to_bet_id.erase(it_ref_to_bet_id);
                             }
 
@@ -389,7 +868,9 @@ namespace binomo_api {
                                 std::lock_guard<std::mutex> lock(array_bets_mutex);
                                 auto it_api_bet_id = array_bets.find(api_bet_id);
                                 if(it_api_bet_id != array_bets.end()) array_bets.erase(api_bet_id);
+                                publish_open_bets();
                             }
+                            push_closed_bet(bet);
                             break;
                         }
                     };
@@ -399,6 +880,35 @@ namespace binomo_api {
             return common::OK;
         };
 
+        /** \brief Открыть сделку в асинхронном режиме
+         *
+         * Экспирация задана датой, поэтому при повторе сделки она не пересчитывается
+         * \param symbol_name Имя символа
+         * \param note Заметка пользователя для ставки
+         * \param amount Размер ставки
+         * \param is_demo Флаг демо аккаунта
+         * \param contract_type Направление ставки
+         * \param timestamp Метка времени открытия
+         * \param expire_at_timestamp Экспирация опциона
+         * \param api_bet_id API BET ID сделки
+         * \param callback Функция обратного вызова
+         * \return Код ошибки
+         */
+        inline int async_open_bo(
+                const std::string &symbol_name,
+                const std::string &note,
+                const double amount,
+                const bool is_demo,
+                const int contract_type,
+                const double timestamp,
+                const xtime::timestamp_t expire_at_timestamp,
+                uint64_t &api_bet_id,
+                std::function<void(const common::Bet &bet)> callback = nullptr) {
+            return async_open_bo(
+                symbol_name, note, amount, is_demo, contract_type,
+                timestamp, expire_at_timestamp, 0, api_bet_id, callback);
+        }
+
         bool parse_change_balance(json &j) {
             // {"event":"change_balance","payload":{"balance":0,"balance_version":0,"bonus":null,"demo_balance":99809,"demo_balance_version":64,"trading_accounts":[{"balance":0,"balance_version":0,"type":"real"},{"balance":99809,"balance_version":64,"type":"demo"}]},"ref":null,"topic":"base"}
             try {
@@ -430,11 +940,17 @@ namespace binomo_api {
             try {
                 if (j["event"] == "phx_reply" && j["topic"] == "base") {
                     json j_payload = j["payload"];
-                    const uint32_t ref_id = j["ref"];
+                    uint64_t ref_id = 0;
+                    if(!get_message_ref(j["ref"], ref_id)) return true;
+                    if(ref_id == join_ref) {
+                        /* ответ на phx_join */
+                        if(j_payload["status"] == "ok") ++join_replies;
+                        return true;
+                    }
                     uint32_t api_bet_id = 0;
                     {
                         std::lock_guard<std::mutex> lock(ref_to_bet_id_mutex);
-                        auto it_ref = ref_to_bet_id.find(ref_id);
+                        auto it_ref = ref_to_bet_id.find((uint32_t)ref_id);
                         if(it_ref == ref_to_bet_id.end()) return true;
                         api_bet_id = it_ref->second;
                     }
@@ -445,12 +961,15 @@ namespace binomo_api {
                         uuid_to_bet_id[uuid] = api_bet_id;
                     } else {
                         /* находим сделку и помечаем ее как с ошибкой */
+                        const common::BetRejectType reject_type = get_bet_reject_type(j_payload["response"]);
                         std::lock_guard<std::mutex> lock(array_bets_mutex);
                         auto it_array_bets = array_bets.find(api_bet_id);
                         if(it_array_bets == array_bets.end()) {
                            return true;
                         } else {
+                            it_array_bets->second.reject_type = reject_type;
                             it_array_bets->second.bet_status = common::BetStatus::OPENING_ERROR;
+                            publish_open_bets();
                         }
                     }
                     return true;
@@ -525,18 +1044,21 @@ namespace binomo_api {
                             xtime::DateTime requested_date_time;
                             if(!xtime::convert_iso(created_at, open_date_time)) {
                                 it_array_bets->second.bet_status = common::BetStatus::CHECK_ERROR;
+                                publish_open_bets();
                                 return true;
                             }
                             it_array_bets->second.opening_timestamp = open_date_time.get_ftimestamp();
                             ///
                             if(!xtime::convert_iso(close_quote_created_at, close_date_time)) {
                                 it_array_bets->second.bet_status = common::BetStatus::CHECK_ERROR;
+                                publish_open_bets();
                                 return true;
                             }
                             it_array_bets->second.closing_timestamp = close_date_time.get_ftimestamp();
                             ///
                             if(!xtime::convert_iso(requested_at, requested_date_time)) {
                                 it_array_bets->second.bet_status = common::BetStatus::CHECK_ERROR;
+                                publish_open_bets();
                                 return true;
                             }
                             it_array_bets->second.requested_timestamp = requested_date_time.get_ftimestamp();
@@ -546,6 +1068,7 @@ namespace binomo_api {
                             it_array_bets->second.payout = ((double)j_payload["payment_rate"]) / 100.0d;
                             it_array_bets->second.open_price = j_payload["open_rate"];
                             it_array_bets->second.bet_status = common::BetStatus::WAITING_COMPLETION;
+                            publish_open_bets();
                         }
                     }
                     return true;
@@ -568,9 +1091,8 @@ namespace binomo_api {
                     const double end_rate = j_payload["end_rate"];
                     const std::string finished_at = j_payload["finished_at"];
                     const std::string ric = j_payload["ric"];
-                    auto it_symbol = common::ric_to_normalize_name.find(ric);
-                    if(it_symbol == common::ric_to_normalize_name.end()) return true;
-                    std::string symbol_name = it_symbol->second;
+                    const common::SymbolId symbol_id = common::SymbolRegistry::get().get_id_by_ric(ric);
+                    if(symbol_id == common::INVALID_SYMBOL_ID) return true;
 
                     xtime::DateTime close_date_time;
                     if(!xtime::convert_iso(finished_at, close_date_time)) {
@@ -578,11 +1100,11 @@ namespace binomo_api {
                     }
                     xtime::ftimestamp_t closing_timestamp = close_date_time.get_ftimestamp();
 
-                    //std::cout << "close_deal_batch " << symbol_name << " end_rate " << end_rate << " closing_timestamp " << closing_timestamp << std::endl;
+                    //std::cout << "close_deal_batch " << common::get_symbol_name(symbol_id) << " end_rate " << end_rate << " closing_timestamp " << closing_timestamp << std::endl;
 
                     std::lock_guard<std::mutex> lock(array_bets_mutex);
                     for(auto &bet : array_bets) {
-                        if(bet.second.symbol_name != symbol_name) continue;
+                        if(bet.second.symbol_id != symbol_id) continue;
                         const uint64_t t1 = (uint64_t)(bet.second.closing_timestamp + 0.5d);
                         const uint64_t t2 = (uint64_t)(closing_timestamp + 0.5d);
                         if(t1 != t2) continue;
@@ -606,6 +1128,7 @@ namespace binomo_api {
                             bet.second.bet_status = common::BetStatus::CHECK_ERROR;
                         }
                     }
+                    publish_open_bets();
                     return true;
                 }
             }
@@ -623,6 +1146,7 @@ namespace binomo_api {
                     {
                         is_connected = false;
                         is_init_payout_config = false;
+                        reset_link(common::LinkState::DISCONNECTED);
                     }
 					if(j["body"]["status"] == "open") {
                         {
@@ -632,27 +1156,11 @@ namespace binomo_api {
                         }
                         // {"topic":"base","event":"phx_join","payload":{},"ref":"5","join_ref":"5"}
                         // {"topic":"base","event":"ping","payload":{},"ref":"7","join_ref":"5"}
-                        {
-                            ref_counter = join_ref;
-                            const uint64_t current_ref = ref_counter++;
-                            json j;
-                            j["topic"] = "base";
-                            j["event"] = "phx_join";
-                            j["payload"] = json::object();
-                            j["ref"] = current_ref;
-                            j["join_ref"] = join_ref;
-                            send(j.dump());
-                        }
-                        {
-                            const uint64_t current_ref = ref_counter++;
-                            json j;
-                            j["topic"] = "base";
-                            j["event"] = "ping";
-                            j["payload"] = json::object();
-                            j["ref"] = current_ref;
-                            j["join_ref"] = join_ref;
-                            send(j.dump());
-                        }
+                        send_bridge_filter();
+                        ref_counter = join_ref + 1;
+                        send_phx_join();
+                        reset_link(common::LinkState::OK);
+                        send_link_pings();
 
                         std::cerr << "binomo api: connection with the broker is open" << std::endl;
 					}
@@ -673,6 +1181,21 @@ namespace binomo_api {
             return false;
         }
 
+        /** \brief Обработать сообщение брокера или расширения
+         * \param j Сообщение
+         */
+        void process_message(json &j) {
+            while(true) {
+                if(parse_link_reply(j)) break;
+                if(parse_phx_reply(j)) break;
+                if(parse_deal_created(j)) break;
+                if(parse_close_deal_batch(j)) break;
+                if(parse_change_balance(j)) break;
+                if(parse_socket(j)) break;
+                break;
+            }
+        }
+
         void init_main_thread(const uint32_t port) {
             is_shutdown = false;
             is_cout_log = false;
@@ -694,33 +1217,35 @@ namespace binomo_api {
                             if(is_cout_log) std::cout << "binomo server: message received: \"" << out_message << "\" from " << connection.get() << std::endl;
                             try {
                                 json j = json::parse(out_message);
-                                while(true) {
-                                    if(parse_phx_reply(j)) break;
-                                    if(parse_deal_created(j)) break;
-                                    if(parse_close_deal_batch(j)) break;
-                                    if(parse_change_balance(j)) break;
-                                    if(parse_socket(j)) break;
-
-                                    /*
-                                    if(!j.is_array() && j["connection_status"] == "ok") {
-                                        is_connected = true;
-                                        is_error = false;
-                                        if(on_start != nullptr) on_start();
-                                        break;
-                                    } else
-                                    if(!j.is_array() && j["connection_status"] == "error") {
-                                        is_error = true;
-                                        is_connected = false;
-                                        break;
-                                    } else
-                                    if(!j.is_array() && j["candle-history"] == "error") {
-                                        is_error_hist_candles = true;
-                                        break;
+                                /* расширение может объединить несколько сообщений брокера в один кадр
+                                 * {"event":"batch","body":[{...},{...}]}
+                                 */
+                                if(j.is_object() && j["event"] == "batch" && j["body"].is_array()) {
+                                    for(auto &j_item : j["body"]) {
+                                        process_message(j_item);
                                     }
-                                    */
+                                } else {
+                                    process_message(j);
+                                }
+                                /*
+                                if(!j.is_array() && j["connection_status"] == "ok") {
+                                    is_connected = true;
+                                    is_error = false;
+                                    if(on_start != nullptr) on_start();
+                                    break;
+                                } else
+                                if(!j.is_array() && j["connection_status"] == "error") {
+                                    is_error = true;
+                                    is_connected = false;
+                                    break;
+                                } else
+                                if(!j.is_array() && j["candle-history"] == "error") {
+                                    is_error_hist_candles = true;
                                     break;
                                 }
-                                if (!is_connected// &&
+                                */
+                                /* при потере связи соединение восстанавливает только ответ на пинг */
+                                if (!is_connected && link_state != common::LinkState::DEAD// &&
                                     //is_init_duration_config &&
                                     //is_init_payout_config &&
                                     //is_init_symbols_config// &&
@@ -808,6 +1333,7 @@ namespace binomo_api {
                                 std::lock_guard<std::mutex> lock(current_connection_mutex);
                                 if(current_connection.get() == connection.get()) {
                                     is_connected = false;
+                                    link_state = common::LinkState::DISCONNECTED;
                                     current_connection.reset();
                                 }
                             }
@@ -824,6 +1350,7 @@ namespace binomo_api {
                                 std::lock_guard<std::mutex> lock(current_connection_mutex);
                                 if(current_connection.get() == connection.get()) {
                                     is_connected = false;
+                                    link_state = common::LinkState::DISCONNECTED;
                                     current_connection.reset();
                                 }
                             }
@@ -833,31 +1360,43 @@ namespace binomo_api {
                         };
                     }
 
+                    /* io_service создаем сами, чтобы запустить его в нужном количестве потоков */
+                    const common::ThreadConfig config = get_thread_config();
+                    std::shared_ptr<SimpleWeb::asio::io_service> io_service =
+                        std::make_shared<SimpleWeb::asio::io_service>();
+                    {
+                        std::lock_guard<std::mutex> lock(server_mutex);
+                        server->io_service = io_service;
+                    }
                     server->start([&](unsigned short port) {
                         if(is_cout_log) std::cout << "binomo api: start" << std::endl;
                     });
+                    common::run_io_service(io_service, config, "ws");
                     std::this_thread::sleep_for(std::chrono::milliseconds(1000));
                 }
             });
 
-            /* запускаем асинхронное открытие сделки */
+            /* запускаем контроль связи с брокером */
             {
                 std::lock_guard<std::mutex> lock(request_future_mutex);
                 request_future.resize(request_future.size() + 1);
                 request_future.back() = std::async(std::launch::async,
                         [&] {
+                    const common::ThreadConfig config = get_thread_config();
+                    common::apply_thread_config(
+                        config.callback_cores, 0,
+                        config.name.empty() ? std::string() : config.name + "-link");
+                    const uint32_t DELAY = 50;
+                    xtime::ftimestamp_t last_ping_timestamp = 0;
                     while(!is_shutdown) {
-                        if(is_connected) {
-                            const uint64_t current_ref = ref_counter++;
-                            json j;
-                            j["topic"] = "base";
-                            j["event"] = "ping";
-                            j["payload"] = json::object();
-                            j["ref"] = current_ref;
-                            j["join_ref"] = join_ref;
-                            send(j.dump());
+                        std::this_thread::sleep_for(std::chrono::milliseconds(DELAY));
+                        if(link_state == common::LinkState::DISCONNECTED) continue;
+                        const xtime::ftimestamp_t timestamp = xtime::get_ftimestamp();
+                        if((timestamp - last_ping_timestamp) * 1000.0d >= (double)heartbeat_period_ms) {
+                            last_ping_timestamp = timestamp;
+                            send_link_pings();
                         }
-                        std::this_thread::sleep_for(std::chrono::milliseconds(10000));
+                        update_link_state();
                     }
                 });
             }
@@ -875,10 +1414,7 @@ namespace binomo_api {
         ~BinomoApi() {
             is_shutdown = true;
             is_request_future_shutdown = true;
-            {
-                std::lock_guard<std::mutex> lock(server_mutex);
-                if(server) server->stop();
-            }
+            stop_server();
             {
                 std::lock_guard<std::mutex> lock(request_future_mutex);
                 for(size_t i = 0; i < request_future.size(); ++i) {
@@ -921,6 +1457,7 @@ namespace binomo_api {
                 std::lock_guard<std::mutex> lock(bets_id_counter_mutex);
                 std::lock_guard<std::mutex> lock2(array_bets_mutex);
                 array_bets.clear();
+                publish_open_bets();
                 //bet_id_to_uuid.clear();
                 bets_id_counter = 0;
             }
@@ -934,17 +1471,41 @@ namespace binomo_api {
          * \return Код ошибки или 0 в случае успеха
          */
         int get_bet(common::Bet &bet, const uint64_t api_bet_id) {
-            /*
-            std::lock_guard<std::mutex> lock(array_bets_mutex);
-            auto &it_bet_id_to_uuid = bet_id_to_uuid.find(api_bet_id);
-            if(it_bet_id_to_uuid == bet_id_to_uuid.end()) return DATA_NOT_AVAILABLE;
-            std::string uuid = it_bet_id_to_uuid->second;
-            auto &it_array_bets = array_bets.find(uuid);
-            if(it_array_bets == array_bets.end()) return DATA_NOT_AVAILABLE;
-            bet = it_array_bets->second;
-            */
-            return common::OK;
+            bets_snapshot_t open_bets = std::atomic_load(&open_bets_snapshot);
+            for(auto &item : *open_bets) {
+                if(item.api_bet_id != api_bet_id) continue;
+                bet = item;
+                return common::OK;
+            }
+            bets_snapshot_t recent_bets = get_closed_bets_snapshot();
+            for(auto it = recent_bets->rbegin(); it != recent_bets->rend(); ++it) {
+                if(it->api_bet_id != api_bet_id) continue;
+                bet = *it;
+                return common::OK;
+            }
+            return common::DATA_NOT_AVAILABLE;
+        }
+
+        /** \brief Получить открытые сделки
+         *
+         * Метод не блокирует обработку сделок и может вызываться с высокой частотой.
+         * Возвращаемый снимок неизменяемый, новый снимок публикуется при каждом изменении сделок
+         * \return Снимок открытых сделок
+         */
+        inline std::shared_ptr<const std::vector<common::Bet>> get_open_bets() {
+            return std::atomic_load(&open_bets_snapshot);
+        }
 
+        /** \brief Получить последние закрытые сделки
+         *
+         * Хранится не более 1024 последних закрытых сделок
+         * \param n Количество сделок
+         * \return Снимок закрытых сделок, упорядоченный от старых к новым
+         */
+        std::shared_ptr<const std::vector<common::Bet>> get_recent_bets(const size_t n) {
+            bets_snapshot_t recent_bets = get_closed_bets_snapshot();
+            if(n >= recent_bets->size()) return recent_bets;
+            return std::make_shared<const std::vector<common::Bet>>(recent_bets->end() - n, recent_bets->end());
         }
 
         /** \brief Получить ID реального аккаунта
@@ -984,6 +1545,102 @@ namespace binomo_api {
             bets_delay = delay;
         }
 
+        /** \brief Установить настройки потоков
+         *
+         * Настройки io-потоков применяются при следующем запуске WS-сервера,
+         * поэтому метод нужно вызывать до start(). Потоки сделок, которые вызывают
+         * функции обратного вызова, закрепляются за ядрами callback_cores.
+         * Сообщения брокера разбираются в io-потоках
+         * \param config Настройки потоков
+         */
+        inline void set_thread_config(const common::ThreadConfig &config) {
+            std::lock_guard<std::mutex> lock(thread_config_mutex);
+            thread_config = config;
+        }
+
+        /** \brief Включить объединение сообщений брокера в один кадр
+         *
+         * Расширение будет отправлять накопленные за кадр анимации сообщения одним кадром.
+         * Настройка применяется при следующем подключении к брокеру
+         * \param is_batch Флаг объединения сообщений
+         */
+        inline void set_bridge_batch(const bool is_batch) {
+            is_bridge_batch = is_batch;
+        }
+
+        /** \brief Установить параметры повторных попыток открыть сделку
+         *
+         * Если брокер отклонил сделку по причине, которую можно исправить
+         * (например, экспирация стала недоступна), сделка будет отправлена повторно
+         * с пересчитанной экспирацией, минуя задержку между открытием сделок
+         * \param attempts Максимальное количество попыток, 1 отключает повторы
+         * \param delay_ms Задержка между попытками, в мс
+         * \param deadline Время от первой попытки, после которого сделку не повторяем, в секундах
+         */
+        inline void set_bet_attempts(
+                const uint32_t attempts,
+                const uint32_t delay_ms,
+                const double deadline) {
+            bet_attempts = attempts;
+            bet_attempts_delay_ms = delay_ms;
+            bet_attempts_deadline = deadline;
+        }
+
+        /** \brief Установить параметры контроля связи с брокером
+         *
+         * Брокеру периодически отправляются heartbeat канала phoenix и ping канала base.
+         * Если ответа нет дольше degraded_timeout, связь считается плохой, и новые сделки
+         * удерживаются не дольше hold_timeout. Если ответа нет дольше dead_timeout,
+         * соединение считается потерянным, и новые сделки не открываются
+         * \param period_ms Период отправки пингов, в мс
+         * \param degraded_timeout Время ожидания ответа до состояния плохой связи, в секундах
+         * \param dead_timeout Время ожидания ответа до потери соединения, в секундах
+         * \param hold_timeout Время удержания сделки при плохой связи, в секундах. 0 - сделка сразу отклоняется
+         */
+        inline void set_link_monitor(
+                const uint32_t period_ms,
+                const double degraded_timeout,
+                const double dead_timeout,
+                const double hold_timeout) {
+            heartbeat_period_ms = period_ms;
+            link_degraded_timeout = degraded_timeout;
+            link_dead_timeout = dead_timeout;
+            link_hold_timeout = hold_timeout;
+        }
+
+        /** \brief Получить состояние связи с брокером
+         * \return Состояние связи
+         */
+        inline common::LinkState get_link_state() {
+            return link_state;
+        }
+
+        /** \brief Получить статистику связи с брокером
+         * \return Статистика связи, включая перцентили времени ответа на пинг
+         */
+        common::LinkStats get_link_stats() {
+            std::vector<double> rtt;
+            common::LinkStats stats;
+            {
+                std::lock_guard<std::mutex> lock(link_mutex);
+                stats = link_stats;
+                rtt.assign(link_rtt.begin(), link_rtt.begin() + link_rtt_count);
+            }
+            stats.state = link_state;
+            stats.samples = rtt.size();
+            if(rtt.empty()) return stats;
+            std::sort(rtt.begin(), rtt.end());
+            auto percentile = [&](const double p) -> double {
+                const size_t index = (size_t)(p * (double)(rtt.size() - 1) + 0.5d);
+                return rtt[index];
+            };
+            stats.rtt_p50 = percentile(0.50d);
+            stats.rtt_p90 = percentile(0.90d);
+            stats.rtt_p99 = percentile(0.99d);
+            stats.rtt_max = rtt.back();
+            return stats;
+        }
+
         /** \brief Получить метку времени сервера
          *
          * Данный метод возвращает метку времени сервера. Часовая зона: UTC/GMT
@@ -1013,8 +1670,7 @@ namespace binomo_api {
                     if(timestamp_start == 0) timestamp_start = xtime::get_timestamp();
                     if(((int64_t)xtime::get_timestamp() - (int64_t)timestamp_start) >
                         (int64_t)xtime::SECONDS_IN_MINUTE) {
-                        std::lock_guard<std::mutex> lock(server_mutex);
-                        if(server) server->stop();
+                        stop_server();
                         timestamp_start = 0;
                         std::cerr << "binomo api: eror in wait() timeout exceeded" << std::endl;
                     }
@@ -1204,6 +1860,7 @@ namespace binomo_api {
                 contract_type,
                 timestamp,
                 get_classic_bo_closing_timestamp(timestamp, duration / xtime::SECONDS_IN_MINUTE),
+                duration / xtime::SECONDS_IN_MINUTE,
                 api_bet_id,
                 callback);
         }
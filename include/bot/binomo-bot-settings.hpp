@@ -76,6 +76,8 @@ namespace binomo_bot {
         //std::string sert_file = "curl-ca-bundle.crt";       /**< Файл сертификата */
         //std::string cookie_file = "binomo.cookie";          /**< Файл cookie */
         std::string symbol_hst_suffix;                      /**< Суффикс имени символа автономных графиков */
+        std::string store_path;                             /**< Папка хранилища баров. Пустая строка - хранилище не используется */
+        std::string tick_tape_path;                         /**< Папка ленты тиков. Пустая строка - лента не записывается */
 
         std::vector<std::pair<std::string, uint32_t>> symbols;
 
@@ -83,6 +85,9 @@ namespace binomo_bot {
         uint32_t max_precisions = 6;                        /**< Максимальная точность котировок, выступает в роли ограничителя */
         int64_t timezone = 0;                               /**< Часовой пояс - смещение метки времени котировок на указанное число секунд */
         int volume_mode = 0;                                /**< Режим работы объемов (0 - отключено, 1 - подсчет тиков, 2 - взвешенный подсчет тиков) */
+        uint32_t history_requests = 8;                      /**< Количество одновременных запросов при загрузке истории */
+        uint32_t parser_queue = 4096;                       /**< Размер очереди сообщений потока разбора */
+        bool is_parser_thread = true;                       /**< Разбирать сообщения в отдельном потоке, чтобы запись графиков не задерживала чтение сокета */
 
         bool is_use = false;
 
@@ -92,9 +97,14 @@ namespace binomo_bot {
                 if(j_quotes["volume_mode"] != nullptr) volume_mode = j_quotes["volume_mode"];
                 if(j_quotes["symbol_hst_suffix"] != nullptr) symbol_hst_suffix = j_quotes["symbol_hst_suffix"];
                 if(j_quotes["candles"] != nullptr) candles = j_quotes["candles"];
+                if(j_quotes["history_requests"] != nullptr) history_requests = j_quotes["history_requests"];
                 if(j_quotes["max_precisions"] != nullptr) max_precisions = j_quotes["max_precisions"];
                 if(j_quotes["timezone"] != nullptr) timezone = j_quotes["timezone"];
                 if(j_quotes["path"] != nullptr) path = j_quotes["path"];
+                if(j_quotes["store_path"] != nullptr) store_path = j_quotes["store_path"];
+                if(j_quotes["tick_tape_path"] != nullptr) tick_tape_path = j_quotes["tick_tape_path"];
+                if(j_quotes["parser_thread"] != nullptr) is_parser_thread = j_quotes["parser_thread"];
+                if(j_quotes["parser_queue"] != nullptr) parser_queue = j_quotes["parser_queue"];
                 if(j_quotes["symbols"] != nullptr && j_quotes["symbols"].is_array()) {
                     const size_t symbols_size = j_quotes["symbols"].size();
                     for(size_t i = 0; i < symbols_size; ++i) {
@@ -135,7 +145,13 @@ namespace binomo_bot {
         //std::string sert_file = "curl-ca-bundle.crt";       /**< Файл сертификата */
         //std::string cookie_file = "binomo.cookie";          /**< Файл cookie */
         uint32_t repeated_bet_attempts_delay_ms = 1000;     /**< Задержка между попытками повторных сделок, в мс */
+        uint32_t repeated_bet_attempts = 3;                 /**< Максимальное количество попыток открыть сделку */
+        uint32_t repeated_bet_deadline_ms = 5000;           /**< Время от первой попытки, после которого сделку не повторяем, в мс */
         uint32_t delay_bets_ms = 1000;                      /**< Задержка между сделками, в мс */
+        uint32_t heartbeat_period_ms = 2000;                /**< Период отправки пингов брокеру, в мс */
+        uint32_t link_degraded_timeout_ms = 3000;           /**< Время ожидания ответа на пинг до состояния плохой связи, в мс */
+        uint32_t link_dead_timeout_ms = 6000;               /**< Время ожидания ответа на пинг до потери соединения, в мс */
+        uint32_t link_hold_timeout_ms = 0;                  /**< Время удержания сделки при плохой связи, в мс */
 
         bool parser(json &j) {
             try {
@@ -148,6 +164,13 @@ namespace binomo_bot {
                 if(j_bot["bet_attempts_delay_ms"] != nullptr) repeated_bet_attempts_delay_ms = j_bot["bet_attempts_delay_ms"];
                 if(j_bot["repeated_bet_delay_ms"] != nullptr) repeated_bet_attempts_delay_ms = j_bot["repeated_bet_delay_ms"];
                 if(j_bot["repeated_bet_delay"] != nullptr) repeated_bet_attempts_delay_ms = j_bot["repeated_bet_delay"];
+                if(j_bot["repeated_bet_attempts"] != nullptr) repeated_bet_attempts = j_bot["repeated_bet_attempts"];
+                if(j_bot["bet_attempts"] != nullptr) repeated_bet_attempts = j_bot["bet_attempts"];
+                if(j_bot["repeated_bet_deadline_ms"] != nullptr) repeated_bet_deadline_ms = j_bot["repeated_bet_deadline_ms"];
+                if(j_bot["heartbeat_period_ms"] != nullptr) heartbeat_period_ms = j_bot["heartbeat_period_ms"];
+                if(j_bot["link_degraded_timeout_ms"] != nullptr) link_degraded_timeout_ms = j_bot["link_degraded_timeout_ms"];
+                if(j_bot["link_dead_timeout_ms"] != nullptr) link_dead_timeout_ms = j_bot["link_dead_timeout_ms"];
+                if(j_bot["link_hold_timeout_ms"] != nullptr) link_hold_timeout_ms = j_bot["link_hold_timeout_ms"];
             }
             catch(const json::parse_error& e) {
                 std::cerr << "binomo bot: BotSettings json::parse_error, what: " << e.what()
@@ -316,6 +339,48 @@ namespace binomo_bot {
 
     /** \brief Класс настроек
      */
+    class ThreadsSettings {
+    public:
+        binomo_api::common::ThreadConfig bridge;    /**< Потоки WS-сервера для связи с расширением */
+        binomo_api::common::ThreadConfig quotes;    /**< Потоки потока котировок */
+
+        void parser_thread_config(json &j, binomo_api::common::ThreadConfig &config) {
+            if(j["io_threads"] != nullptr) config.io_threads = j["io_threads"];
+            if(j["io_cores"] != nullptr) config.io_cores = j["io_cores"].get<std::vector<int>>();
+            if(j["callback_cores"] != nullptr) config.callback_cores = j["callback_cores"].get<std::vector<int>>();
+            if(j["name"] != nullptr) config.name = j["name"];
+        }
+
+        bool parser(json &j) {
+            try {
+                if(j["threads"] == nullptr) return true;
+                json j_threads = j["threads"];
+                if(j_threads["bridge"] != nullptr) parser_thread_config(j_threads["bridge"], bridge);
+                if(j_threads["quotes"] != nullptr) parser_thread_config(j_threads["quotes"], quotes);
+            }
+            catch(const json::parse_error& e) {
+                std::cerr << "binomo bot: ThreadsSettings json::parse_error, what: " << e.what()
+                   << " exception_id: " << e.id << std::endl;
+                return false;
+            }
+            catch(json::out_of_range& e) {
+                std::cerr << "binomo bot: ThreadsSettings json::out_of_range, what:" << e.what()
+                   << " exception_id: " << e.id << std::endl;
+                return false;
+            }
+            catch(json::type_error& e) {
+                std::cerr << "binomo bot: ThreadsSettings json::type_error, what:" << e.what()
+                   << " exception_id: " << e.id << std::endl;
+                return false;
+            }
+            catch(...) {
+                std::cerr << "binomo bot: ThreadsSettings json error" << std::endl;
+                return false;
+            }
+            return true;
+        }
+    };
+
     class Settings {
     public:
         std::string json_settings_file;
@@ -325,6 +390,7 @@ namespace binomo_bot {
         BotSettings bot;
         HotkeysSettings hotkeys;
         TimeFilterSettings time_filter;
+        ThreadsSettings threads;
 
         bool is_error = false;
 
@@ -363,6 +429,7 @@ namespace binomo_bot {
             if(!quotes_stream.parser(j)) is_error = true;
             if(!bot.parser(j)) is_error = true;
             if(!hotkeys.parser(j)) is_error = true;
+            if(!threads.parser(j)) is_error = true;
         }
     };
 }
@@ -51,6 +51,9 @@ namespace binomo_bot {
         std::vector<std::shared_ptr<binomo_api::MqlHst<>>> mql_history;
 		std::mutex mql_history_mutex;
 
+        std::shared_ptr<binomo_api::CandleStore<>> candle_store;              /**< Хранилище баров */
+        std::shared_ptr<binomo_api::TickTapeWriter> tick_tape;                /**< Лента тиков */
+
 		std::atomic<int> update_ping_tick = ATOMIC_VAR_INIT(0);
 
         std::atomic<bool> is_pipe_server = ATOMIC_VAR_INIT(false);
@@ -136,11 +139,25 @@ namespace binomo_bot {
                 binomo_http_api = std::make_shared<binomo_api::BinomoApiHttp<>>(
                         settings.binomo.sert_file,
                         settings.binomo.cookie_file);
+                if(!settings.quotes_stream.store_path.empty()) {
+                    candle_store = std::make_shared<binomo_api::CandleStore<>>(settings.quotes_stream.store_path);
+                    binomo_http_api->set_candle_store(candle_store);
+                }
             }
             {
                 std::lock_guard<std::mutex> lock(api_mutex);
                 api = std::make_shared<binomo_api::BinomoApi>(
                         settings.binomo.port);
+                api->set_bet_attempts(
+                        settings.bot.repeated_bet_attempts,
+                        settings.bot.repeated_bet_attempts_delay_ms,
+                        (double)settings.bot.repeated_bet_deadline_ms / 1000.0d);
+                api->set_link_monitor(
+                        settings.bot.heartbeat_period_ms,
+                        (double)settings.bot.link_degraded_timeout_ms / 1000.0d,
+                        (double)settings.bot.link_dead_timeout_ms / 1000.0d,
+                        (double)settings.bot.link_hold_timeout_ms / 1000.0d);
+                api->set_thread_config(settings.threads.bridge);
                 api->start();
             }
             return true;
@@ -159,6 +176,13 @@ namespace binomo_bot {
 				std::lock_guard<std::mutex> lock(candlestick_streams_mutex);
 				candlestick_streams = std::make_shared<binomo_api::BinomoApiPriceStream<>>(settings.binomo.sert_file);
 				candlestick_streams->set_volume_mode(settings.quotes_stream.volume_mode);
+				candlestick_streams->set_thread_config(settings.threads.quotes);
+				candlestick_streams->set_parser_thread(settings.quotes_stream.is_parser_thread, settings.quotes_stream.parser_queue);
+				if(candle_store) candlestick_streams->set_candle_store(candle_store);
+				if(!settings.quotes_stream.tick_tape_path.empty()) {
+                    tick_tape = std::make_shared<binomo_api::TickTapeWriter>(settings.quotes_stream.tick_tape_path);
+                    candlestick_streams->set_tick_tape(tick_tape);
+				}
 			}
 
             /* проверяем параметры символов */
@@ -239,10 +263,11 @@ namespace binomo_bot {
 
             /* инициализируем callback функцию потока котировок */
             candlestick_streams->on_candle = [&](
-                    const std::string &symbol,
+                    const binomo_api::common::SymbolId symbol_id,
                     const binomo_api::common::Candle &candle,
                     const uint32_t period,
                     const bool close_candle) {
+                const std::string &symbol = binomo_api::common::get_symbol_name(symbol_id);
 
                 //std::cout << "--symbol00 " << symbol << std::endl;
 
@@ -283,7 +308,7 @@ namespace binomo_bot {
                                 const xtime::timestamp_t step_time = period;// * xtime::SECONDS_IN_MINUTE;
                                 //std::cout << "step_time " << step_time << std::endl;
                                 for(xtime::timestamp_t t = last_timestamp; t < candle.timestamp; t += step_time) {
-                                    binomo_api::common::Candle streams_old_candle = candlestick_streams->get_timestamp_candle(symbol, period, t);
+                                    binomo_api::common::Candle streams_old_candle = candlestick_streams->get_timestamp_candle(symbol_id, period, t);
                                     std::lock_guard<std::mutex> lock(mql_history_mutex);
                                     mql_history[i]->add_new_candle_with_memory(streams_old_candle);
                                     ///std::cout << "TIME once " << xtime::get_str_date_time(t) << std::endl;
@@ -335,18 +360,23 @@ namespace binomo_bot {
             /* ждем, чтобы котировки прогрузились */
             std::this_thread::sleep_for(std::chrono::milliseconds(1000));
 
-            /* загружаем исторические данные */
+            /* загружаем исторические данные всех символов параллельно */
+            using HistoryRequest = binomo_api::BinomoApiHttp<>::HistoryRequest;
+            std::vector<HistoryRequest> history_requests;
+            const xtime::timestamp_t stop_date = xtime::get_first_timestamp_minute();
             for(size_t i = 0; i < settings.quotes_stream.symbols.size(); ++i) {
-                const xtime::timestamp_t stop_date = xtime::get_first_timestamp_minute();
                 const xtime::timestamp_t start_date = stop_date - (settings.quotes_stream.symbols[i].second * settings.quotes_stream.candles);
-                std::vector<binomo_api::common::Candle> candles;
-
-                int err = binomo_http_api->get_historical_data(
-                    candles,
+                history_requests.push_back(HistoryRequest(
                     settings.quotes_stream.symbols[i].first,
                     settings.quotes_stream.symbols[i].second,
                     start_date,
-                    stop_date);
+                    stop_date));
+            }
+            binomo_http_api->get_historical_data(history_requests, settings.quotes_stream.history_requests);
+
+            for(size_t i = 0; i < settings.quotes_stream.symbols.size(); ++i) {
+                const std::vector<binomo_api::common::Candle> &candles = history_requests[i].candles;
+                const int err = history_requests[i].error;
 
                 for(size_t c = 0; c < candles.size(); ++c) {
                     binomo_api::common::Candle candle = candles[c];
@@ -543,7 +573,7 @@ namespace binomo_bot {
                                         //std::cout << "CHECK_ERROR" << std::endl;
                                         binomo_api::common::PrintThread{}
                                             << "binomo bot: bo-bet opennig error (server response), symbol = "
-                                            << symbol << std::endl;
+                                            << symbol << ", attempts = " << bet.attempts << std::endl;
                                     break;
                                     case binomo_api::common::BetStatus::STANDOFF:
                                         //std::cout << "STANDOFF" << std::endl;
@@ -656,7 +686,7 @@ namespace binomo_bot {
                             //std::cout << "CHECK_ERROR" << std::endl;
                             binomo_api::common::PrintThread{}
                                 << "binomo bot: bo-bet opennig error (server response), symbol = "
-                                << symbol << std::endl;
+                                << symbol << ", attempts = " << bet.attempts << std::endl;
                         break;
                         case binomo_api::common::BetStatus::STANDOFF:
                             //std::cout << "STANDOFF" << std::endl;
@@ -0,0 +1,397 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_CANDLE_SERIES_HPP_INCLUDED
+#define BINOMO_CPP_API_CANDLE_SERIES_HPP_INCLUDED
+
+#include "../binomo-cpp-api-common.hpp"
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace binomo_api {
+
+    /** \brief Политика хранения баров ряда
+     */
+    class CandleRetention {
+    public:
+        size_t max_candles = 4096;          /**< Максимальное количество периодов в ряду */
+        xtime::timestamp_t max_age = 0;     /**< Максимальный возраст бара относительно последнего бара, секунды. 0 - без ограничения */
+
+        CandleRetention() {};
+
+        CandleRetention(
+                const size_t user_max_candles,
+                const xtime::timestamp_t user_max_age = 0) :
+            max_candles(user_max_candles), max_age(user_max_age) {
+        };
+    };
+
+    /** \brief Ряд баров одного символа и периода
+     *
+     * Бары хранятся в кольцевом буфере фиксированной емкости.
+     * Ячейка бара определяется как (timestamp / период) % емкость, поэтому
+     * поиск последнего бара и бара по метке времени выполняется за O(1),
+     * а тик обновляет один бар в непрерывном массиве.
+     *
+     * Метки времени баров должны быть кратны периоду.
+     * Ряд хранит бары за последние max_candles периодов и не старше max_age относительно
+     * последнего бара. Пустая ячейка имеет метку времени 0. Более старые бары удаляются.
+     *
+     * Ряд рассчитан на одного писателя и любое количество читателей.
+     * Писатель изменяет ряд между begin_write() и end_write() и никогда не ждет читателей.
+     * Читатели используют методы load_*, которые не блокируют писателя: они копируют
+     * данные и повторяют чтение, если за это время ряд изменился (seqlock).
+     * Остальные методы предназначены для писателя
+     */
+    template<class CANDLE = common::Candle>
+    class CandleSeries {
+    private:
+        std::vector<CANDLE> candles;
+        CandleRetention retention;
+        uint32_t period = 0;
+        size_t count = 0;                           /**< Количество баров в ряду */
+        xtime::timestamp_t first_timestamp = 0;     /**< Метка времени самого старого бара */
+        xtime::timestamp_t last_timestamp = 0;      /**< Метка времени последнего бара */
+        std::atomic<uint64_t> sequence = ATOMIC_VAR_INIT(0);   /**< Нечетное значение - идет запись */
+
+        /** \brief Прочитать ряд без блокировки писателя
+         *
+         * Функция может быть вызвана несколько раз, пока чтение не пройдет без записи.
+         * Результат функция должна сохранять копированием
+         * \param function Функция чтения
+         */
+        template<class FUNCTION>
+        void read(FUNCTION function) const {
+            while(true) {
+                const uint64_t start = sequence.load(std::memory_order_acquire);
+                if(start & 1) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                function();
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if(sequence.load(std::memory_order_relaxed) == start) return;
+            }
+        }
+
+        inline size_t get_slot(const xtime::timestamp_t timestamp) const {
+            return (size_t)((timestamp / period) % candles.size());
+        }
+
+        /** \brief Получить метку времени самого старого бара, который может храниться в ряду
+         * \param timestamp Метка времени последнего бара
+         * \return Метка времени
+         */
+        xtime::timestamp_t get_lower_bound(const xtime::timestamp_t timestamp) const {
+            xtime::timestamp_t bound = 0;
+            const xtime::timestamp_t span = (xtime::timestamp_t)(candles.size() - 1) * period;
+            if(timestamp > span) bound = timestamp - span;
+            if(retention.max_age > 0 && timestamp > retention.max_age) {
+                bound = std::max(bound, timestamp - retention.max_age);
+            }
+            return bound;
+        }
+
+        /** \brief Удалить бары старше метки времени
+         * \param bound Метка времени самого старого бара, который останется в ряду
+         */
+        void evict(const xtime::timestamp_t bound) {
+            /* все бары лежат между first_timestamp и last_timestamp, поэтому цикл не длиннее емкости ряда */
+            while(count > 0) {
+                CANDLE &slot = candles[get_slot(first_timestamp)];
+                if(slot.timestamp == first_timestamp) {
+                    if(first_timestamp >= bound) break;
+                    slot = CANDLE();
+                    --count;
+                }
+                first_timestamp += period;
+            }
+        }
+
+        /** \brief Сдвинуть ряд к новому последнему бару
+         *
+         * Бары, которые выходят за пределы политики хранения, удаляются
+         * \param timestamp Метка времени нового последнего бара
+         */
+        void advance(const xtime::timestamp_t timestamp) {
+            evict(get_lower_bound(timestamp));
+            last_timestamp = timestamp;
+            if(count == 0) first_timestamp = timestamp;
+        }
+
+    public:
+
+        /** \brief Конструктор ряда баров
+         * \param user_period Период баров, секунды
+         * \param capacity Емкость ряда, количество периодов
+         */
+        CandleSeries(const uint32_t user_period = 60, const size_t capacity = 4096) :
+            candles(capacity > 0 ? capacity : 1), period(user_period > 0 ? user_period : 1) {
+            retention.max_candles = candles.size();
+        };
+
+        /** \brief Конструктор ряда баров
+         * \param user_period Период баров, секунды
+         * \param user_retention Политика хранения баров
+         */
+        CandleSeries(const uint32_t user_period, const CandleRetention &user_retention) :
+            candles(user_retention.max_candles > 0 ? user_retention.max_candles : 1),
+            retention(user_retention),
+            period(user_period > 0 ? user_period : 1) {
+            retention.max_candles = candles.size();
+        };
+
+        CandleSeries(const CandleSeries&) = delete;
+        CandleSeries &operator=(const CandleSeries&) = delete;
+
+        /** \brief Начать изменение ряда
+         *
+         * Читатели, которые застали изменение, повторят чтение
+         */
+        inline void begin_write() {
+            sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        /** \brief Закончить изменение ряда
+         */
+        inline void end_write() {
+            sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        inline uint32_t get_period() const {
+            return period;
+        }
+
+        /** \brief Получить емкость ряда
+         * \return Количество периодов, которое вмещает ряд
+         */
+        inline size_t get_capacity() const {
+            return candles.size();
+        }
+
+        /** \brief Получить количество баров
+         * \return Количество баров в ряду
+         */
+        inline size_t size() const {
+            return count;
+        }
+
+        inline bool empty() const {
+            return count == 0;
+        }
+
+        /** \brief Проверить, что ряд не имеет пропусков
+         * \return Вернет true, если между первым и последним баром нет пропущенных периодов
+         */
+        inline bool is_continuous() const {
+            return count == 0 || count == (size_t)((last_timestamp - first_timestamp) / period + 1);
+        }
+
+        inline xtime::timestamp_t get_first_timestamp() const {
+            return first_timestamp;
+        }
+
+        inline xtime::timestamp_t get_last_timestamp() const {
+            return last_timestamp;
+        }
+
+        /** \brief Записать бар
+         *
+         * Бар заменяет бар с той же меткой времени. Бар новее последнего сдвигает ряд,
+         * бар старше емкости ряда не записывается
+         * \param candle Бар
+         * \return Вернет false, если бар не записан
+         */
+        bool set(const CANDLE &candle) {
+            const xtime::timestamp_t timestamp = candle.timestamp;
+            if(timestamp == 0) return false;
+            if(count == 0) {
+                for(size_t i = 0; i < candles.size(); ++i) candles[i] = CANDLE();
+                first_timestamp = last_timestamp = timestamp;
+            } else
+            if(timestamp > last_timestamp) {
+                advance(timestamp);
+            } else
+            if(timestamp < get_lower_bound(last_timestamp)) {
+                return false;
+            }
+            CANDLE &slot = candles[get_slot(timestamp)];
+            if(slot.timestamp != timestamp) {
+                ++count;
+                if(timestamp < first_timestamp) first_timestamp = timestamp;
+            }
+            slot = candle;
+            return true;
+        }
+
+        /** \brief Найти бар по метке времени
+         * \param timestamp Метка времени
+         * \return Указатель на бар или nullptr, если бара нет
+         */
+        inline CANDLE *find(const xtime::timestamp_t timestamp) {
+            if(count == 0 || timestamp == 0 || timestamp > last_timestamp || timestamp < first_timestamp) return nullptr;
+            CANDLE &slot = candles[get_slot(timestamp)];
+            return slot.timestamp == timestamp ? &slot : nullptr;
+        }
+
+        inline const CANDLE *find(const xtime::timestamp_t timestamp) const {
+            return const_cast<CandleSeries*>(this)->find(timestamp);
+        }
+
+        /** \brief Получить последний бар
+         * \return Указатель на бар или nullptr, если ряд пуст
+         */
+        inline CANDLE *get_last() {
+            if(count == 0) return nullptr;
+            return &candles[get_slot(last_timestamp)];
+        }
+
+        inline const CANDLE *get_last() const {
+            return const_cast<CandleSeries*>(this)->get_last();
+        }
+
+        /** \brief Получить бар по смещению от последнего бара
+         *
+         * Смещение считается по барам, пропущенные периоды не учитываются.
+         * Если ряд не имеет пропусков, бар находится за O(1)
+         * \param offset Смещение, 0 - последний бар
+         * \return Указатель на бар или nullptr, если бара нет
+         */
+        const CANDLE *get(const size_t offset) const {
+            if(offset >= count) return nullptr;
+            if(is_continuous()) return find(last_timestamp - (xtime::timestamp_t)offset * period);
+            size_t index = 0;
+            xtime::timestamp_t t = last_timestamp;
+            for(size_t i = 0; i < candles.size(); ++i) {
+                const CANDLE *candle = find(t);
+                if(candle != nullptr) {
+                    if(index == offset) return candle;
+                    ++index;
+                }
+                if(t <= first_timestamp) break;
+                t -= period;
+            }
+            return nullptr;
+        }
+
+        inline const CandleRetention &get_retention() const {
+            return retention;
+        }
+
+        /** \brief Перебрать бары в порядке возрастания метки времени
+         *
+         * Ячейки обходятся один раз от первого до последнего бара,
+         * поэтому перебор ряда с пропусками занимает не больше емкости ряда шагов
+         * \param function Функция, которая получит бар
+         */
+        template<class FUNCTION>
+        void for_each(FUNCTION function) const {
+            if(count == 0) return;
+            for(xtime::timestamp_t t = first_timestamp; t <= last_timestamp; t += period) {
+                const CANDLE &slot = candles[get_slot(t)];
+                if(slot.timestamp == t) function(slot);
+            }
+        }
+
+        /** \brief Получить объем памяти, который занимает ряд
+         *
+         * Метод не блокирует писателя
+         * \return Объем памяти, байты
+         */
+        size_t get_memory_usage() const {
+            size_t value = 0;
+            read([&]() {
+                value = sizeof(*this) + candles.capacity() * sizeof(CANDLE);
+            });
+            return value;
+        }
+
+        /** \brief Прочитать количество баров без блокировки писателя
+         * \return Количество баров в ряду
+         */
+        size_t load_size() const {
+            size_t value = 0;
+            read([&]() {
+                value = count;
+            });
+            return value;
+        }
+
+        /** \brief Прочитать последний бар без блокировки писателя
+         * \param candle Бар
+         * \return Вернет false, если ряд пуст
+         */
+        bool load_last(CANDLE &candle) const {
+            bool is_found = false;
+            read([&]() {
+                const CANDLE *last = get_last();
+                is_found = last != nullptr;
+                if(is_found) candle = *last;
+            });
+            return is_found;
+        }
+
+        /** \brief Прочитать бар по смещению от последнего бара без блокировки писателя
+         * \param offset Смещение, 0 - последний бар
+         * \param candle Бар
+         * \return Вернет false, если бара нет
+         */
+        bool load(const size_t offset, CANDLE &candle) const {
+            bool is_found = false;
+            read([&]() {
+                const CANDLE *value = get(offset);
+                is_found = value != nullptr;
+                if(is_found) candle = *value;
+            });
+            return is_found;
+        }
+
+        /** \brief Прочитать бар по метке времени без блокировки писателя
+         * \param timestamp Метка времени
+         * \param candle Бар
+         * \return Вернет false, если бара нет
+         */
+        bool load_timestamp(const xtime::timestamp_t timestamp, CANDLE &candle) const {
+            bool is_found = false;
+            read([&]() {
+                const CANDLE *value = find(timestamp);
+                is_found = value != nullptr;
+                if(is_found) candle = *value;
+            });
+            return is_found;
+        }
+
+        /** \brief Очистить ряд
+         */
+        void clear() {
+            for(size_t i = 0; i < candles.size(); ++i) candles[i] = CANDLE();
+            count = 0;
+            first_timestamp = last_timestamp = 0;
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_CANDLE_SERIES_HPP_INCLUDED
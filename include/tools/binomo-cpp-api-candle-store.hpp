@@ -0,0 +1,493 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_CANDLE_STORE_HPP_INCLUDED
+#define BINOMO_CPP_API_CANDLE_STORE_HPP_INCLUDED
+
+#include "../binomo-cpp-api-common.hpp"
+#include <memory>
+#include <map>
+#include <vector>
+#include <array>
+#include <mutex>
+
+namespace binomo_api {
+
+    /** \brief Локальное хранилище баров
+     *
+     * Бары хранятся в файлах по одному на символ, период и месяц:
+     * <path>/<SYMBOL>_<period>_<YYYY>_<MM>.bcs
+     *
+     * Файл имеет фиксированный колоночный формат, поэтому его можно отобразить в память:
+     * - заголовок 64 байта (сигнатура, версия, период, количество ячеек, начало месяца)
+     * - колонка состояний ячеек, uint8_t на ячейку, выровнена до 8 байт
+     * - колонки open, high, low, close, volume, double на ячейку
+     *
+     * Ячейка бара определяется как (timestamp - начало месяца) / период.
+     * Состояние ячейки: 0 - нет данных, 1 - есть бар, 2 - данные загружены, но бара нет (например, выходной)
+     */
+    template<class CANDLE = common::Candle>
+    class CandleStore {
+    public:
+        /// Состояние ячейки бара
+        enum SlotState {
+            SLOT_UNKNOWN = 0,   /**< Данных нет, нужно загрузить */
+            SLOT_CANDLE = 1,    /**< Бар есть */
+            SLOT_EMPTY = 2,     /**< Данные загружены, бара нет */
+        };
+
+    private:
+        static const uint32_t FILE_MAGIC = 0x31534342;  /**< Сигнатура файла "BCS1" */
+        static const uint32_t FILE_VERSION = 1;
+        static const uint32_t HEADER_SIZE = 64;
+        static const uint32_t COLUMNS = 5;              /**< open, high, low, close, volume */
+        static const size_t MAX_OPEN_FILES = 64;
+
+        /** \brief Открытый файл хранилища
+         */
+        class StoreFile {
+        public:
+            std::fstream file;
+            xtime::timestamp_t month_timestamp = 0;     /**< Начало месяца */
+            uint32_t period = 0;
+            uint32_t slots = 0;                         /**< Количество ячеек */
+
+            StoreFile() {};
+
+            inline uint64_t get_state_offset(const uint32_t slot) const {
+                return HEADER_SIZE + slot;
+            }
+
+            inline uint64_t get_column_offset(const uint32_t column, const uint32_t slot) const {
+                const uint64_t state_size = ((uint64_t)slots + 7) & ~((uint64_t)7);
+                return HEADER_SIZE + state_size + ((uint64_t)column * slots + slot) * sizeof(double);
+            }
+        };
+
+        std::string path;
+        std::map<std::string, std::unique_ptr<StoreFile>> files;
+        std::mutex files_mutex;
+
+        /** \brief Получить начало месяца
+         * \param timestamp Метка времени
+         * \return Метка времени начала месяца
+         */
+        static xtime::timestamp_t get_month_timestamp(const xtime::timestamp_t timestamp) {
+            xtime::DateTime date_time(timestamp);
+            return xtime::get_timestamp(1, date_time.month, date_time.year);
+        }
+
+        /** \brief Получить начало следующего месяца
+         * \param timestamp Метка времени
+         * \return Метка времени начала следующего месяца
+         */
+        static xtime::timestamp_t get_next_month_timestamp(const xtime::timestamp_t timestamp) {
+            xtime::DateTime date_time(timestamp);
+            if(date_time.month == 12) return xtime::get_timestamp(1, 1, date_time.year + 1);
+            return xtime::get_timestamp(1, date_time.month + 1, date_time.year);
+        }
+
+        std::string get_file_name(
+                const std::string &symbol,
+                const uint32_t period,
+                const xtime::timestamp_t month_timestamp) {
+            return path + "/" + symbol + "_" + std::to_string(period) + "_" +
+                xtime::to_string("%YYYY_%MM", month_timestamp) + ".bcs";
+        }
+
+        template<class T>
+        inline static void write_value(std::fstream &file, const T value) {
+            file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+        }
+
+        template<class T>
+        inline static bool read_value(std::fstream &file, T &value) {
+            file.read(reinterpret_cast<char *>(&value), sizeof(value));
+            return (bool)file;
+        }
+
+        /** \brief Создать пустой файл
+         */
+        bool create_file(const std::string &file_name, StoreFile &store_file) {
+            store_file.file.close();
+            store_file.file.clear();
+            store_file.file.open(file_name, std::ios_base::binary | std::ios::in | std::ios::out | std::ios::trunc);
+            if(!store_file.file.is_open()) return false;
+            write_value(store_file.file, FILE_MAGIC);
+            write_value(store_file.file, FILE_VERSION);
+            write_value(store_file.file, store_file.period);
+            write_value(store_file.file, store_file.slots);
+            write_value(store_file.file, (uint64_t)store_file.month_timestamp);
+            const std::vector<char> zeros(HEADER_SIZE - 24, 0);
+            store_file.file.write(zeros.data(), zeros.size());
+
+            /* задаем размер файла записью последнего байта, колонки не заполняются:
+             * файловая система читает незаписанные области как нули и выделяет место при записи
+             */
+            const uint64_t file_size = store_file.get_column_offset(COLUMNS, 0);
+            store_file.file.seekp(file_size - 1);
+            write_value(store_file.file, (char)0);
+            store_file.file.flush();
+            return (bool)store_file.file;
+        }
+
+        /** \brief Открыть файл, проверив заголовок
+         */
+        bool open_file(const std::string &file_name, StoreFile &store_file) {
+            store_file.file.open(file_name, std::ios_base::binary | std::ios::in | std::ios::out);
+            if(!store_file.file.is_open()) return false;
+            uint32_t magic = 0, version = 0, period = 0, slots = 0;
+            uint64_t month_timestamp = 0;
+            if (!read_value(store_file.file, magic) ||
+                !read_value(store_file.file, version) ||
+                !read_value(store_file.file, period) ||
+                !read_value(store_file.file, slots) ||
+                !read_value(store_file.file, month_timestamp)) return false;
+            return magic == FILE_MAGIC &&
+                version == FILE_VERSION &&
+                period == store_file.period &&
+                slots == store_file.slots &&
+                month_timestamp == store_file.month_timestamp;
+        }
+
+        /** \brief Получить файл месяца
+         *
+         * Метод вызывается под files_mutex
+         * \return Указатель на файл или nullptr
+         */
+        StoreFile *get_file(
+                const std::string &symbol,
+                const uint32_t period,
+                const xtime::timestamp_t month_timestamp,
+                const bool is_create) {
+            const std::string file_name = get_file_name(symbol, period, month_timestamp);
+            auto it_file = files.find(file_name);
+            if(it_file != files.end()) return it_file->second.get();
+
+            std::unique_ptr<StoreFile> store_file(new StoreFile());
+            store_file->month_timestamp = month_timestamp;
+            store_file->period = period;
+            const xtime::timestamp_t month_size = get_next_month_timestamp(month_timestamp) - month_timestamp;
+            store_file->slots = (uint32_t)((month_size + period - 1) / period);
+
+            if(!open_file(file_name, *store_file)) {
+                if(!is_create) return nullptr;
+                if(!create_file(file_name, *store_file)) {
+                    std::cerr << "binomo api: candle store can't create file " << file_name << std::endl;
+                    return nullptr;
+                }
+            }
+
+            if(files.size() >= MAX_OPEN_FILES) files.clear();
+            StoreFile *ptr = store_file.get();
+            files[file_name] = std::move(store_file);
+            return ptr;
+        }
+
+        /** \brief Прочитать состояния ячеек файла
+         */
+        void read_states(
+                StoreFile &store_file,
+                const uint32_t first_slot,
+                const uint32_t count,
+                std::vector<uint8_t> &states) {
+            states.assign(count, SLOT_UNKNOWN);
+            store_file.file.clear();
+            store_file.file.seekg(store_file.get_state_offset(first_slot));
+            store_file.file.read(reinterpret_cast<char*>(states.data()), count);
+            if(!store_file.file) {
+                store_file.file.clear();
+                std::fill(states.begin(), states.end(), (uint8_t)SLOT_UNKNOWN);
+            }
+        }
+
+        /** \brief Прочитать ячейки файла
+         */
+        void read_slots(
+                StoreFile &store_file,
+                const uint32_t first_slot,
+                const uint32_t count,
+                std::vector<uint8_t> &states,
+                std::array<std::vector<double>, COLUMNS> &columns) {
+            states.assign(count, SLOT_UNKNOWN);
+            store_file.file.clear();
+            store_file.file.seekg(store_file.get_state_offset(first_slot));
+            store_file.file.read(reinterpret_cast<char*>(states.data()), count);
+            for(uint32_t c = 0; c < COLUMNS; ++c) {
+                columns[c].assign(count, 0.0d);
+                store_file.file.seekg(store_file.get_column_offset(c, first_slot));
+                store_file.file.read(reinterpret_cast<char*>(columns[c].data()), count * sizeof(double));
+            }
+            if(!store_file.file) {
+                store_file.file.clear();
+                std::fill(states.begin(), states.end(), (uint8_t)SLOT_UNKNOWN);
+            }
+        }
+
+        /** \brief Записать состояние ячейки
+         */
+        inline void write_state(StoreFile &store_file, const uint32_t slot, const uint8_t state) {
+            store_file.file.seekp(store_file.get_state_offset(slot));
+            write_value(store_file.file, state);
+        }
+
+        /** \brief Записать бар в ячейку
+         */
+        void write_slot(StoreFile &store_file, const uint32_t slot, const CANDLE &candle) {
+            store_file.file.clear();
+            const double values[COLUMNS] = {candle.open, candle.high, candle.low, candle.close, candle.volume};
+            for(uint32_t c = 0; c < COLUMNS; ++c) {
+                store_file.file.seekp(store_file.get_column_offset(c, slot));
+                write_value(store_file.file, values[c]);
+            }
+            /* состояние пишем последним, чтобы читатель не увидел неполный бар */
+            write_state(store_file, slot, SLOT_CANDLE);
+        }
+
+    public:
+
+        /** \brief Конструктор хранилища
+         * \param user_path Папка с файлами хранилища. Папка должна существовать
+         */
+        CandleStore(const std::string &user_path) :
+            path(user_path) {
+        };
+
+        ~CandleStore() {
+            std::lock_guard<std::mutex> lock(files_mutex);
+            for(auto &item : files) {
+                item.second->file.flush();
+            }
+        }
+
+        /** \brief Прочитать бары за период
+         * \param symbol Имя символа
+         * \param period Период
+         * \param start_date Начальная дата (включительно)
+         * \param stop_date Конечная дата (не включительно)
+         * \param candles Бары, которые есть в хранилище, будут добавлены в конец массива
+         * \param is_complete Вернет true, если в хранилище нет пропусков за указанный период
+         * \return Вернет false в случае ошибки аргументов
+         */
+        bool get_candles(
+                const std::string &symbol,
+                const uint32_t period,
+                const xtime::timestamp_t start_date,
+                const xtime::timestamp_t stop_date,
+                std::vector<CANDLE> &candles,
+                bool &is_complete) {
+            is_complete = false;
+            if(period == 0 || start_date >= stop_date) return false;
+            const std::string name = common::normalize_symbol_name(symbol);
+            xtime::timestamp_t date = start_date - (start_date % period);
+            std::vector<uint8_t> states;
+            std::array<std::vector<double>, COLUMNS> columns;
+            is_complete = true;
+
+            std::lock_guard<std::mutex> lock(files_mutex);
+            while(date < stop_date) {
+                const xtime::timestamp_t month_timestamp = get_month_timestamp(date);
+                const xtime::timestamp_t next_month_timestamp = get_next_month_timestamp(date);
+                const xtime::timestamp_t end_date = std::min(stop_date, next_month_timestamp);
+                StoreFile *store_file = get_file(name, period, month_timestamp, false);
+                if(store_file == nullptr) {
+                    is_complete = false;
+                    date = next_month_timestamp;
+                    continue;
+                }
+                const uint32_t first_slot = (uint32_t)((date - month_timestamp) / period);
+                const uint32_t last_slot = (uint32_t)std::min(
+                    (uint64_t)store_file->slots,
+                    (uint64_t)((end_date - month_timestamp + period - 1) / period));
+                if(last_slot > first_slot) {
+                    const uint32_t count = last_slot - first_slot;
+                    read_slots(*store_file, first_slot, count, states, columns);
+                    for(uint32_t i = 0; i < count; ++i) {
+                        if(states[i] == SLOT_UNKNOWN) {
+                            is_complete = false;
+                            continue;
+                        }
+                        if(states[i] != SLOT_CANDLE) continue;
+                        CANDLE candle;
+                        candle.timestamp = month_timestamp + (xtime::timestamp_t)(first_slot + i) * period;
+                        candle.open = columns[0][i];
+                        candle.high = columns[1][i];
+                        candle.low = columns[2][i];
+                        candle.close = columns[3][i];
+                        candle.volume = columns[4][i];
+                        candles.push_back(candle);
+                    }
+                }
+                date = next_month_timestamp;
+            }
+            return true;
+        }
+
+        /** \brief Найти пропуски в хранилище
+         * \param symbol Имя символа
+         * \param period Период
+         * \param start_date Начальная дата (включительно)
+         * \param stop_date Конечная дата (не включительно)
+         * \return Список диапазонов [начало, конец), для которых нет данных
+         */
+        std::vector<std::pair<xtime::timestamp_t, xtime::timestamp_t>> get_missing_ranges(
+                const std::string &symbol,
+                const uint32_t period,
+                const xtime::timestamp_t start_date,
+                const xtime::timestamp_t stop_date) {
+            std::vector<std::pair<xtime::timestamp_t, xtime::timestamp_t>> ranges;
+            if(period == 0 || start_date >= stop_date) return ranges;
+            const std::string name = common::normalize_symbol_name(symbol);
+            xtime::timestamp_t date = start_date - (start_date % period);
+            std::vector<uint8_t> states;
+
+            auto add_range = [&](const xtime::timestamp_t beg, const xtime::timestamp_t end) {
+                if(!ranges.empty() && ranges.back().second == beg) ranges.back().second = end;
+                else ranges.push_back(std::make_pair(beg, end));
+            };
+
+            std::lock_guard<std::mutex> lock(files_mutex);
+            while(date < stop_date) {
+                const xtime::timestamp_t month_timestamp = get_month_timestamp(date);
+                const xtime::timestamp_t next_month_timestamp = get_next_month_timestamp(date);
+                const xtime::timestamp_t end_date = std::min(stop_date, next_month_timestamp);
+                StoreFile *store_file = get_file(name, period, month_timestamp, false);
+                if(store_file == nullptr) {
+                    add_range(date, end_date);
+                    date = next_month_timestamp;
+                    continue;
+                }
+                const uint32_t first_slot = (uint32_t)((date - month_timestamp) / period);
+                const uint32_t last_slot = (uint32_t)std::min(
+                    (uint64_t)store_file->slots,
+                    (uint64_t)((end_date - month_timestamp + period - 1) / period));
+                if(last_slot > first_slot) {
+                    const uint32_t count = last_slot - first_slot;
+                    read_states(*store_file, first_slot, count, states);
+                    for(uint32_t i = 0; i < count; ++i) {
+                        if(states[i] != SLOT_UNKNOWN) continue;
+                        const xtime::timestamp_t t = month_timestamp + (xtime::timestamp_t)(first_slot + i) * period;
+                        add_range(t, std::min(t + period, end_date));
+                    }
+                }
+                date = next_month_timestamp;
+            }
+            return ranges;
+        }
+
+        /** \brief Записать загруженные бары
+         *
+         * Ячейки диапазона, для которых нет баров, помечаются как загруженные без бара.
+         * Уже записанные бары не перезаписываются, так как бары потока котировок содержат объем.
+         * Бары вне диапазона не записываются, поэтому незакрытый бар нужно исключить,
+         * передав stop_date не больше начала текущего бара
+         * \param symbol Имя символа
+         * \param period Период
+         * \param candles Бары
+         * \param start_date Начальная дата загруженного диапазона (включительно)
+         * \param stop_date Конечная дата загруженного диапазона (не включительно)
+         * \return Вернет true в случае успеха
+         */
+        bool put_candles(
+                const std::string &symbol,
+                const uint32_t period,
+                const std::vector<CANDLE> &candles,
+                const xtime::timestamp_t start_date,
+                const xtime::timestamp_t stop_date) {
+            if(period == 0 || start_date >= stop_date) return false;
+            const std::string name = common::normalize_symbol_name(symbol);
+            xtime::timestamp_t date = start_date - (start_date % period);
+            size_t index = 0;
+            std::vector<uint8_t> states;
+
+            std::lock_guard<std::mutex> lock(files_mutex);
+            while(date < stop_date) {
+                const xtime::timestamp_t month_timestamp = get_month_timestamp(date);
+                const xtime::timestamp_t next_month_timestamp = get_next_month_timestamp(date);
+                const xtime::timestamp_t end_date = std::min(stop_date, next_month_timestamp);
+                StoreFile *store_file = get_file(name, period, month_timestamp, true);
+                if(store_file == nullptr) return false;
+
+                /* бары упорядочены по времени, пропускаем бары до начала месяца */
+                while(index < candles.size() && candles[index].timestamp < date) ++index;
+
+                const uint32_t first_slot = (uint32_t)((date - month_timestamp) / period);
+                const uint32_t last_slot = (uint32_t)std::min(
+                    (uint64_t)store_file->slots,
+                    (uint64_t)((end_date - month_timestamp + period - 1) / period));
+                if(last_slot > first_slot) read_states(*store_file, first_slot, last_slot - first_slot, states);
+
+                for(uint32_t slot = first_slot; slot < last_slot; ++slot) {
+                    const xtime::timestamp_t t = month_timestamp + (xtime::timestamp_t)slot * period;
+                    const bool is_candle = index < candles.size() && candles[index].timestamp == t;
+                    const uint8_t state = states[slot - first_slot];
+                    if(state != SLOT_CANDLE) {
+                        if(is_candle) write_slot(*store_file, slot, candles[index]);
+                        else if(state != SLOT_EMPTY) write_state(*store_file, slot, SLOT_EMPTY);
+                    }
+                    while(index < candles.size() && candles[index].timestamp < (t + period)) ++index;
+                }
+                store_file->file.flush();
+                date = next_month_timestamp;
+            }
+            return true;
+        }
+
+        /** \brief Записать закрытый бар
+         *
+         * Файл не сбрасывается на диск, чтобы запись пачки баров не ждала диск на каждом баре.
+         * Для сброса нужно вызвать flush(), при закрытии хранилища файлы сбрасываются сами
+         * \param symbol Имя символа
+         * \param period Период
+         * \param candle Бар
+         * \return Вернет true в случае успеха
+         */
+        bool put_candle(
+                const std::string &symbol,
+                const uint32_t period,
+                const CANDLE &candle) {
+            if(period == 0 || (candle.timestamp % period) != 0) return false;
+            const std::string name = common::normalize_symbol_name(symbol);
+            const xtime::timestamp_t month_timestamp = get_month_timestamp(candle.timestamp);
+
+            std::lock_guard<std::mutex> lock(files_mutex);
+            StoreFile *store_file = get_file(name, period, month_timestamp, true);
+            if(store_file == nullptr) return false;
+            const uint32_t slot = (uint32_t)((candle.timestamp - month_timestamp) / period);
+            if(slot >= store_file->slots) return false;
+            write_slot(*store_file, slot, candle);
+            return true;
+        }
+
+        /** \brief Сбросить открытые файлы на диск
+         */
+        void flush() {
+            std::lock_guard<std::mutex> lock(files_mutex);
+            for(auto &item : files) {
+                item.second->file.flush();
+            }
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_CANDLE_STORE_HPP_INCLUDED
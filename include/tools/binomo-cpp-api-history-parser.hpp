@@ -0,0 +1,340 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_HISTORY_PARSER_HPP_INCLUDED
+#define BINOMO_CPP_API_HISTORY_PARSER_HPP_INCLUDED
+
+#include <nlohmann/json.hpp>
+#include "xtime.hpp"
+#include <string>
+#include <vector>
+#include <map>
+
+namespace binomo_api {
+
+    /** \brief Разобрать метку времени в формате ISO 8601 без выделения памяти
+     *
+     * Поддерживается формат YYYY-MM-DDThh:mm:ss с необязательной дробной частью секунд
+     * и необязательным часовым поясом (Z, +hh:mm, -hh:mm, +hhmm)
+     * \param str Строка с меткой времени
+     * \param size Длина строки
+     * \param timestamp Метка времени UTC
+     * \param fraction Дробная часть секунд
+     * \return Вернет true в случае успеха
+     */
+    inline bool parse_iso_timestamp(
+            const char *str,
+            const size_t size,
+            xtime::timestamp_t &timestamp,
+            double &fraction) {
+        if(size < 19) return false;
+        auto get_number = [str](const size_t pos, const size_t len, int &value) -> bool {
+            value = 0;
+            for(size_t i = pos; i < (pos + len); ++i) {
+                if(str[i] < '0' || str[i] > '9') return false;
+                value = value * 10 + (str[i] - '0');
+            }
+            return true;
+        };
+        int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+        if(!get_number(0, 4, year) || str[4] != '-' ||
+            !get_number(5, 2, month) || str[7] != '-' ||
+            !get_number(8, 2, day) || (str[10] != 'T' && str[10] != ' ') ||
+            !get_number(11, 2, hour) || str[13] != ':' ||
+            !get_number(14, 2, minute) || str[16] != ':' ||
+            !get_number(17, 2, second)) return false;
+        if(month < 1 || month > 12 || day < 1 || day > 31 ||
+            hour > 23 || minute > 59 || second > 60) return false;
+
+        /* дробная часть секунд */
+        size_t pos = 19;
+        fraction = 0;
+        if(pos < size && str[pos] == '.') {
+            ++pos;
+            uint64_t value = 0;
+            uint64_t scale = 1;
+            while(pos < size && str[pos] >= '0' && str[pos] <= '9') {
+                /* точнее наносекунд метки времени не бывают */
+                if(scale < 1000000000) {
+                    value = value * 10 + (uint64_t)(str[pos] - '0');
+                    scale *= 10;
+                }
+                ++pos;
+            }
+            fraction = (double)value / (double)scale;
+        }
+
+        /* часовой пояс */
+        int64_t offset = 0;
+        if(pos < size && (str[pos] == '+' || str[pos] == '-')) {
+            const int sign = str[pos] == '-' ? -1 : 1;
+            int offset_hour = 0, offset_minute = 0;
+            if((pos + 3) > size || !get_number(pos + 1, 2, offset_hour)) return false;
+            pos += 3;
+            if(pos < size && str[pos] == ':') ++pos;
+            if((pos + 2) <= size && get_number(pos, 2, offset_minute)) pos += 2;
+            offset = sign * (offset_hour * xtime::SECONDS_IN_HOUR + offset_minute * xtime::SECONDS_IN_MINUTE);
+        } else
+        if(pos < size && str[pos] == 'Z') ++pos;
+        if(pos != size) return false;
+
+        timestamp = xtime::get_timestamp(day, month, year, hour, minute, second) - offset;
+        return true;
+    }
+
+    /** \brief Разобрать метку времени в формате ISO 8601 без выделения памяти
+     *
+     * Дробная часть секунд отбрасывается
+     * \param str Строка с меткой времени
+     * \param size Длина строки
+     * \param timestamp Метка времени UTC
+     * \return Вернет true в случае успеха
+     */
+    inline bool parse_iso_timestamp(const char *str, const size_t size, xtime::timestamp_t &timestamp) {
+        double fraction = 0;
+        return parse_iso_timestamp(str, size, timestamp, fraction);
+    }
+
+    /** \brief Разобрать метку времени с дробной частью секунд в формате ISO 8601 без выделения памяти
+     * \param str Строка с меткой времени
+     * \param size Длина строки
+     * \param timestamp Метка времени UTC
+     * \return Вернет true в случае успеха
+     */
+    inline bool parse_iso_ftimestamp(const char *str, const size_t size, xtime::ftimestamp_t &timestamp) {
+        xtime::timestamp_t seconds = 0;
+        double fraction = 0;
+        if(!parse_iso_timestamp(str, size, seconds, fraction)) return false;
+        timestamp = (xtime::ftimestamp_t)seconds + fraction;
+        return true;
+    }
+
+    /** \brief SAX-обработчик ответа сервера с историческими данными
+     *
+     * Обработчик проходит по массиву data и заполняет бар напрямую,
+     * не создавая DOM всего ответа и не выделяя память на каждый бар.
+     * Готовый бар передается в функцию on_candle
+     */
+    template<class CANDLE, class CALLBACK>
+    class HistorySaxHandler {
+    private:
+        using json = nlohmann::json;
+
+        /// Поле бара, значение которого ожидается следующим
+        enum class Field {
+            NONE,
+            OPEN,
+            HIGH,
+            LOW,
+            CLOSE,
+            CREATED_AT,
+        };
+
+        static const uint32_t FIELD_TIMESTAMP = 0x01;
+        static const uint32_t FIELD_PRICES = 0x1E;  /**< open, high, low, close */
+
+        CALLBACK &on_candle;
+        CANDLE candle;
+        Field field = Field::NONE;
+        uint32_t fields = 0;        /**< Найденные поля текущего бара */
+        size_t depth = 0;           /**< Глубина вложенности, 1 - корневой объект */
+        bool is_data_key = false;   /**< Следующее значение корневого объекта - массив data */
+        bool is_success_key = false;
+        bool is_data = false;       /**< Обработчик находится внутри массива data */
+
+        inline bool set_value(const double value) {
+            if(depth != 3 || !is_data) return true;
+            switch(field) {
+            case Field::OPEN: candle.open = value; fields |= 0x02; break;
+            case Field::HIGH: candle.high = value; fields |= 0x04; break;
+            case Field::LOW: candle.low = value; fields |= 0x08; break;
+            case Field::CLOSE: candle.close = value; fields |= 0x10; break;
+            default: break;
+            }
+            field = Field::NONE;
+            return true;
+        }
+
+    public:
+        bool is_success = false;    /**< Сервер вернул success: true */
+
+        HistorySaxHandler(CALLBACK &user_on_candle) : on_candle(user_on_candle) {};
+
+        bool null() {
+            field = Field::NONE;
+            return true;
+        }
+
+        bool boolean(bool value) {
+            if(depth == 1 && is_success_key) is_success = value;
+            is_success_key = false;
+            field = Field::NONE;
+            return true;
+        }
+
+        bool number_integer(json::number_integer_t value) {
+            return set_value((double)value);
+        }
+
+        bool number_unsigned(json::number_unsigned_t value) {
+            return set_value((double)value);
+        }
+
+        bool number_float(json::number_float_t value, const json::string_t &) {
+            return set_value((double)value);
+        }
+
+        bool string(json::string_t &value) {
+            if(depth == 3 && is_data && field == Field::CREATED_AT) {
+                xtime::timestamp_t timestamp = 0;
+                if(parse_iso_timestamp(value.data(), value.size(), timestamp)) {
+                    candle.timestamp = timestamp;
+                    fields |= FIELD_TIMESTAMP;
+                }
+            }
+            field = Field::NONE;
+            return true;
+        }
+
+        template<class BINARY>
+        bool binary(BINARY &) {
+            field = Field::NONE;
+            return true;
+        }
+
+        bool start_object(std::size_t) {
+            ++depth;
+            if(depth == 3 && is_data) {
+                candle = CANDLE();
+                fields = 0;
+            }
+            field = Field::NONE;
+            return true;
+        }
+
+        bool key(json::string_t &value) {
+            if(depth == 1) {
+                is_data_key = value == "data";
+                is_success_key = value == "success";
+            } else
+            if(depth == 3 && is_data) {
+                if(value == "open") field = Field::OPEN;
+                else if(value == "high") field = Field::HIGH;
+                else if(value == "low") field = Field::LOW;
+                else if(value == "close") field = Field::CLOSE;
+                else if(value == "created_at") field = Field::CREATED_AT;
+                else field = Field::NONE;
+            }
+            return true;
+        }
+
+        bool end_object() {
+            if(depth == 3 && is_data &&
+                (fields & (FIELD_TIMESTAMP | FIELD_PRICES)) == (FIELD_TIMESTAMP | FIELD_PRICES)) {
+                candle.volume = 0;
+                on_candle(candle);
+            }
+            --depth;
+            field = Field::NONE;
+            return true;
+        }
+
+        bool start_array(std::size_t) {
+            ++depth;
+            if(depth == 2 && is_data_key) is_data = true;
+            is_data_key = false;
+            is_success_key = false;
+            field = Field::NONE;
+            return true;
+        }
+
+        bool end_array() {
+            if(depth == 2) is_data = false;
+            --depth;
+            field = Field::NONE;
+            return true;
+        }
+
+        template<class EXCEPTION>
+        bool parse_error(std::size_t, const std::string &, const EXCEPTION &) {
+            return false;
+        }
+    };
+
+    /** \brief Разобрать ответ сервера с историческими данными
+     *
+     * Бары записываются напрямую в массив, память резервируется один раз
+     * по количеству баров в ответе. Если ответ не разобран или сервер вернул ошибку,
+     * массив остается без изменений
+     * \param response Ответ сервера
+     * \param candles Массив баров
+     * \return Вернет true в случае успеха
+     */
+    template<class CANDLE>
+    bool parse_history(const std::string &response, std::vector<CANDLE> &candles) {
+        const size_t old_size = candles.size();
+
+        /* оцениваем количество баров по количеству меток времени */
+        size_t count = 0;
+        const std::string created_at("\"created_at\"");
+        std::size_t pos = response.find(created_at);
+        while(pos != std::string::npos) {
+            ++count;
+            pos = response.find(created_at, pos + created_at.size());
+        }
+        candles.reserve(old_size + count);
+
+        auto on_candle = [&candles](const CANDLE &candle) {
+            candles.push_back(candle);
+        };
+        HistorySaxHandler<CANDLE, decltype(on_candle)> handler(on_candle);
+        bool is_parsed = false;
+        try {
+            is_parsed = nlohmann::json::sax_parse(response, &handler);
+        } catch(...) {
+            is_parsed = false;
+        }
+        if(!is_parsed || !handler.is_success) {
+            candles.resize(old_size);
+            return false;
+        }
+        return true;
+    }
+
+    /** \brief Разобрать ответ сервера с историческими данными
+     * \param response Ответ сервера
+     * \param candles Бары, упорядоченные по метке времени
+     * \return Вернет true в случае успеха
+     */
+    template<class CANDLE>
+    bool parse_history(const std::string &response, std::map<xtime::timestamp_t, CANDLE> &candles) {
+        std::vector<CANDLE> temp;
+        if(!parse_history(response, temp)) return false;
+        for(size_t i = 0; i < temp.size(); ++i) {
+            candles[(xtime::timestamp_t)temp[i].timestamp] = temp[i];
+        }
+        return true;
+    }
+}
+
+#endif // BINOMO_CPP_API_HISTORY_PARSER_HPP_INCLUDED
@@ -0,0 +1,449 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_QUOTE_PARSER_HPP_INCLUDED
+#define BINOMO_CPP_API_QUOTE_PARSER_HPP_INCLUDED
+
+#include "../binomo-cpp-api-common.hpp"
+#include "binomo-cpp-api-history-parser.hpp"
+#include <cstdlib>
+#include <cstring>
+
+namespace binomo_api {
+
+    /** \brief Разбор сообщений потока котировок без выделения памяти
+     *
+     * Разбор рассчитан на сообщения вида
+     * {"data":[{"assets":[{"rate":...,"precision":...,"created_at":"...","ric":"..."}],"action":"assets"}],"success":true,"errors":[]}
+     * и на подтверждения подписки вида
+     * {"data":[{"field":"BTC/USD","action":"subscribe"}],"success":true,"errors":[]}
+     *
+     * Сообщение разбирается по месту: строки декодируются в буферы на стеке,
+     * числа читаются без копирования, символ находится в реестре по ric без создания строки.
+     * Поле success и поле action могут идти после данных, поэтому сначала находятся их значения,
+     * а данные разбираются вторым проходом по уже найденному диапазону
+     */
+    class QuoteFrameParser {
+    public:
+        static const size_t MAX_STRING_SIZE = 64;  /**< Наибольшая длина ric и created_at */
+
+    private:
+
+        /// Указатель на текущий символ сообщения
+        class Scanner {
+        public:
+            const char *ptr;
+            const char *end;
+
+            Scanner(const char *begin, const char *user_end) : ptr(begin), end(user_end) {};
+
+            inline void skip_space() {
+                while(ptr < end && (*ptr == ' ' || *ptr == '\t' || *ptr == '\n' || *ptr == '\r')) ++ptr;
+            }
+
+            /** \brief Проверить и пропустить символ
+             */
+            inline bool expect(const char ch) {
+                skip_space();
+                if(ptr >= end || *ptr != ch) return false;
+                ++ptr;
+                return true;
+            }
+
+            inline bool peek(const char ch) {
+                skip_space();
+                return ptr < end && *ptr == ch;
+            }
+
+            /** \brief Прочитать строку
+             *
+             * Строка длиннее буфера читается до конца, но size будет больше capacity
+             * \param buffer Буфер
+             * \param capacity Размер буфера
+             * \param size Длина строки
+             */
+            bool read_string(char *buffer, const size_t capacity, size_t &size) {
+                size = 0;
+                if(!expect('"')) return false;
+                while(ptr < end) {
+                    char ch = *ptr++;
+                    if(ch == '"') return true;
+                    if(ch == '\\') {
+                        if(ptr >= end) return false;
+                        ch = *ptr++;
+                        switch(ch) {
+                        case 'b': ch = '\b'; break;
+                        case 'f': ch = '\f'; break;
+                        case 'n': ch = '\n'; break;
+                        case 'r': ch = '\r'; break;
+                        case 't': ch = '\t'; break;
+                        case 'u': {
+                            /* имена и даты состоят из ASCII, остальные символы заменяются на ? */
+                            if((end - ptr) < 4) return false;
+                            uint32_t code = 0;
+                            for(int i = 0; i < 4; ++i) {
+                                const char hex = *ptr++;
+                                code <<= 4;
+                                if(hex >= '0' && hex <= '9') code |= (uint32_t)(hex - '0');
+                                else if(hex >= 'a' && hex <= 'f') code |= (uint32_t)(hex - 'a' + 10);
+                                else if(hex >= 'A' && hex <= 'F') code |= (uint32_t)(hex - 'A' + 10);
+                                else return false;
+                            }
+                            ch = code < 0x80 ? (char)code : '?';
+                            break;
+                        }
+                        default: break; /* \" \\ \/ */
+                        }
+                    }
+                    if(size < capacity) buffer[size] = ch;
+                    ++size;
+                }
+                return false;
+            }
+
+            /** \brief Прочитать число
+             *
+             * Число с не более чем 15 значащими цифрами и небольшим порядком
+             * собирается из целой мантиссы одним делением или умножением, что дает
+             * тот же результат, что и strtod. Остальные числа передаются в strtod
+             */
+            bool read_number(double &value) {
+                static const double powers[] = {
+                    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                    1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+                };
+                skip_space();
+                const char *start = ptr;
+                const bool is_negative = ptr < end && *ptr == '-';
+                if(is_negative) ++ptr;
+                uint64_t mantissa = 0;
+                int digits = 0;
+                int exponent = 0;
+                const char *digits_start = ptr;
+                while(ptr < end && *ptr >= '0' && *ptr <= '9') {
+                    if(digits < 19) {
+                        mantissa = mantissa * 10 + (uint64_t)(*ptr - '0');
+                        if(mantissa != 0) ++digits;
+                    } else ++exponent;
+                    ++ptr;
+                }
+                if(ptr == digits_start) return false;
+                if(ptr < end && *ptr == '.') {
+                    ++ptr;
+                    const char *fraction_start = ptr;
+                    while(ptr < end && *ptr >= '0' && *ptr <= '9') {
+                        if(digits < 19) {
+                            mantissa = mantissa * 10 + (uint64_t)(*ptr - '0');
+                            if(mantissa != 0) ++digits;
+                            --exponent;
+                        }
+                        ++ptr;
+                    }
+                    if(ptr == fraction_start) return false;
+                }
+                if(ptr < end && (*ptr == 'e' || *ptr == 'E')) {
+                    ++ptr;
+                    const bool is_negative_exponent = ptr < end && *ptr == '-';
+                    if(ptr < end && (*ptr == '-' || *ptr == '+')) ++ptr;
+                    int value_exponent = 0;
+                    const char *exponent_start = ptr;
+                    while(ptr < end && *ptr >= '0' && *ptr <= '9') {
+                        if(value_exponent < 10000) value_exponent = value_exponent * 10 + (*ptr - '0');
+                        ++ptr;
+                    }
+                    if(ptr == exponent_start) return false;
+                    exponent += is_negative_exponent ? -value_exponent : value_exponent;
+                }
+                if(mantissa < ((uint64_t)1 << 53) && exponent >= -22 && exponent <= 22) {
+                    value = exponent < 0 ?
+                        (double)mantissa / powers[-exponent] :
+                        (double)mantissa * powers[exponent];
+                    if(is_negative) value = -value;
+                    return true;
+                }
+                char buffer[MAX_STRING_SIZE];
+                const size_t size = (size_t)(ptr - start);
+                if(size >= sizeof(buffer)) return false;
+                std::memcpy(buffer, start, size);
+                buffer[size] = '\0';
+                value = std::strtod(buffer, nullptr);
+                return true;
+            }
+
+            /** \brief Прочитать литерал true, false или null
+             */
+            bool read_literal(bool &value) {
+                skip_space();
+                const size_t size = (size_t)(end - ptr);
+                if(size >= 4 && std::memcmp(ptr, "true", 4) == 0) {
+                    ptr += 4;
+                    value = true;
+                    return true;
+                }
+                if(size >= 5 && std::memcmp(ptr, "false", 5) == 0) {
+                    ptr += 5;
+                    value = false;
+                    return true;
+                }
+                if(size >= 4 && std::memcmp(ptr, "null", 4) == 0) {
+                    ptr += 4;
+                    value = false;
+                    return true;
+                }
+                return false;
+            }
+
+            /** \brief Пропустить значение любого типа
+             */
+            bool skip_value() {
+                skip_space();
+                if(ptr >= end) return false;
+                if(*ptr == '"') {
+                    char temp[1];
+                    size_t size = 0;
+                    return read_string(temp, 0, size);
+                }
+                if(*ptr == '{' || *ptr == '[') {
+                    size_t depth = 0;
+                    while(ptr < end) {
+                        const char ch = *ptr;
+                        if(ch == '"') {
+                            char temp[1];
+                            size_t size = 0;
+                            if(!read_string(temp, 0, size)) return false;
+                            continue;
+                        }
+                        ++ptr;
+                        if(ch == '{' || ch == '[') ++depth;
+                        else if(ch == '}' || ch == ']') {
+                            if(--depth == 0) return true;
+                        }
+                    }
+                    return false;
+                }
+                if(*ptr == 't' || *ptr == 'f' || *ptr == 'n') {
+                    bool value = false;
+                    return read_literal(value);
+                }
+                double value = 0;
+                return read_number(value);
+            }
+
+            /** \brief Прочитать ключ объекта вместе с двоеточием
+             */
+            inline bool read_key(char *buffer, const size_t capacity, size_t &size) {
+                return read_string(buffer, capacity, size) && expect(':');
+            }
+
+            /** \brief Перейти к следующему элементу объекта или массива
+             * \param close Закрывающий символ
+             * \param is_end Вернет true, если достигнут закрывающий символ
+             */
+            inline bool next(const char close, bool &is_end) {
+                skip_space();
+                if(ptr >= end) return false;
+                if(*ptr == ',') {
+                    ++ptr;
+                    is_end = false;
+                    return true;
+                }
+                if(*ptr == close) {
+                    ++ptr;
+                    is_end = true;
+                    return true;
+                }
+                return false;
+            }
+        };
+
+        static inline bool is_equal(const char *str, const size_t size, const char *value, const size_t value_size) {
+            return size == value_size && std::memcmp(str, value, size) == 0;
+        }
+
+        /// Обработчик подтверждений по умолчанию, подтверждения пропускаются
+        class SkipAck {
+        public:
+            inline void operator()(const common::SymbolId, const bool) const {};
+        };
+
+        /** \brief Разобрать массив assets
+         */
+        template<class CALLBACK>
+        static bool parse_assets(Scanner &scanner, const common::SymbolRegistry &registry, CALLBACK &on_tick) {
+            if(!scanner.expect('[')) return false;
+            if(scanner.expect(']')) return true;
+            while(true) {
+                if(!scanner.expect('{')) return false;
+                char key[16];
+                char ric[MAX_STRING_SIZE];
+                char created_at[MAX_STRING_SIZE];
+                size_t key_size = 0, ric_size = 0, created_at_size = 0;
+                double rate = 0, precision = 0;
+                uint32_t fields = 0;
+                bool is_end = scanner.expect('}');
+                while(!is_end) {
+                    if(!scanner.read_key(key, sizeof(key), key_size)) return false;
+                    if(is_equal(key, key_size, "rate", 4)) {
+                        if(!scanner.read_number(rate)) return false;
+                        fields |= 0x01;
+                    } else
+                    if(is_equal(key, key_size, "precision", 9)) {
+                        if(!scanner.read_number(precision)) return false;
+                        fields |= 0x02;
+                    } else
+                    if(is_equal(key, key_size, "ric", 3)) {
+                        if(!scanner.read_string(ric, sizeof(ric), ric_size)) return false;
+                        fields |= 0x04;
+                    } else
+                    if(is_equal(key, key_size, "created_at", 10)) {
+                        if(!scanner.read_string(created_at, sizeof(created_at), created_at_size)) return false;
+                        fields |= 0x08;
+                    } else
+                    if(!scanner.skip_value()) return false;
+                    if(!scanner.next('}', is_end)) return false;
+                }
+
+                common::StreamTick tick;
+                if(fields == 0x0F && ric_size <= sizeof(ric) && created_at_size <= sizeof(created_at) &&
+                    parse_iso_ftimestamp(created_at, created_at_size, tick.timestamp)) {
+                    tick.symbol_id = registry.get_id_by_ric(ric, ric_size);
+                    if(tick.symbol_id != common::INVALID_SYMBOL_ID) {
+                        tick.price = rate;
+                        tick.precision = precision > 0 ? (uint32_t)precision : 0;
+                        on_tick(tick);
+                    }
+                }
+                if(!scanner.next(']', is_end)) return false;
+                if(is_end) return true;
+            }
+        }
+
+        /** \brief Разобрать массив data
+         */
+        template<class CALLBACK, class ACK_CALLBACK>
+        static bool parse_data(Scanner &scanner, const common::SymbolRegistry &registry, CALLBACK &on_tick, ACK_CALLBACK &on_ack) {
+            if(!scanner.expect('[')) return false;
+            if(scanner.expect(']')) return true;
+            while(true) {
+                if(!scanner.peek('{')) {
+                    if(!scanner.skip_value()) return false;
+                } else {
+                    scanner.expect('{');
+                    char key[16];
+                    char action[16];
+                    char field[MAX_STRING_SIZE];
+                    size_t key_size = 0, action_size = 0, field_size = 0;
+                    const char *assets_begin = nullptr;
+                    const char *assets_end = nullptr;
+                    bool is_end = scanner.expect('}');
+                    while(!is_end) {
+                        if(!scanner.read_key(key, sizeof(key), key_size)) return false;
+                        if(is_equal(key, key_size, "action", 6) && scanner.peek('"')) {
+                            if(!scanner.read_string(action, sizeof(action), action_size)) return false;
+                        } else
+                        if(is_equal(key, key_size, "field", 5) && scanner.peek('"')) {
+                            if(!scanner.read_string(field, sizeof(field), field_size)) return false;
+                        } else
+                        if(is_equal(key, key_size, "assets", 6)) {
+                            scanner.skip_space();
+                            assets_begin = scanner.ptr;
+                            if(!scanner.skip_value()) return false;
+                            assets_end = scanner.ptr;
+                        } else
+                        if(!scanner.skip_value()) return false;
+                        if(!scanner.next('}', is_end)) return false;
+                    }
+                    if(assets_begin != nullptr && is_equal(action, action_size, "assets", 6)) {
+                        Scanner assets(assets_begin, assets_end);
+                        if(!parse_assets(assets, registry, on_tick)) return false;
+                    } else
+                    if(field_size > 0 && field_size <= sizeof(field)) {
+                        const bool is_subscribe = is_equal(action, action_size, "subscribe", 9);
+                        if(is_subscribe || is_equal(action, action_size, "unsubscribe", 11)) {
+                            const common::SymbolId symbol_id = registry.get_id_by_ric(field, field_size);
+                            if(symbol_id != common::INVALID_SYMBOL_ID) on_ack(symbol_id, is_subscribe);
+                        }
+                    }
+                }
+                bool is_end = false;
+                if(!scanner.next(']', is_end)) return false;
+                if(is_end) return true;
+            }
+        }
+
+    public:
+
+        /** \brief Разобрать сообщение потока котировок
+         *
+         * Тики передаются в on_tick(const common::StreamTick &tick) в порядке следования в сообщении.
+         * Тики символов, которых нет в реестре, пропускаются.
+         * Тики и подтверждения передаются, только если сервер вернул success: true
+         * \param data Сообщение
+         * \param size Длина сообщения
+         * \param on_tick Функция обработки тика
+         * \param on_ack Функция обработки подтверждения on_ack(const common::SymbolId symbol_id, const bool is_subscribe)
+         * \return Вернет false, если сообщение не удалось разобрать
+         */
+        template<class CALLBACK, class ACK_CALLBACK>
+        static bool parse(const char *data, const size_t size, CALLBACK on_tick, ACK_CALLBACK on_ack) {
+            Scanner scanner(data, data + size);
+            if(!scanner.expect('{')) return false;
+            bool is_success = false;
+            const char *data_begin = nullptr;
+            const char *data_end = nullptr;
+            bool is_end = scanner.expect('}');
+            while(!is_end) {
+                char key[16];
+                size_t key_size = 0;
+                if(!scanner.read_key(key, sizeof(key), key_size)) return false;
+                if(is_equal(key, key_size, "success", 7) && (scanner.peek('t') || scanner.peek('f'))) {
+                    if(!scanner.read_literal(is_success)) return false;
+                } else
+                if(is_equal(key, key_size, "data", 4)) {
+                    scanner.skip_space();
+                    data_begin = scanner.ptr;
+                    if(!scanner.skip_value()) return false;
+                    data_end = scanner.ptr;
+                } else
+                if(!scanner.skip_value()) return false;
+                if(!scanner.next('}', is_end)) return false;
+            }
+            if(!is_success || data_begin == nullptr || *data_begin != '[') return true;
+            Scanner data_scanner(data_begin, data_end);
+            return parse_data(data_scanner, common::SymbolRegistry::get(), on_tick, on_ack);
+        }
+
+        /** \brief Разобрать сообщение потока котировок, пропуская подтверждения подписки
+         * \param data Сообщение
+         * \param size Длина сообщения
+         * \param on_tick Функция обработки тика
+         * \return Вернет false, если сообщение не удалось разобрать
+         */
+        template<class CALLBACK>
+        static bool parse(const char *data, const size_t size, CALLBACK on_tick) {
+            return parse(data, size, on_tick, SkipAck());
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_QUOTE_PARSER_HPP_INCLUDED
@@ -0,0 +1,351 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_RATE_LIMITER_HPP_INCLUDED
+#define BINOMO_CPP_API_RATE_LIMITER_HPP_INCLUDED
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <future>
+#include <thread>
+#include <deque>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+
+namespace binomo_api {
+
+    /** \brief Ограничитель скорости запросов
+     *
+     * Ограничитель построен на корзине токенов: токены пополняются непрерывно
+     * со скоростью rate запросов в минуту, а корзина вмещает не более burst токенов.
+     * Поэтому запросы распределяются равномерно, а не уходят пачкой в начале каждой минуты.
+     * Запрос тяжелее burst ждет полную корзину и уводит ее в долг,
+     * который следующие запросы ждут, пока он не будет погашен.
+     *
+     * Если сервер отвечает кодом 429, 418 или 403, скорость снижается вдвое
+     * и запросы приостанавливаются, а после каждого успешного ответа скорость
+     * постепенно возвращается к заданному лимиту
+     */
+    class RateLimiter {
+    public:
+
+        /// Статистика ограничителя
+        class Stats {
+        public:
+            uint64_t acquired = 0;          /**< Количество разрешенных запросов */
+            uint64_t acquired_weight = 0;   /**< Суммарный вес разрешенных запросов */
+            uint64_t rejected = 0;          /**< Количество отказов try_acquire */
+            uint64_t throttled = 0;         /**< Количество ожиданий в acquire */
+            double throttled_time = 0;      /**< Суммарное время ожидания, секунды */
+            uint64_t limit_responses = 0;   /**< Количество ответов сервера о превышении лимита */
+            double rate = 0;                /**< Текущая скорость, запросов в минуту */
+            double limit = 0;               /**< Заданный лимит, запросов в минуту */
+
+            Stats() {};
+        };
+
+    private:
+        using clock = std::chrono::steady_clock;
+
+        mutable std::mutex limiter_mutex;
+        double limit = 30;                  /**< Заданный лимит, запросов в минуту */
+        double rate = 30;                   /**< Текущая скорость с учетом ответов сервера */
+        double min_rate = 1;                /**< Минимальная скорость */
+        double burst = 8;                   /**< Емкость корзины токенов */
+        double tokens = 8;                  /**< Доступные токены */
+        clock::time_point last_time = clock::now();
+        clock::time_point pause_time = clock::now();    /**< До этого времени запросы приостановлены */
+        std::map<std::string, uint32_t> weights;
+        Stats stats;
+
+        /** \brief Запрос, ожидающий места в лимите в async_acquire
+         */
+        class Waiter {
+        public:
+            uint32_t weight = 1;
+            std::promise<void> promise;
+            clock::time_point start_time;
+            bool is_throttled = false;
+
+            Waiter(const uint32_t user_weight) :
+                weight(user_weight), start_time(clock::now()) {};
+        };
+
+        std::deque<Waiter> waiters;         /**< Очередь async_acquire, защищена limiter_mutex */
+        std::thread waiter_thread;          /**< Поток ожидания для всех async_acquire, запускается при первом вызове */
+        std::condition_variable waiter_cv;
+        bool is_waiter_stop = false;
+
+        /** \brief Цикл потока ожидания
+         *
+         * Запросы получают место в лимите в порядке очереди
+         */
+        void run_waiter() {
+            std::unique_lock<std::mutex> lock(limiter_mutex);
+            while(!is_waiter_stop) {
+                if(waiters.empty()) {
+                    waiter_cv.wait(lock);
+                    continue;
+                }
+                const clock::time_point now = clock::now();
+                refill(now);
+                Waiter &waiter = waiters.front();
+                const double wait = get_wait((double)waiter.weight, now);
+                if(wait <= 0) {
+                    take((double)waiter.weight);
+                    if(waiter.is_throttled) {
+                        ++stats.throttled;
+                        stats.throttled_time += std::chrono::duration<double>(now - waiter.start_time).count();
+                    }
+                    std::promise<void> promise(std::move(waiter.promise));
+                    waiters.pop_front();
+                    lock.unlock();
+                    promise.set_value();
+                    lock.lock();
+                    continue;
+                }
+                waiter.is_throttled = true;
+                /* скорость может измениться, поэтому ожидание ограничено */
+                const double max_wait = 1.0;
+                waiter_cv.wait_for(lock, std::chrono::microseconds((int64_t)(std::min(wait, max_wait) * 1000000.0) + 1));
+            }
+        }
+
+        void refill(const clock::time_point now) {
+            const double elapsed = std::chrono::duration<double>(now - last_time).count();
+            last_time = now;
+            if(elapsed <= 0) return;
+            tokens = std::min(burst, tokens + elapsed * rate / 60.0);
+        }
+
+        /** \brief Получить время ожидания токенов
+         *
+         * Запрос тяжелее burst допускается при полной корзине
+         * \param weight Вес запроса
+         * \param now Текущее время
+         * \return Время ожидания в секундах, 0 если токенов достаточно
+         */
+        double get_wait(const double weight, const clock::time_point now) const {
+            if(now < pause_time) return std::chrono::duration<double>(pause_time - now).count();
+            const double need = std::min(weight, burst) - tokens;
+            if(need <= 0) return 0;
+            return need * 60.0 / rate;
+        }
+
+        /** \brief Списать вес запроса
+         *
+         * Списывается полный вес, поэтому у тяжелого запроса баланс уходит в долг
+         * \param weight Вес запроса
+         */
+        inline void take(const double weight) {
+            tokens -= weight;
+            ++stats.acquired;
+            stats.acquired_weight += (uint64_t)weight;
+        }
+
+    public:
+
+        /** \brief Конструктор ограничителя
+         * \param requests_per_minute Лимит запросов в минуту
+         * \param user_burst Емкость корзины токенов. Если 0, используется четверть лимита
+         */
+        RateLimiter(const double requests_per_minute = 30, const double user_burst = 0) {
+            set_limit(requests_per_minute, user_burst);
+            tokens = burst;
+        }
+
+        ~RateLimiter() {
+            {
+                std::lock_guard<std::mutex> lock(limiter_mutex);
+                is_waiter_stop = true;
+            }
+            waiter_cv.notify_one();
+            if(waiter_thread.joinable()) waiter_thread.join();
+        }
+
+        /** \brief Установить лимит запросов
+         * \param requests_per_minute Лимит запросов в минуту
+         * \param user_burst Емкость корзины токенов. Если 0, используется четверть лимита
+         */
+        void set_limit(const double requests_per_minute, const double user_burst = 0) {
+            std::lock_guard<std::mutex> lock(limiter_mutex);
+            refill(clock::now());
+            limit = std::max(requests_per_minute, min_rate);
+            rate = limit;
+            burst = user_burst > 0 ? user_burst : std::max(1.0, limit / 4.0);
+            tokens = std::min(tokens, burst);
+        }
+
+        /** \brief Установить вес запросов к конечной точке API
+         * \param endpoint Имя конечной точки
+         * \param weight Вес запроса
+         */
+        void set_weight(const std::string &endpoint, const uint32_t weight) {
+            std::lock_guard<std::mutex> lock(limiter_mutex);
+            weights[endpoint] = weight;
+        }
+
+        /** \brief Получить вес запросов к конечной точке API
+         * \param endpoint Имя конечной точки
+         * \return Вес запроса, по умолчанию 1
+         */
+        uint32_t get_weight(const std::string &endpoint) const {
+            std::lock_guard<std::mutex> lock(limiter_mutex);
+            auto it = weights.find(endpoint);
+            if(it == weights.end()) return 1;
+            return it->second;
+        }
+
+        /** \brief Занять место в лимите без ожидания
+         * \param weight Вес запроса
+         * \return Вернет true, если запрос можно отправить сейчас
+         */
+        bool try_acquire(const uint32_t weight = 1) {
+            std::lock_guard<std::mutex> lock(limiter_mutex);
+            const clock::time_point now = clock::now();
+            refill(now);
+            if(get_wait((double)weight, now) > 0) {
+                ++stats.rejected;
+                return false;
+            }
+            take((double)weight);
+            return true;
+        }
+
+        /** \brief Получить время до освобождения места в лимите
+         *
+         * Метод удобен для циклов ожидания, которые не должны блокироваться в acquire
+         * \param weight Вес запроса
+         * \return Время ожидания в секундах
+         */
+        double get_wait_time(const uint32_t weight = 1) {
+            std::lock_guard<std::mutex> lock(limiter_mutex);
+            const clock::time_point now = clock::now();
+            refill(now);
+            return get_wait((double)weight, now);
+        }
+
+        /** \brief Занять место в лимите, ожидая его освобождения
+         * \param weight Вес запроса
+         */
+        void acquire(const uint32_t weight = 1) {
+            bool is_throttled = false;
+            const clock::time_point start_time = clock::now();
+            while(true) {
+                double wait = 0;
+                {
+                    std::lock_guard<std::mutex> lock(limiter_mutex);
+                    const clock::time_point now = clock::now();
+                    refill(now);
+                    wait = get_wait((double)weight, now);
+                    if(wait <= 0) {
+                        take((double)weight);
+                        if(is_throttled) {
+                            ++stats.throttled;
+                            stats.throttled_time += std::chrono::duration<double>(now - start_time).count();
+                        }
+                        return;
+                    }
+                }
+                is_throttled = true;
+                /* скорость может измениться, поэтому ожидание ограничено */
+                const double max_wait = 1.0;
+                std::this_thread::sleep_for(std::chrono::microseconds((int64_t)(std::min(wait, max_wait) * 1000000.0) + 1));
+            }
+        }
+
+        /** \brief Асинхронно занять место в лимите
+         *
+         * Все вызовы обслуживает один поток ожидания в порядке очереди.
+         * Если ограничитель будет удален раньше, future вернет ошибку broken_promise
+         * \param weight Вес запроса
+         * \return Future, который будет готов, когда запрос можно отправить
+         */
+        std::future<void> async_acquire(const uint32_t weight = 1) {
+            std::lock_guard<std::mutex> lock(limiter_mutex);
+            waiters.emplace_back(weight);
+            std::future<void> future = waiters.back().promise.get_future();
+            if(!waiter_thread.joinable()) {
+                waiter_thread = std::thread([this] {
+                    run_waiter();
+                });
+            }
+            waiter_cv.notify_one();
+            return future;
+        }
+
+        /** \brief Сообщить об ответе сервера о превышении лимита
+         *
+         * Скорость снижается вдвое, а запросы приостанавливаются
+         * \param retry_after Время паузы из заголовка Retry-After, секунды. Если 0, пауза равна интервалу между запросами
+         */
+        void on_limit_response(const double retry_after = 0) {
+            std::lock_guard<std::mutex> lock(limiter_mutex);
+            const clock::time_point now = clock::now();
+            refill(now);
+            rate = std::max(min_rate, rate / 2.0);
+            tokens = std::min(tokens, 0.0);
+            const double pause = retry_after > 0 ? retry_after : 60.0 / rate;
+            const clock::time_point new_pause_time = now + std::chrono::microseconds((int64_t)(pause * 1000000.0));
+            if(new_pause_time > pause_time) pause_time = new_pause_time;
+            ++stats.limit_responses;
+        }
+
+        /** \brief Сообщить об успешном ответе сервера
+         *
+         * Скорость постепенно возвращается к заданному лимиту
+         */
+        void on_success() {
+            std::lock_guard<std::mutex> lock(limiter_mutex);
+            if(rate >= limit) return;
+            refill(clock::now());
+            rate = std::min(limit, rate + limit / 20.0);
+        }
+
+        /** \brief Получить статистику ограничителя
+         * \return Статистика
+         */
+        Stats get_stats() const {
+            std::lock_guard<std::mutex> lock(limiter_mutex);
+            Stats temp = stats;
+            temp.rate = rate;
+            temp.limit = limit;
+            return temp;
+        }
+    };
+
+    /** \brief Получить общий для процесса ограничитель скорости запросов
+     *
+     * Все экземпляры BinomoApiHttp по умолчанию используют этот ограничитель
+     * \return Указатель на ограничитель
+     */
+    inline std::shared_ptr<RateLimiter> get_shared_rate_limiter() {
+        static std::shared_ptr<RateLimiter> rate_limiter = std::make_shared<RateLimiter>();
+        return rate_limiter;
+    }
+}
+
+#endif // BINOMO_CPP_API_RATE_LIMITER_HPP_INCLUDED
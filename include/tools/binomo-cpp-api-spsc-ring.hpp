@@ -0,0 +1,125 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_SPSC_RING_HPP_INCLUDED
+#define BINOMO_CPP_API_SPSC_RING_HPP_INCLUDED
+
+#include <vector>
+#include <atomic>
+#include <cstddef>
+
+namespace binomo_api {
+
+    /** \brief Кольцевой буфер для одного писателя и одного читателя
+     *
+     * Ячейки создаются один раз и используются повторно, поэтому строка или вектор
+     * в ячейке сохраняет выделенную память между сообщениями.
+     * Писатель заполняет ячейку из begin_push() и публикует ее через end_push(),
+     * читатель обрабатывает ячейку из front() и освобождает ее через pop().
+     * Методы писателя можно вызывать только из одного потока в каждый момент времени,
+     * то же относится к методам читателя
+     */
+    template<class T>
+    class SpscRing {
+    private:
+        static const size_t CACHE_LINE = 64;
+
+        std::vector<T> slots;
+        size_t mask = 0;
+
+        char pad_0[CACHE_LINE];
+        std::atomic<size_t> head = ATOMIC_VAR_INIT(0);  /**< Счетчик записанных ячеек, изменяет писатель */
+        char pad_1[CACHE_LINE];
+        std::atomic<size_t> tail = ATOMIC_VAR_INIT(0);  /**< Счетчик прочитанных ячеек, изменяет читатель */
+        char pad_2[CACHE_LINE];
+
+    public:
+
+        /** \brief Конструктор кольцевого буфера
+         * \param capacity Количество ячеек, округляется вверх до степени двойки
+         */
+        SpscRing(const size_t capacity = 1024) {
+            size_t size = 1;
+            while(size < capacity) size <<= 1;
+            slots.resize(size);
+            mask = size - 1;
+        }
+
+        /** \brief Получить ячейку для записи
+         * \return Указатель на свободную ячейку или nullptr, если буфер заполнен
+         */
+        inline T *begin_push() {
+            const size_t h = head.load(std::memory_order_relaxed);
+            if(h - tail.load(std::memory_order_acquire) >= slots.size()) return nullptr;
+            return &slots[h & mask];
+        }
+
+        /** \brief Опубликовать ячейку, полученную из begin_push()
+         */
+        inline void end_push() {
+            head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /** \brief Получить ячейку для чтения
+         * \return Указатель на самую старую ячейку или nullptr, если буфер пуст
+         */
+        inline T *front() {
+            const size_t t = tail.load(std::memory_order_relaxed);
+            if(t == head.load(std::memory_order_acquire)) return nullptr;
+            return &slots[t & mask];
+        }
+
+        /** \brief Освободить ячейку, полученную из front()
+         */
+        inline void pop() {
+            tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        /** \brief Получить количество занятых ячеек
+         *
+         * Из постороннего потока значение приблизительное
+         * \return Количество занятых ячеек
+         */
+        inline size_t size() const {
+            const size_t t = tail.load(std::memory_order_acquire);
+            const size_t h = head.load(std::memory_order_acquire);
+            return h >= t ? h - t : 0;
+        }
+
+        /** \brief Проверить, пуст ли буфер
+         * \return Вернет true, если занятых ячеек нет
+         */
+        inline bool empty() const {
+            return size() == 0;
+        }
+
+        /** \brief Получить количество ячеек
+         * \return Количество ячеек
+         */
+        inline size_t capacity() const {
+            return slots.size();
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_SPSC_RING_HPP_INCLUDED
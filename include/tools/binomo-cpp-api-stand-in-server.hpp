@@ -0,0 +1,453 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_STAND_IN_SERVER_HPP_INCLUDED
+#define BINOMO_CPP_API_STAND_IN_SERVER_HPP_INCLUDED
+
+#include "binomo-cpp-api-history-parser.hpp"
+#include <boost/asio.hpp>
+#include <zlib.h>
+#include "xtime.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+namespace binomo_api {
+
+    /** \brief Локальный сервер-заменитель API исторических данных
+     *
+     * Сервер отвечает на запросы /platform/candles/<ric>/<date>/<period> так же, как api.binomo.com,
+     * и нужен для тестов производительности BinomoApiHttp без обращения к брокеру.
+     * Ответ берется из каталога записанных ответов, а если файла нет, бары генерируются.
+     * Задержка ответа, сжатие, размер частей ответа и доля ответов 429 настраиваются
+     */
+    class HistoryStandInServer {
+    public:
+
+        /// Настройки сервера
+        class Config {
+        public:
+            std::string address = "127.0.0.1";
+            uint16_t port = 18080;
+            size_t threads = 1;             /**< Количество потоков io_context */
+            bool is_gzip = true;            /**< Сжимать ответ gzip */
+            uint32_t latency_ms = 0;        /**< Задержка перед ответом, мс */
+            uint32_t limit_every = 0;       /**< Каждый N-й запрос получает ответ 429, 0 - отключено */
+            uint32_t retry_after = 1;       /**< Значение Retry-After для ответа 429, секунды */
+            size_t chunk_size = 0;          /**< Размер частей chunked transfer encoding, 0 - ответ с Content-Length */
+            /** \brief Каталог записанных ответов
+             * Файлы имеют имя <ric>_<period>_<timestamp>.json, символ '/' в ric заменяется на '_'
+             */
+            std::string record_path;
+
+            Config() {};
+        };
+
+        /// Статистика сервера
+        class Stats {
+        public:
+            uint64_t requests = 0;          /**< Количество запросов */
+            uint64_t limited = 0;           /**< Количество ответов 429 */
+            uint64_t not_found = 0;         /**< Количество ответов 404 */
+            uint64_t candles = 0;           /**< Количество отданных баров */
+            uint64_t bytes_sent = 0;        /**< Количество отданных байт тела ответа */
+
+            Stats() {};
+        };
+
+    private:
+        using tcp = boost::asio::ip::tcp;
+
+        Config config;
+        boost::asio::io_context io_context;
+        tcp::acceptor acceptor;
+        std::vector<std::thread> threads;
+
+        std::atomic<uint64_t> requests = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> limited = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> not_found = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> candles = ATOMIC_VAR_INIT(0);
+        std::atomic<uint64_t> bytes_sent = ATOMIC_VAR_INIT(0);
+
+        /// Соединение с клиентом
+        class Session : public std::enable_shared_from_this<Session> {
+        private:
+            HistoryStandInServer &server;
+            tcp::socket socket;
+            boost::asio::streambuf buffer;
+            boost::asio::steady_timer timer;
+            std::string response;
+            bool is_keep_alive = true;
+
+        public:
+
+            Session(HistoryStandInServer &user_server, tcp::socket user_socket) :
+                server(user_server),
+                socket(std::move(user_socket)),
+                timer(user_server.io_context) {
+            };
+
+            void read() {
+                std::shared_ptr<Session> self = shared_from_this();
+                boost::asio::async_read_until(socket, buffer, "\r\n\r\n",
+                        [self](const boost::system::error_code &ec, const std::size_t size) {
+                    if(ec) return;
+                    std::string header(
+                        boost::asio::buffers_begin(self->buffer.data()),
+                        boost::asio::buffers_begin(self->buffer.data()) + size);
+                    self->buffer.consume(size);
+                    self->on_request(header);
+                });
+            }
+
+            void on_request(const std::string &header) {
+                /* строка запроса: GET <target> HTTP/1.1 */
+                const std::size_t method_end = header.find(' ');
+                const std::size_t target_end = method_end == std::string::npos ? std::string::npos : header.find(' ', method_end + 1);
+                std::string target;
+                if(target_end != std::string::npos) target = header.substr(method_end + 1, target_end - method_end - 1);
+                std::string lower_header(header);
+                std::transform(lower_header.begin(), lower_header.end(), lower_header.begin(), ::tolower);
+                is_keep_alive = lower_header.find("connection: close") == std::string::npos &&
+                    lower_header.find("http/1.0") == std::string::npos;
+                response = server.get_response(target, is_keep_alive);
+                if(server.config.latency_ms == 0) {
+                    write();
+                    return;
+                }
+                std::shared_ptr<Session> self = shared_from_this();
+                timer.expires_after(std::chrono::milliseconds(server.config.latency_ms));
+                timer.async_wait([self](const boost::system::error_code &ec) {
+                    if(ec) return;
+                    self->write();
+                });
+            }
+
+            void write() {
+                std::shared_ptr<Session> self = shared_from_this();
+                boost::asio::async_write(socket, boost::asio::buffer(response),
+                        [self](const boost::system::error_code &ec, const std::size_t) {
+                    if(ec) return;
+                    if(self->is_keep_alive) {
+                        self->read();
+                        return;
+                    }
+                    boost::system::error_code ignored;
+                    self->socket.shutdown(tcp::socket::shutdown_both, ignored);
+                });
+            }
+        };
+
+        void accept() {
+            acceptor.async_accept([this](const boost::system::error_code &ec, tcp::socket socket) {
+                if(!acceptor.is_open()) return;
+                if(!ec) std::make_shared<Session>(*this, std::move(socket))->read();
+                accept();
+            });
+        }
+
+        /** \brief Получить длину участка истории
+         *
+         * Таблица совпадает с длиной участков, которые запрашивает BinomoApiHttp
+         * \param period Период
+         * \return Длина участка в секундах или 0, если период не поддерживается
+         */
+        static xtime::timestamp_t get_chunk_length(const uint32_t period) {
+            switch(period) {
+            case 1:
+            case 5:
+            case 15:
+            case 30:
+            case xtime::SECONDS_IN_MINUTE:
+                return xtime::SECONDS_IN_DAY;
+            case (5 * xtime::SECONDS_IN_MINUTE):
+                return xtime::SECONDS_IN_DAY*4;
+            case (15 * xtime::SECONDS_IN_MINUTE):
+            case (30 * xtime::SECONDS_IN_MINUTE):
+                return xtime::SECONDS_IN_DAY*24;
+            case xtime::SECONDS_IN_HOUR:
+                return xtime::SECONDS_IN_DAY*48;
+            case (3*xtime::SECONDS_IN_HOUR):
+                return xtime::SECONDS_IN_DAY*96;
+            case xtime::SECONDS_IN_DAY:
+                return xtime::SECONDS_IN_DAY*1536;
+            default:
+                return 0;
+            }
+        }
+
+        static std::string url_decode(const std::string &str) {
+            std::string out;
+            out.reserve(str.size());
+            for(size_t i = 0; i < str.size(); ++i) {
+                if(str[i] == '%' && (i + 2) < str.size()) {
+                    out += (char)std::strtol(str.substr(i + 1, 2).c_str(), nullptr, 16);
+                    i += 2;
+                } else
+                if(str[i] == '+') out += ' ';
+                else out += str[i];
+            }
+            return out;
+        }
+
+        /** \brief Сгенерировать ответ с барами участка
+         *
+         * Цена - детерминированное случайное блуждание, поэтому повторный запрос дает тот же ответ
+         * \param ric Имя символа у брокера
+         * \param date Начало участка
+         * \param period Период
+         * \param count Количество баров в ответе
+         * \return Тело ответа
+         */
+        static std::string generate_body(
+                const std::string &ric,
+                const xtime::timestamp_t date,
+                const uint32_t period,
+                size_t &count) {
+            const xtime::timestamp_t length = get_chunk_length(period);
+            count = (size_t)(length / period);
+            uint64_t seed = std::hash<std::string>()(ric) ^ (date * 0x9E3779B97F4A7C15ULL);
+            auto get_random = [&seed]() -> double {
+                seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+                return (double)(seed >> 11) / (double)(1ULL << 53) - 0.5;
+            };
+            double price = 100.0 + (double)(std::hash<std::string>()(ric) % 10000) / 100.0;
+            std::string body;
+            body.reserve(count * 128 + 64);
+            body += "{\"success\":true,\"errors\":[],\"data\":[";
+            char buffer[256];
+            for(size_t i = 0; i < count; ++i) {
+                const xtime::timestamp_t timestamp = date + i * period;
+                const double open = price;
+                const double close = open + get_random() * 0.1;
+                const double high = std::max(open, close) + std::abs(get_random()) * 0.05;
+                const double low = std::min(open, close) - std::abs(get_random()) * 0.05;
+                price = close;
+                const std::string created_at = xtime::to_string("%YYYY-%MM-%DDT%hh:%mm:%ss", timestamp);
+                const int size = std::snprintf(buffer, sizeof(buffer),
+                    "%s{\"open\":%.5f,\"close\":%.5f,\"high\":%.5f,\"low\":%.5f,\"created_at\":\"%s.000000Z\"}",
+                    i == 0 ? "" : ",", open, close, high, low, created_at.c_str());
+                if(size > 0) body.append(buffer, std::min((size_t)size, sizeof(buffer) - 1));
+            }
+            body += "]}";
+            return body;
+        }
+
+        /** \brief Прочитать записанный ответ
+         * \return Вернет false, если файла нет
+         */
+        bool read_record(
+                const std::string &ric,
+                const xtime::timestamp_t date,
+                const uint32_t period,
+                std::string &body) {
+            if(config.record_path.empty()) return false;
+            std::string name(ric);
+            std::replace(name.begin(), name.end(), '/', '_');
+            const std::string file_name = config.record_path + "/" + name + "_" +
+                std::to_string(period) + "_" + std::to_string(date) + ".json";
+            std::ifstream file(file_name, std::ios::binary);
+            if(!file) return false;
+            std::stringstream stream;
+            stream << file.rdbuf();
+            body = stream.str();
+            return true;
+        }
+
+        static bool compress_gzip(const std::string &body, std::string &out) {
+            z_stream stream;
+            std::memset(&stream, 0, sizeof(stream));
+            if(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) return false;
+            out.resize(deflateBound(&stream, (uLong)body.size()));
+            stream.next_in = (Bytef*)body.data();
+            stream.avail_in = (uInt)body.size();
+            stream.next_out = (Bytef*)&out[0];
+            stream.avail_out = (uInt)out.size();
+            const int err = deflate(&stream, Z_FINISH);
+            out.resize(stream.total_out);
+            deflateEnd(&stream);
+            return err == Z_STREAM_END;
+        }
+
+        std::string make_response(
+                const std::string &status,
+                const std::string &body,
+                const bool is_keep_alive,
+                const std::string &extra_headers = std::string()) {
+            std::string payload;
+            const bool is_gzip = config.is_gzip && !body.empty() && compress_gzip(body, payload);
+            if(!is_gzip) payload = body;
+            bytes_sent += payload.size();
+
+            std::string response("HTTP/1.1 " + status + "\r\n");
+            response += "Content-Type: application/json\r\n";
+            if(is_gzip) response += "Content-Encoding: gzip\r\n";
+            response += is_keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+            response += extra_headers;
+            if(config.chunk_size == 0) {
+                response += "Content-Length: " + std::to_string(payload.size()) + "\r\n\r\n";
+                response += payload;
+                return response;
+            }
+            response += "Transfer-Encoding: chunked\r\n\r\n";
+            char size_buffer[32];
+            for(size_t pos = 0; pos < payload.size(); pos += config.chunk_size) {
+                const size_t size = std::min(config.chunk_size, payload.size() - pos);
+                std::snprintf(size_buffer, sizeof(size_buffer), "%zx\r\n", size);
+                response += size_buffer;
+                response.append(payload, pos, size);
+                response += "\r\n";
+            }
+            response += "0\r\n\r\n";
+            return response;
+        }
+
+        /** \brief Получить ответ на запрос
+         * \param target Путь запроса
+         * \param is_keep_alive Не закрывать соединение
+         * \return HTTP ответ целиком
+         */
+        std::string get_response(const std::string &target, const bool is_keep_alive) {
+            const uint64_t index = ++requests;
+            if(config.limit_every > 0 && (index % config.limit_every) == 0) {
+                ++limited;
+                return make_response("429 Too Many Requests", std::string(), is_keep_alive,
+                    "Retry-After: " + std::to_string(config.retry_after) + "\r\n");
+            }
+
+            /* /platform/candles/<ric>/<date>/<period>?locale=en */
+            const std::string prefix("/platform/candles/");
+            std::string path = target.substr(0, target.find('?'));
+            std::vector<std::string> parts;
+            if(path.compare(0, prefix.size(), prefix) == 0) {
+                std::size_t pos = prefix.size();
+                while(pos <= path.size()) {
+                    const std::size_t end = std::min(path.find('/', pos), path.size());
+                    parts.push_back(path.substr(pos, end - pos));
+                    pos = end + 1;
+                }
+            }
+            xtime::timestamp_t date = 0;
+            const uint32_t period = parts.size() == 3 ? (uint32_t)std::atoi(parts[2].c_str()) : 0;
+            if(parts.size() != 3 ||
+                !parse_iso_timestamp(parts[1].data(), parts[1].size(), date) ||
+                get_chunk_length(period) == 0) {
+                ++not_found;
+                return make_response("404 Not Found", "{\"success\":false,\"errors\":[\"not found\"],\"data\":[]}", is_keep_alive);
+            }
+            const std::string ric = url_decode(parts[0]);
+            std::string body;
+            if(read_record(ric, date, period, body)) {
+                return make_response("200 OK", body, is_keep_alive);
+            }
+            size_t count = 0;
+            body = generate_body(ric, date, period, count);
+            candles += count;
+            return make_response("200 OK", body, is_keep_alive);
+        }
+
+    public:
+
+        /** \brief Конструктор сервера
+         * \param user_config Настройки сервера
+         */
+        HistoryStandInServer(const Config &user_config = Config()) :
+            config(user_config),
+            acceptor(io_context) {
+        };
+
+        ~HistoryStandInServer() {
+            stop();
+        }
+
+        /** \brief Запустить сервер
+         * \return Вернет false, если порт не удалось открыть
+         */
+        bool start() {
+            boost::system::error_code ec;
+            tcp::endpoint endpoint(boost::asio::ip::make_address(config.address, ec), config.port);
+            if(ec) return false;
+            acceptor.open(endpoint.protocol(), ec);
+            if(ec) return false;
+            acceptor.set_option(tcp::acceptor::reuse_address(true), ec);
+            acceptor.bind(endpoint, ec);
+            if(ec) return false;
+            acceptor.listen(boost::asio::socket_base::max_listen_connections, ec);
+            if(ec) return false;
+            accept();
+            const size_t num_threads = std::max(config.threads, (size_t)1);
+            for(size_t i = 0; i < num_threads; ++i) {
+                threads.emplace_back([this]() {
+                    io_context.run();
+                });
+            }
+            return true;
+        }
+
+        /** \brief Остановить сервер
+         */
+        void stop() {
+            io_context.stop();
+            for(size_t i = 0; i < threads.size(); ++i) {
+                if(threads[i].joinable()) threads[i].join();
+            }
+            threads.clear();
+            /* потоки io_context завершены, поэтому порт закрывается здесь же без гонки с accept */
+            boost::system::error_code ec;
+            acceptor.close(ec);
+        }
+
+        /** \brief Получить адрес сервера для BinomoApiHttp::set_api_url
+         * \return Адрес сервера
+         */
+        std::string get_url() const {
+            return "http://" + config.address + ":" + std::to_string(config.port);
+        }
+
+        /** \brief Получить статистику сервера
+         * \return Статистика
+         */
+        Stats get_stats() const {
+            Stats stats;
+            stats.requests = requests;
+            stats.limited = limited;
+            stats.not_found = not_found;
+            stats.candles = candles;
+            stats.bytes_sent = bytes_sent;
+            return stats;
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_STAND_IN_SERVER_HPP_INCLUDED
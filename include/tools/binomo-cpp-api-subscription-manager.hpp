@@ -0,0 +1,247 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_SUBSCRIPTION_MANAGER_HPP_INCLUDED
+#define BINOMO_CPP_API_SUBSCRIPTION_MANAGER_HPP_INCLUDED
+
+#include "../binomo-cpp-api-common.hpp"
+#include "xtime.hpp"
+#include <vector>
+#include <mutex>
+
+namespace binomo_api {
+
+    /** \brief Менеджер подписок потока котировок
+     *
+     * Менеджер хранит желаемый набор символов и состояние подписки каждого символа на сервере.
+     * Символ нужен, если на него подписались напрямую или у него есть периоды баров.
+     * Изменения не отправляются сразу: get_changes() сравнивает желаемый набор с подтвержденным
+     * и возвращает разницу, которую поток котировок отправляет одним сообщением на действие.
+     * Поэтому частое добавление и удаление символов не порождает поток сообщений,
+     * а после переподключения reset() и get_changes() дают ровно желаемый набор
+     */
+    class SubscriptionManager {
+    public:
+        static const uint32_t MAX_ATTEMPTS = 3;     /**< Число отправок подписки без подтверждения, после которого подписка считается действующей */
+
+        /** \brief Статистика подписок
+         */
+        class Stats {
+        public:
+            size_t desired = 0;         /**< Символов в желаемом наборе */
+            size_t acknowledged = 0;    /**< Символов, подписка на которые подтверждена */
+            size_t pending = 0;         /**< Символов, ожидающих подтверждения */
+            uint64_t frames = 0;        /**< Отправлено сообщений подписки и отписки */
+            uint64_t resent = 0;        /**< Повторных отправок подписки из-за отсутствия подтверждения */
+            uint64_t unconfirmed = 0;   /**< Подписок, принятых без подтверждения сервера */
+
+            Stats() {};
+        };
+
+    private:
+
+        /// Состояние подписки символа на сервере
+        enum ServerState {
+            NOT_SUBSCRIBED = 0,     /**< Подписки нет или отправлена отписка */
+            PENDING = 1,            /**< Подписка отправлена, подтверждения нет */
+            ACKNOWLEDGED = 2,       /**< Подписка подтверждена */
+        };
+
+        /// Подписка символа
+        class Entry {
+        public:
+            bool is_direct = false;             /**< Символ подписан напрямую */
+            bool is_candles = false;            /**< У символа есть периоды баров */
+            ServerState state = NOT_SUBSCRIBED;
+            uint32_t attempts = 0;              /**< Число отправок подписки без подтверждения */
+            xtime::ftimestamp_t sent_time = 0;  /**< Время последней отправки подписки */
+
+            Entry() {};
+
+            inline bool is_desired() const {
+                return is_direct || is_candles;
+            }
+        };
+
+        std::vector<Entry> entries;     /**< Индекс - номер символа */
+        Stats stats;
+        xtime::ftimestamp_t ack_timeout = 5.0;
+        std::mutex entries_mutex;
+
+        inline bool check_id(const common::SymbolId symbol_id) const {
+            return symbol_id < entries.size();
+        }
+
+    public:
+
+        /** \brief Конструктор менеджера подписок
+         * \param ack_timeout_sec Время ожидания подтверждения подписки в секундах
+         */
+        SubscriptionManager(const xtime::ftimestamp_t ack_timeout_sec = 5.0) :
+            entries(common::SymbolRegistry::get().size()), ack_timeout(ack_timeout_sec) {
+        }
+
+        /** \brief Подписать или отписать символ напрямую
+         * \param symbol_id Номер символа
+         * \param value Состояние прямой подписки
+         * \return Вернет true, если изменился желаемый набор
+         */
+        bool set_direct(const common::SymbolId symbol_id, const bool value) {
+            std::lock_guard<std::mutex> lock(entries_mutex);
+            if(!check_id(symbol_id)) return false;
+            Entry &entry = entries[symbol_id];
+            const bool is_desired = entry.is_desired();
+            entry.is_direct = value;
+            return is_desired != entry.is_desired();
+        }
+
+        /** \brief Отметить наличие периодов баров у символа
+         * \param symbol_id Номер символа
+         * \param value Есть ли у символа периоды баров
+         * \return Вернет true, если изменился желаемый набор
+         */
+        bool set_candles(const common::SymbolId symbol_id, const bool value) {
+            std::lock_guard<std::mutex> lock(entries_mutex);
+            if(!check_id(symbol_id)) return false;
+            Entry &entry = entries[symbol_id];
+            const bool is_desired = entry.is_desired();
+            entry.is_candles = value;
+            return is_desired != entry.is_desired();
+        }
+
+        /** \brief Проверить, нужен ли символ
+         * \param symbol_id Номер символа
+         * \return Вернет true, если символ в желаемом наборе
+         */
+        bool check_desired(const common::SymbolId symbol_id) {
+            std::lock_guard<std::mutex> lock(entries_mutex);
+            if(!check_id(symbol_id)) return false;
+            return entries[symbol_id].is_desired();
+        }
+
+        /** \brief Получить желаемый набор символов
+         * \return Номера символов по возрастанию
+         */
+        std::vector<common::SymbolId> get_desired() {
+            std::lock_guard<std::mutex> lock(entries_mutex);
+            std::vector<common::SymbolId> desired;
+            for(common::SymbolId symbol_id = 0; symbol_id < entries.size(); ++symbol_id) {
+                if(entries[symbol_id].is_desired()) desired.push_back(symbol_id);
+            }
+            return desired;
+        }
+
+        /** \brief Обработать подтверждение сервера
+         * \param symbol_id Номер символа
+         * \param is_subscribe Подтверждение подписки (true) или отписки (false)
+         */
+        void on_ack(const common::SymbolId symbol_id, const bool is_subscribe) {
+            std::lock_guard<std::mutex> lock(entries_mutex);
+            if(!check_id(symbol_id)) return;
+            Entry &entry = entries[symbol_id];
+            /* отписка считается выполненной при отправке,
+             * а запоздавшее подтверждение подписки после отписки не учитываем
+             */
+            if(!is_subscribe || entry.state != PENDING) return;
+            entry.state = ACKNOWLEDGED;
+            entry.attempts = 0;
+        }
+
+        /** \brief Сбросить состояние сервера
+         *
+         * Метод нужно вызывать при закрытии и открытии соединения:
+         * на новом соединении подписок нет, поэтому следующий get_changes() вернет весь желаемый набор
+         */
+        void reset() {
+            std::lock_guard<std::mutex> lock(entries_mutex);
+            for(size_t i = 0; i < entries.size(); ++i) {
+                entries[i].state = NOT_SUBSCRIBED;
+                entries[i].attempts = 0;
+            }
+        }
+
+        /** \brief Получить изменения подписок для отправки
+         *
+         * Символы из результата считаются отправленными: подписки ждут подтверждения,
+         * отписки считаются выполненными. Подписка без подтверждения отправляется повторно
+         * по истечении времени ожидания, но не более MAX_ATTEMPTS раз
+         * \param timestamp Текущее время ПК
+         * \param subscribe Символы, на которые нужно подписаться
+         * \param unsubscribe Символы, от которых нужно отписаться
+         * \return Вернет true, если есть изменения
+         */
+        bool get_changes(
+                const xtime::ftimestamp_t timestamp,
+                std::vector<common::SymbolId> &subscribe,
+                std::vector<common::SymbolId> &unsubscribe) {
+            subscribe.clear();
+            unsubscribe.clear();
+            std::lock_guard<std::mutex> lock(entries_mutex);
+            for(common::SymbolId symbol_id = 0; symbol_id < entries.size(); ++symbol_id) {
+                Entry &entry = entries[symbol_id];
+                if(entry.is_desired()) {
+                    if(entry.state == ACKNOWLEDGED) continue;
+                    if(entry.state == PENDING) {
+                        if((timestamp - entry.sent_time) < ack_timeout) continue;
+                        if(entry.attempts >= MAX_ATTEMPTS) {
+                            /* сервер не подтверждает подписку, считаем ее действующей */
+                            entry.state = ACKNOWLEDGED;
+                            entry.attempts = 0;
+                            ++stats.unconfirmed;
+                            continue;
+                        }
+                        ++stats.resent;
+                    }
+                    entry.state = PENDING;
+                    entry.sent_time = timestamp;
+                    ++entry.attempts;
+                    subscribe.push_back(symbol_id);
+                } else
+                if(entry.state != NOT_SUBSCRIBED) {
+                    entry.state = NOT_SUBSCRIBED;
+                    entry.attempts = 0;
+                    unsubscribe.push_back(symbol_id);
+                }
+            }
+            if(!subscribe.empty()) ++stats.frames;
+            if(!unsubscribe.empty()) ++stats.frames;
+            return !subscribe.empty() || !unsubscribe.empty();
+        }
+
+        /** \brief Получить статистику подписок
+         * \return Статистика подписок
+         */
+        Stats get_stats() {
+            std::lock_guard<std::mutex> lock(entries_mutex);
+            Stats value = stats;
+            for(size_t i = 0; i < entries.size(); ++i) {
+                if(entries[i].is_desired()) ++value.desired;
+                if(entries[i].state == ACKNOWLEDGED) ++value.acknowledged;
+                if(entries[i].state == PENDING) ++value.pending;
+            }
+            return value;
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_SUBSCRIPTION_MANAGER_HPP_INCLUDED
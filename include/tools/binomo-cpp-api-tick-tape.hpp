@@ -0,0 +1,710 @@
+/*
+* binomo-cpp-api - C ++ API client for binomo
+*
+* Copyright (c) 2019 Elektro Yar. Email: git.electroyar@gmail.com
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+#ifndef BINOMO_CPP_API_TICK_TAPE_HPP_INCLUDED
+#define BINOMO_CPP_API_TICK_TAPE_HPP_INCLUDED
+
+#include "../binomo-cpp-api-common.hpp"
+#include <fstream>
+#include <vector>
+#include <array>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <cstdio>
+
+namespace binomo_api {
+
+    /** \brief Формат ленты тиков
+     *
+     * Лента пишется в файлы по одному на день (UTC): <path>/<prefix>_<YYYY>_<MM>_<DD>.btt
+     *
+     * Файл начинается с заголовка 32 байта (сигнатура, версия, начало дня),
+     * за ним идут блоки. Блок имеет заголовок 24 байта
+     * (сигнатура, размер данных, количество тиков, CRC32 данных, время первого тика в мкс)
+     * и данные - последовательность записей, числа в которых записаны как varint:
+     * - 0, точность, длина имени, имя - определение символа. Символ получает следующий номер в блоке, начиная с 1
+     * - номер символа, приращение времени в мкс, приращение цены в пунктах - тик
+     *
+     * Приращения записаны в zigzag-кодировке. Время отсчитывается от предыдущего тика блока,
+     * цена - от предыдущей цены символа в блоке. Каждый блок не зависит от других,
+     * поэтому поврежденный или недописанный блок можно пропустить
+     */
+    class TickTape {
+    public:
+        static const uint32_t FILE_MAGIC = 0x31545442;      /**< Сигнатура файла "BTT1" */
+        static const uint32_t FILE_VERSION = 1;
+        static const uint32_t HEADER_SIZE = 32;
+        static const uint32_t BLOCK_MAGIC = 0x4B4C4254;     /**< Сигнатура блока "BTLK" */
+        static const uint32_t BLOCK_HEADER_SIZE = 24;
+        static const uint32_t MAX_BLOCK_SIZE = 64 * 1024 * 1024;
+        static const uint32_t MAX_PRECISION = 15;
+
+        /** \brief Посчитать CRC32
+         * \param data Данные
+         * \param size Размер данных
+         * \param crc Начальное значение, для продолжения расчета
+         * \return CRC32 данных
+         */
+        static uint32_t crc32(const uint8_t *data, const size_t size, uint32_t crc = 0) {
+            static const std::array<uint32_t, 256> table = [] {
+                std::array<uint32_t, 256> temp;
+                for(uint32_t i = 0; i < 256; ++i) {
+                    uint32_t value = i;
+                    for(int j = 0; j < 8; ++j) {
+                        value = (value & 1) ? (0xEDB88320 ^ (value >> 1)) : (value >> 1);
+                    }
+                    temp[i] = value;
+                }
+                return temp;
+            }();
+            crc = ~crc;
+            for(size_t i = 0; i < size; ++i) {
+                crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            }
+            return ~crc;
+        }
+
+        static inline uint64_t zigzag_encode(const int64_t value) {
+            return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+        }
+
+        static inline int64_t zigzag_decode(const uint64_t value) {
+            return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+        }
+
+        static inline void put_varint(std::vector<uint8_t> &buffer, uint64_t value) {
+            while(value >= 0x80) {
+                buffer.push_back((uint8_t)(value | 0x80));
+                value >>= 7;
+            }
+            buffer.push_back((uint8_t)value);
+        }
+
+        /** \brief Прочитать varint
+         * \param ptr Указатель на данные, будет сдвинут за прочитанное число
+         * \param end Конец данных
+         * \param value Число
+         * \return Вернет false, если данные закончились раньше числа
+         */
+        static inline bool get_varint(const uint8_t *&ptr, const uint8_t *end, uint64_t &value) {
+            value = 0;
+            for(uint32_t shift = 0; shift < 64 && ptr < end; shift += 7) {
+                const uint8_t byte = *ptr++;
+                value |= (uint64_t)(byte & 0x7F) << shift;
+                if(!(byte & 0x80)) return true;
+            }
+            return false;
+        }
+
+        /** \brief Получить множитель цены для точности
+         * \param precision Количество знаков после запятой
+         * \return 10 в степени precision
+         */
+        static inline double get_scale(const uint32_t precision) {
+            static const std::array<double, MAX_PRECISION + 1> table = [] {
+                std::array<double, MAX_PRECISION + 1> temp;
+                double value = 1.0;
+                for(size_t i = 0; i < temp.size(); ++i) {
+                    temp[i] = value;
+                    value *= 10.0;
+                }
+                return temp;
+            }();
+            return table[std::min(precision, (uint32_t)MAX_PRECISION)];
+        }
+
+        static inline uint32_t get_le32(const uint8_t *ptr) {
+            return (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8) | ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+        }
+
+        static inline uint64_t get_le64(const uint8_t *ptr) {
+            return (uint64_t)get_le32(ptr) | ((uint64_t)get_le32(ptr + 4) << 32);
+        }
+
+        static inline void set_le32(uint8_t *ptr, const uint32_t value) {
+            for(int i = 0; i < 4; ++i) ptr[i] = (uint8_t)(value >> (8 * i));
+        }
+
+        static inline void set_le64(uint8_t *ptr, const uint64_t value) {
+            set_le32(ptr, (uint32_t)value);
+            set_le32(ptr + 4, (uint32_t)(value >> 32));
+        }
+
+        /** \brief Получить имя файла ленты
+         * \param path Папка ленты
+         * \param prefix Префикс имени файла
+         * \param day_timestamp Начало дня
+         * \return Имя файла
+         */
+        static std::string get_file_name(
+                const std::string &path,
+                const std::string &prefix,
+                const xtime::timestamp_t day_timestamp) {
+            return path + "/" + prefix + "_" + xtime::to_string("%YYYY_%MM_%DD", day_timestamp) + ".btt";
+        }
+    };
+
+    /** \brief Запись ленты тиков
+     *
+     * Метод write только кладет тик в очередь, кодирование и запись на диск
+     * выполняет фоновый поток. Если очередь переполнена, тик отбрасывается,
+     * поэтому обработка тиков никогда не ждет диск.
+     * Файл сменяется, когда приходит тик следующего дня
+     */
+    class TickTapeWriter {
+    public:
+
+        /// Настройки записи
+        class Config {
+        public:
+            std::string path;                   /**< Папка ленты, папка должна существовать */
+            std::string prefix = "ticks";       /**< Префикс имени файлов */
+            uint32_t block_size = 64 * 1024;    /**< Размер данных блока, после которого блок записывается */
+            double flush_period = 1.0;          /**< Наибольшее время, через которое тики попадут на диск, секунды */
+            size_t max_queue = 1024 * 1024;     /**< Наибольшее количество тиков в очереди */
+
+            Config() {};
+        };
+
+        /// Статистика записи
+        class Stats {
+        public:
+            uint64_t ticks = 0;         /**< Записано тиков */
+            uint64_t dropped = 0;       /**< Отброшено тиков из-за переполнения очереди или ошибки файла */
+            uint64_t blocks = 0;        /**< Записано блоков */
+            uint64_t bytes = 0;         /**< Записано байт */
+            uint64_t files = 0;         /**< Открыто файлов */
+            uint64_t file_errors = 0;   /**< Ошибок открытия файла дня, тики такого дня отбрасываются */
+            size_t queue = 0;           /**< Тиков в очереди */
+
+            Stats() {};
+        };
+
+    private:
+        Config config;
+
+        std::vector<common::StreamTick> queue;
+        std::mutex queue_mutex;
+        std::condition_variable queue_cv;
+        uint64_t flush_request = 0;             /**< Номер последнего запроса записи, защищен queue_mutex */
+        uint64_t flush_done = 0;                /**< Номер выполненного запроса записи, защищен queue_mutex */
+        bool is_stop = false;                   /**< Защищен queue_mutex */
+
+        Stats stats;
+        std::mutex stats_mutex;
+
+        /* состояние ниже использует только фоновый поток */
+        std::ofstream file;
+        xtime::timestamp_t file_day = 0;
+        bool is_file_error = false;     /**< Файл дня не открылся, попытка повторяется только для следующего дня */
+
+        /// Символ текущего блока
+        class BlockSymbol {
+        public:
+            uint32_t index = 0;         /**< Номер в блоке, 0 - символ еще не определен */
+            uint32_t precision = 0;
+            int64_t last_points = 0;
+
+            BlockSymbol() {};
+        };
+
+        std::vector<uint8_t> block;
+        std::vector<BlockSymbol> block_symbols = std::vector<BlockSymbol>(common::SymbolRegistry::get().size());
+        std::vector<common::SymbolId> block_used;   /**< Символы, определенные в блоке */
+        uint32_t block_index = 0;
+        uint32_t block_ticks = 0;
+        int64_t block_time = 0;                     /**< Время первого тика блока, мкс */
+        int64_t last_time = 0;                      /**< Время предыдущего тика блока, мкс */
+
+        std::thread writer_thread;
+
+        /** \brief Отметить ошибку файла дня
+         *
+         * Ошибка сообщается один раз, тики дня отбрасываются до смены дня
+         * \param message Сообщение об ошибке
+         */
+        void set_file_error(const std::string &message) {
+            std::cerr << "binomo api: " << message << std::endl;
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            ++stats.file_errors;
+        }
+
+        /** \brief Открыть файл дня
+         *
+         * Существующий файл дописывается, если его заголовок верен.
+         * Файл с неверным заголовком переименовывается в <имя>.bad, а день пишется в новый файл
+         */
+        void open_file(const xtime::timestamp_t day_timestamp) {
+            file.close();
+            file.clear();
+            file_day = day_timestamp;
+            is_file_error = true;
+            const std::string file_name = TickTape::get_file_name(config.path, config.prefix, day_timestamp);
+
+            uint8_t header[TickTape::HEADER_SIZE];
+            std::memset(header, 0, sizeof(header));
+            std::ifstream check(file_name, std::ios_base::binary);
+            bool is_new = true;
+            if(check.is_open()) {
+                check.read(reinterpret_cast<char*>(header), sizeof(header));
+                const std::streamsize header_size = check.gcount();
+                check.close();
+                if(header_size > 0) {
+                    if(header_size != (std::streamsize)sizeof(header) ||
+                        TickTape::get_le32(header) != TickTape::FILE_MAGIC ||
+                        TickTape::get_le32(header + 4) != TickTape::FILE_VERSION) {
+                        /* поврежденный файл сохраняем для разбора, старый .bad заменяется */
+                        const std::string bad_file_name = file_name + ".bad";
+                        std::remove(bad_file_name.c_str());
+                        if(std::rename(file_name.c_str(), bad_file_name.c_str()) != 0) {
+                            set_file_error("tick tape file " + file_name + " has wrong header and can't be renamed, ticks of the day are dropped");
+                            return;
+                        }
+                        std::cerr << "binomo api: tick tape file " << file_name << " has wrong header, renamed to " << bad_file_name << std::endl;
+                        std::memset(header, 0, sizeof(header));
+                    } else {
+                        is_new = false;
+                    }
+                }
+            }
+
+            file.open(file_name, std::ios_base::binary | std::ios_base::app);
+            if(!file.is_open()) {
+                set_file_error("tick tape can't create file " + file_name + ", ticks of the day are dropped");
+                return;
+            }
+            if(is_new) {
+                TickTape::set_le32(header, TickTape::FILE_MAGIC);
+                TickTape::set_le32(header + 4, TickTape::FILE_VERSION);
+                TickTape::set_le64(header + 8, (uint64_t)day_timestamp);
+                file.write(reinterpret_cast<const char*>(header), sizeof(header));
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                stats.bytes += sizeof(header);
+            }
+            is_file_error = false;
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            ++stats.files;
+        }
+
+        /** \brief Записать текущий блок и начать новый
+         */
+        void write_block() {
+            if(block_ticks == 0) return;
+            uint8_t header[TickTape::BLOCK_HEADER_SIZE];
+            TickTape::set_le32(header, TickTape::BLOCK_MAGIC);
+            TickTape::set_le32(header + 4, (uint32_t)block.size());
+            TickTape::set_le32(header + 8, block_ticks);
+            TickTape::set_le32(header + 12, TickTape::crc32(block.data(), block.size()));
+            TickTape::set_le64(header + 16, (uint64_t)block_time);
+            file.write(reinterpret_cast<const char*>(header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(block.data()), block.size());
+            {
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                if(file) {
+                    stats.ticks += block_ticks;
+                    stats.bytes += sizeof(header) + block.size();
+                    ++stats.blocks;
+                } else {
+                    stats.dropped += block_ticks;
+                }
+            }
+            if(!file) {
+                std::cerr << "binomo api: tick tape write error" << std::endl;
+                file.clear();
+            }
+            for(auto &symbol_id : block_used) {
+                block_symbols[symbol_id] = BlockSymbol();
+            }
+            block_used.clear();
+            block.clear();
+            block_index = 0;
+            block_ticks = 0;
+        }
+
+        /** \brief Добавить тик в текущий блок
+         */
+        void put_tick(const common::StreamTick &tick) {
+            if(tick.symbol_id >= block_symbols.size()) return;
+            const xtime::timestamp_t day_timestamp = ((xtime::timestamp_t)tick.timestamp / xtime::SECONDS_IN_DAY) * xtime::SECONDS_IN_DAY;
+            /* поздний тик прошлого дня остается в текущем файле,
+             * после ошибки файл не открывается повторно до следующего дня
+             */
+            if((!file.is_open() && !is_file_error) || day_timestamp > file_day) {
+                if(file.is_open()) write_block();
+                open_file(day_timestamp);
+            }
+            if(is_file_error) {
+                std::lock_guard<std::mutex> lock(stats_mutex);
+                ++stats.dropped;
+                return;
+            }
+
+            const uint32_t precision = std::min(tick.precision, (uint32_t)TickTape::MAX_PRECISION);
+            const int64_t time = (int64_t)std::llround(tick.timestamp * 1000000.0);
+            const int64_t points = (int64_t)std::llround(tick.price * TickTape::get_scale(precision));
+            if(block_ticks == 0) {
+                block_time = time;
+                last_time = time;
+            }
+
+            BlockSymbol &symbol = block_symbols[tick.symbol_id];
+            if(symbol.index == 0 || symbol.precision != precision) {
+                /* символ определяется заново и при смене точности */
+                if(symbol.index == 0) block_used.push_back(tick.symbol_id);
+                const std::string &name = common::get_symbol_name(tick.symbol_id);
+                TickTape::put_varint(block, 0);
+                TickTape::put_varint(block, precision);
+                TickTape::put_varint(block, name.size());
+                block.insert(block.end(), name.begin(), name.end());
+                symbol.index = ++block_index;
+                symbol.precision = precision;
+                symbol.last_points = 0;
+            }
+            TickTape::put_varint(block, symbol.index);
+            TickTape::put_varint(block, TickTape::zigzag_encode(time - last_time));
+            TickTape::put_varint(block, TickTape::zigzag_encode(points - symbol.last_points));
+            symbol.last_points = points;
+            last_time = time;
+            ++block_ticks;
+            if(block.size() >= config.block_size) write_block();
+        }
+
+        void run() {
+            common::set_thread_name("binomo-tick-tape");
+            std::vector<common::StreamTick> ticks;
+            const size_t notify_size = std::max((size_t)1, config.max_queue / 4);
+            while(true) {
+                uint64_t request = 0;
+                bool is_exit = false;
+                {
+                    std::unique_lock<std::mutex> lock(queue_mutex);
+                    queue_cv.wait_for(lock, std::chrono::microseconds((int64_t)(config.flush_period * 1000000.0)), [&] {
+                        return is_stop || queue.size() >= notify_size || flush_request != flush_done;
+                    });
+                    ticks.swap(queue);
+                    request = flush_request;
+                    is_exit = is_stop;
+                }
+
+                for(size_t i = 0; i < ticks.size(); ++i) {
+                    put_tick(ticks[i]);
+                }
+                ticks.clear();
+                /* недописанный блок попадает на диск не позже flush_period */
+                write_block();
+                if(file.is_open()) file.flush();
+
+                {
+                    std::lock_guard<std::mutex> lock(queue_mutex);
+                    flush_done = request;
+                }
+                queue_cv.notify_all();
+                if(is_exit) break;
+            }
+            file.close();
+        }
+
+    public:
+
+        /** \brief Конструктор записи ленты
+         *
+         * Фоновый поток запускается сразу
+         * \param user_config Настройки записи
+         */
+        TickTapeWriter(const Config &user_config) :
+                config(user_config) {
+            block.reserve(config.block_size + 256);
+            writer_thread = std::thread([&] {
+                run();
+            });
+        }
+
+        /** \brief Конструктор записи ленты
+         * \param path Папка ленты, папка должна существовать
+         */
+        TickTapeWriter(const std::string &path) :
+                TickTapeWriter([&] {
+                    Config temp;
+                    temp.path = path;
+                    return temp;
+                }()) {
+        }
+
+        TickTapeWriter(const TickTapeWriter&) = delete;
+        TickTapeWriter &operator=(const TickTapeWriter&) = delete;
+
+        ~TickTapeWriter() {
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                is_stop = true;
+            }
+            queue_cv.notify_all();
+            if(writer_thread.joinable()) writer_thread.join();
+        }
+
+        /** \brief Добавить тик в ленту
+         *
+         * Метод не обращается к диску
+         * \param tick Тик
+         * \return Вернет false, если тик отброшен из-за переполнения очереди
+         */
+        bool write(const common::StreamTick &tick) {
+            bool is_notify = false;
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                if(queue.size() >= config.max_queue) {
+                    std::lock_guard<std::mutex> stats_lock(stats_mutex);
+                    ++stats.dropped;
+                    return false;
+                }
+                queue.push_back(tick);
+                is_notify = queue.size() == std::max((size_t)1, config.max_queue / 4);
+            }
+            if(is_notify) queue_cv.notify_one();
+            return true;
+        }
+
+        /** \brief Записать на диск все тики, добавленные до вызова
+         */
+        void flush() {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            if(is_stop) return;
+            const uint64_t request = ++flush_request;
+            queue_cv.notify_all();
+            queue_cv.wait(lock, [&] {
+                return flush_done >= request;
+            });
+        }
+
+        /** \brief Получить статистику записи
+         * \return Статистика
+         */
+        Stats get_stats() {
+            size_t queue_size = 0;
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                queue_size = queue.size();
+            }
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            Stats temp = stats;
+            temp.queue = queue_size;
+            return temp;
+        }
+    };
+
+    /** \brief Чтение ленты тиков
+     *
+     * Блоки с неверной сигнатурой или CRC32 пропускаются,
+     * чтение продолжается со следующей найденной сигнатуры блока
+     */
+    class TickTapeReader {
+    public:
+
+        /// Статистика чтения
+        class Stats {
+        public:
+            uint64_t ticks = 0;         /**< Прочитано тиков */
+            uint64_t blocks = 0;        /**< Прочитано блоков */
+            uint64_t bad_blocks = 0;    /**< Пропущено поврежденных блоков */
+            uint64_t unknown = 0;       /**< Пропущено тиков неизвестных символов */
+
+            Stats() {};
+        };
+
+    private:
+        std::ifstream file;
+        bool is_header = false;
+        Stats stats;
+
+        /// Символ блока при чтении
+        class BlockSymbol {
+        public:
+            common::SymbolId symbol_id = common::INVALID_SYMBOL_ID;
+            uint32_t precision = 0;
+            int64_t last_points = 0;
+
+            BlockSymbol() {};
+        };
+
+        std::vector<uint8_t> block;
+        const uint8_t *block_ptr = nullptr;
+        const uint8_t *block_end = nullptr;
+        std::vector<BlockSymbol> block_symbols;
+        int64_t last_time = 0;
+
+        /** \brief Найти следующую сигнатуру блока
+         * \param pos Позиция, с которой начинается поиск
+         * \return Вернет false, если сигнатура не найдена
+         */
+        bool seek_block_magic(std::streamoff pos) {
+            uint8_t magic[4];
+            TickTape::set_le32(magic, TickTape::BLOCK_MAGIC);
+            std::vector<char> buffer(64 * 1024);
+            while(true) {
+                file.clear();
+                file.seekg(pos);
+                file.read(buffer.data(), buffer.size());
+                const std::streamsize size = file.gcount();
+                if(size < 4) return false;
+                for(std::streamsize i = 0; i + 4 <= size; ++i) {
+                    if(std::memcmp(buffer.data() + i, magic, 4) != 0) continue;
+                    file.clear();
+                    file.seekg(pos + i);
+                    return true;
+                }
+                pos += size - 3;
+            }
+        }
+
+        /** \brief Прочитать следующий блок
+         * \return Вернет false, если блоков больше нет
+         */
+        bool read_block() {
+            while(true) {
+                const std::streamoff pos = file.tellg();
+                if(pos < 0) return false;
+                uint8_t header[TickTape::BLOCK_HEADER_SIZE];
+                file.read(reinterpret_cast<char*>(header), sizeof(header));
+                if(file.gcount() != (std::streamsize)sizeof(header)) return false;
+                const uint32_t size = TickTape::get_le32(header + 4);
+                bool is_valid = TickTape::get_le32(header) == TickTape::BLOCK_MAGIC &&
+                    size <= TickTape::MAX_BLOCK_SIZE;
+                if(is_valid) {
+                    block.resize(size);
+                    file.read(reinterpret_cast<char*>(block.data()), size);
+                    is_valid = file.gcount() == (std::streamsize)size &&
+                        TickTape::crc32(block.data(), size) == TickTape::get_le32(header + 12);
+                }
+                if(!is_valid) {
+                    ++stats.bad_blocks;
+                    if(!seek_block_magic(pos + 1)) return false;
+                    continue;
+                }
+                ++stats.blocks;
+                block_ptr = block.data();
+                block_end = block.data() + size;
+                block_symbols.clear();
+                last_time = (int64_t)TickTape::get_le64(header + 16);
+                return true;
+            }
+        }
+
+        /** \brief Прочитать следующую запись блока
+         * \param tick Тик
+         * \return Вернет 1, если прочитан тик, 0 - определение символа, -1 - ошибка данных
+         */
+        int read_record(common::StreamTick &tick) {
+            uint64_t code = 0;
+            if(!TickTape::get_varint(block_ptr, block_end, code)) return -1;
+            if(code == 0) {
+                uint64_t precision = 0, name_size = 0;
+                if(!TickTape::get_varint(block_ptr, block_end, precision) ||
+                    !TickTape::get_varint(block_ptr, block_end, name_size) ||
+                    name_size > (uint64_t)(block_end - block_ptr)) return -1;
+                BlockSymbol symbol;
+                symbol.symbol_id = common::get_symbol_id(std::string(reinterpret_cast<const char*>(block_ptr), name_size));
+                symbol.precision = (uint32_t)std::min(precision, (uint64_t)TickTape::MAX_PRECISION);
+                block_ptr += name_size;
+                block_symbols.push_back(symbol);
+                return 0;
+            }
+            uint64_t time_delta = 0, points_delta = 0;
+            if(code > block_symbols.size() ||
+                !TickTape::get_varint(block_ptr, block_end, time_delta) ||
+                !TickTape::get_varint(block_ptr, block_end, points_delta)) return -1;
+            BlockSymbol &symbol = block_symbols[code - 1];
+            last_time += TickTape::zigzag_decode(time_delta);
+            symbol.last_points += TickTape::zigzag_decode(points_delta);
+            tick.symbol_id = symbol.symbol_id;
+            tick.precision = symbol.precision;
+            tick.price = (double)symbol.last_points / TickTape::get_scale(symbol.precision);
+            tick.timestamp = (xtime::ftimestamp_t)last_time / 1000000.0;
+            return 1;
+        }
+
+    public:
+
+        /** \brief Конструктор чтения ленты
+         * \param file_name Имя файла ленты
+         */
+        TickTapeReader(const std::string &file_name) {
+            file.open(file_name, std::ios_base::binary);
+            if(!file.is_open()) return;
+            uint8_t header[TickTape::HEADER_SIZE];
+            file.read(reinterpret_cast<char*>(header), sizeof(header));
+            is_header = file.gcount() == (std::streamsize)sizeof(header) &&
+                TickTape::get_le32(header) == TickTape::FILE_MAGIC &&
+                TickTape::get_le32(header + 4) == TickTape::FILE_VERSION;
+        }
+
+        /** \brief Проверить, открыт ли файл ленты
+         * \return Вернет true, если файл открыт и его заголовок верен
+         */
+        inline bool is_open() const {
+            return is_header;
+        }
+
+        /** \brief Прочитать следующий тик
+         *
+         * Тики символов, которых нет в реестре, пропускаются
+         * \param tick Тик
+         * \return Вернет false, если тиков больше нет
+         */
+        bool read(common::StreamTick &tick) {
+            if(!is_header) return false;
+            while(true) {
+                if(block_ptr == block_end) {
+                    if(!read_block()) return false;
+                    continue;
+                }
+                const int type = read_record(tick);
+                if(type < 0) {
+                    /* блок прошел проверку CRC32, но не разобран - пропускаем его остаток */
+                    ++stats.bad_blocks;
+                    block_ptr = block_end;
+                    continue;
+                }
+                if(type == 0) continue;
+                if(tick.symbol_id == common::INVALID_SYMBOL_ID) {
+                    ++stats.unknown;
+                    continue;
+                }
+                ++stats.ticks;
+                return true;
+            }
+        }
+
+        /** \brief Получить статистику чтения
+         * \return Статистика
+         */
+        inline const Stats &get_stats() const {
+            return stats;
+        }
+    };
+}
+
+#endif // BINOMO_CPP_API_TICK_TAPE_HPP_INCLUDED